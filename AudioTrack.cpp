@@ -0,0 +1,232 @@
+#include <string.h>
+#include <new>
+#include "AudioTrack.hpp"
+
+namespace SimpleRipper
+{
+  AudioTrack::AudioTrack
+    (
+    SectorArena & aArena	//!< Arena the pcm is stored in
+    )
+  : mArena( &aArena )
+  , mSectors( 0 )
+  , mComplete( false )
+  {
+    memset( &mSpan, 0, sizeof( mSpan ) );
+    memset( &mChecksums, 0, sizeof( mChecksums ) );
+  }
+
+  AudioTrack::AudioTrack
+    (
+    AudioTrack && aOther	//!< Track giving up its blocks
+    )
+  : mArena( aOther.mArena )
+  , mBlocks( std::move( aOther.mBlocks ) )
+  , mSectors( aOther.mSectors )
+  , mSpan( aOther.mSpan )
+  , mChecksums( aOther.mChecksums )
+  , mComplete( aOther.mComplete )
+  {
+    aOther.mBlocks.clear();
+    aOther.mSectors = 0;
+    aOther.mComplete = false;
+  }
+
+  AudioTrack & AudioTrack::operator=
+    (
+    AudioTrack && aOther	//!< Track giving up its blocks
+    )
+  {
+    if( this != &aOther )
+    {
+      clear();
+      mArena = aOther.mArena;
+      mBlocks.swap( aOther.mBlocks );
+      mSectors = aOther.mSectors;
+      mSpan = aOther.mSpan;
+      mChecksums = aOther.mChecksums;
+      mComplete = aOther.mComplete;
+      aOther.mSectors = 0;
+      aOther.mComplete = false;
+    }
+    return *this;
+  }
+
+  AudioTrack::~AudioTrack()
+  {
+    clear();
+  }
+
+  void AudioTrack::clear()
+  {
+    for( size_t i = 0; i < mBlocks.size(); i++ )
+    {
+      mArena->release( mBlocks[i] );
+    }
+    // the capacity is kept for the next rip
+    mBlocks.clear();
+    mSectors = 0;
+    mComplete = false;
+    memset( &mChecksums, 0, sizeof( mChecksums ) );
+  }
+
+  void AudioTrack::reserve
+    (
+    size_t aSectors	//!< Sectors the track will hold
+    )
+  {
+    size_t blocks = ( aSectors + SectorArena::SECTORS_PER_BLOCK - 1 ) / SectorArena::SECTORS_PER_BLOCK;
+
+    mBlocks.reserve( blocks );
+    if( blocks > mBlocks.size() )
+    {
+      mArena->reserve( blocks - mBlocks.size() );
+    }
+  }
+
+  void AudioTrack::append
+    (
+    const int16_t * aPcm,	//!< Raw sectors to copy
+    size_t aSectors		//!< Number of sectors
+    )
+  {
+    const unsigned char * pcm = reinterpret_cast<const unsigned char *>( aPcm );
+
+    while( aSectors > 0 )
+    {
+      size_t used = mSectors % SectorArena::SECTORS_PER_BLOCK;
+      if( used == 0 && mSectors / SectorArena::SECTORS_PER_BLOCK == mBlocks.size() )
+      {
+	mBlocks.push_back( mArena->acquire() );
+      }
+
+      size_t count = SectorArena::SECTORS_PER_BLOCK - used;
+      if( count > aSectors )
+      {
+	count = aSectors;
+      }
+      memcpy( reinterpret_cast<unsigned char *>( mBlocks.back() ) + used * CDIO_CD_FRAMESIZE_RAW,
+	pcm, count * CDIO_CD_FRAMESIZE_RAW );
+
+      pcm += count * CDIO_CD_FRAMESIZE_RAW;
+      mSectors += count;
+      aSectors -= count;
+    }
+  }
+
+  const int16_t * AudioTrack::getBlock
+    (
+    size_t aIndex,	//!< Block number from 0
+    size_t & aSectors	//!< Set to the sectors in the block
+    ) const
+  {
+    if( aIndex >= getNumBlocks() )
+    {
+      aSectors = 0;
+      return NULL;
+    }
+
+    aSectors = SectorArena::SECTORS_PER_BLOCK;
+    if( aIndex == getNumBlocks() - 1 && mSectors % SectorArena::SECTORS_PER_BLOCK != 0 )
+    {
+      aSectors = mSectors % SectorArena::SECTORS_PER_BLOCK;
+    }
+    return mBlocks[aIndex];
+  }
+
+  bool AudioTrack::writeTo
+    (
+    ripper_sink_t & aSink	//!< Sink receiving the track
+    ) const
+  {
+    ripper_span_t span = mSpan;
+    span.last = span.first + mSectors - 1;
+    span.start = span.first;
+
+    int status = aSink.begin( &aSink, &span );
+    if( status == 1 )
+    {
+      for( size_t i = 0; status == 1 && i < getNumBlocks(); i++ )
+      {
+	size_t sectors;
+	const int16_t * block = getBlock( i, sectors );
+	status = aSink.write( &aSink, block, sectors );
+      }
+      if( aSink.end( &aSink, status ) == -1 )
+      {
+	status = -1;
+      }
+    }
+    if( aSink.flush != NULL && aSink.flush( &aSink ) == -1 )
+    {
+      status = -1;
+    }
+    return status == 1;
+  }
+
+  ripper_sink_t AudioTrack::getSink()
+  {
+    ripper_sink_t sink;
+
+    memset( &sink, 0, sizeof( sink ) );
+    sink.begin = &AudioTrack::sinkBegin;
+    sink.write = &AudioTrack::sinkWrite;
+    sink.end = &AudioTrack::sinkEnd;
+    sink.data = this;
+    return sink;
+  }
+
+  int AudioTrack::sinkBegin
+    (
+    ripper_sink_t * aSink,
+    const ripper_span_t * aSpan
+    )
+  {
+    AudioTrack * track = static_cast<AudioTrack *>( aSink->data );
+
+    try
+    {
+      track->clear();
+      track->mSpan = *aSpan;
+      track->reserve( aSpan->last - aSpan->first + 1 );
+    }
+    catch( const std::bad_alloc & )
+    {
+      return -1;
+    }
+    return 1;
+  }
+
+  int AudioTrack::sinkWrite
+    (
+    ripper_sink_t * aSink,
+    const int16_t * aPcm,
+    long aSectors
+    )
+  {
+    AudioTrack * track = static_cast<AudioTrack *>( aSink->data );
+
+    try
+    {
+      track->append( aPcm, aSectors );
+    }
+    catch( const std::bad_alloc & )
+    {
+      return -1;
+    }
+    return 1;
+  }
+
+  int AudioTrack::sinkEnd
+    (
+    ripper_sink_t * aSink,
+    int aStatus
+    )
+  {
+    AudioTrack * track = static_cast<AudioTrack *>( aSink->data );
+
+    track->mComplete = ( aStatus == 1 );
+    return aStatus;
+  }
+
+} // end namespace SimpleRipper
@@ -1,18 +1,126 @@
+#ifndef AUDIO_TRACK_HPP_
+#define AUDIO_TRACK_HPP_
+
+#include <sys/types.h>
+#include <vector>
+#include "ripper.h"
+#include "SectorArena.hpp"
 
 namespace SimpleRipper
 {
-  class QString;
-  
+  //! Pcm of one ripped track held in memory
+  //!
+  //! The sectors are stored in blocks from a SectorArena and go
+  //! back to it when the track is cleared or destroyed, so a
+  //! track can be verified before it is written anywhere.  A
+  //! track reused for the next rip keeps its block table.
+  //! Tracks can be moved but not copied.
   class AudioTrack
   {
     public:
-      AudioTrack();
-      
-      virtual AudioTrack();
-      
-      
-    
+
+      //! Creates an empty track storing its pcm in aArena
+      explicit AudioTrack
+	(
+	SectorArena & aArena
+	);
+
+      AudioTrack
+	(
+	AudioTrack && aOther
+	);
+
+      AudioTrack & operator=
+	(
+	AudioTrack && aOther
+	);
+
+      virtual ~AudioTrack();
+
+      AudioTrack( const AudioTrack & ) = delete;
+      AudioTrack & operator=( const AudioTrack & ) = delete;
+
+      //! Returns every block to the arena
+      void clear();
+
+      //! Makes room for aSectors without allocating while appending
+      void reserve
+	(
+	size_t aSectors
+	);
+
+      //! Copies aSectors raw sectors to the end of the track
+      //! Throws std::bad_alloc if the arena is out of memory
+      void append
+	(
+	const int16_t * aPcm,
+	size_t aSectors
+	);
+
+      //! Writes the track to aSink as a single span
+      //! \return true on success
+      bool writeTo
+	(
+	ripper_sink_t & aSink
+	) const;
+
+      //! \return a sink filling this track, for ripperRipTrackSink
+      ripper_sink_t getSink();
+
+      //! \return the pcm of a sector, valid until the track is cleared
+      inline const int16_t * getSector
+	(
+	size_t aSector
+	) const
+      {
+	return mBlocks[aSector / SectorArena::SECTORS_PER_BLOCK]
+	  + ( aSector % SectorArena::SECTORS_PER_BLOCK ) * ( CDIO_CD_FRAMESIZE_RAW / sizeof( int16_t ) );
+      }
+
+      //! \return the pcm of block aIndex and sets aSectors to its length
+      const int16_t * getBlock
+	(
+	size_t aIndex,
+	size_t & aSectors
+	) const;
+
+      inline size_t getNumBlocks() const { return ( mSectors + SectorArena::SECTORS_PER_BLOCK - 1 ) / SectorArena::SECTORS_PER_BLOCK; }
+
+      inline size_t getNumSectors() const { return mSectors; }
+
+      inline int getTrackNum() const { return mSpan.track; }
+
+      //! \return true once the whole track has been ripped
+      inline bool isComplete() const { return mComplete; }
+
+      inline const ripper_track_checksums_t & getChecksums() const { return mChecksums; }
+
+      inline void setChecksums
+	(
+	const ripper_track_checksums_t & aChecksums
+	)
+      {
+	mChecksums = aChecksums;
+      }
+
+    private:
+
+      static int sinkBegin( ripper_sink_t * aSink, const ripper_span_t * aSpan );
+      static int sinkWrite( ripper_sink_t * aSink, const int16_t * aPcm, long aSectors );
+      static int sinkEnd( ripper_sink_t * aSink, int aStatus );
+
+    protected:
+
+      SectorArena		*mArena;	//!< Arena owning the blocks
+      std::vector<int16_t *>	mBlocks;	//!< Blocks holding the sectors in order
+      size_t			mSectors;	//!< Number of sectors stored
+      ripper_span_t		mSpan;		//!< Track and sectors the pcm was ripped from
+      ripper_track_checksums_t	mChecksums;	//!< Checksums of the rip
+      bool			mComplete;	//!< Set once the rip finished
+
   };
-  
-  
-} // end namespace SimpleRipper
\ No newline at end of file
+
+
+} // end namespace SimpleRipper
+
+#endif
@@ -0,0 +1,254 @@
+#include <string.h>
+#include <mutex>
+#include "AudioWriter.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define AUDIO_WRITER_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+namespace SimpleRipper
+{
+  namespace
+  {
+    typedef void (*ConvertKernel)( const int16_t *, size_t, uint8_t *, bool );
+
+    //! Kernels picked by selectKernels
+    ConvertKernel gPcm16Kernel;
+    ConvertKernel gPcm24Kernel;
+    ConvertKernel gFloat32Kernel;
+    std::once_flag gKernelsOnce;
+
+    const float FLOAT_SCALE = 1.0f / 32768.0f;
+
+    // The portable kernels write each byte from the value so they
+    // are right on hosts of either byte order
+
+    void toPcm16Scalar( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      if( !aBigEndian )
+      {
+	memcpy( aOut, aPcm, aSamples * sizeof( int16_t ) );
+	return;
+      }
+#endif
+      for( size_t i = 0; i < aSamples; i++, aOut += 2 )
+      {
+	uint16_t sample = uint16_t( aPcm[i] );
+	if( aBigEndian )
+	{
+	  AudioHeader::putBE( aOut, sample, 2 );
+	}
+	else
+	{
+	  AudioHeader::putLE( aOut, sample, 2 );
+	}
+      }
+    }
+
+    void toPcm24Scalar( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      for( size_t i = 0; i < aSamples; i++, aOut += 3 )
+      {
+	uint32_t sample = uint32_t( uint16_t( aPcm[i] ) ) << 8;
+	if( aBigEndian )
+	{
+	  AudioHeader::putBE( aOut, sample, 3 );
+	}
+	else
+	{
+	  AudioHeader::putLE( aOut, sample, 3 );
+	}
+      }
+    }
+
+    void toFloat32Scalar( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      for( size_t i = 0; i < aSamples; i++, aOut += 4 )
+      {
+	float value = aPcm[i] * FLOAT_SCALE;
+	uint32_t bits;
+	memcpy( &bits, &value, sizeof( bits ) );
+	if( aBigEndian )
+	{
+	  AudioHeader::putBE( aOut, bits, 4 );
+	}
+	else
+	{
+	  AudioHeader::putLE( aOut, bits, 4 );
+	}
+      }
+    }
+
+#ifdef AUDIO_WRITER_X86_KERNELS
+
+    //! Swaps the bytes of every 16 bit lane
+    __attribute__((target("sse2")))
+    inline __m128i swap16( __m128i aValue )
+    {
+      return _mm_or_si128( _mm_slli_epi16( aValue, 8 ), _mm_srli_epi16( aValue, 8 ) );
+    }
+
+    //! Swaps the bytes of every 32 bit lane
+    __attribute__((target("sse2")))
+    inline __m128i swap32( __m128i aValue )
+    {
+      return swap16( _mm_or_si128( _mm_slli_epi32( aValue, 16 ), _mm_srli_epi32( aValue, 16 ) ) );
+    }
+
+    //! Only big endian output needs the bytes moved
+    __attribute__((target("sse2")))
+    void toPcm16SSE2( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      size_t i = 0;
+
+      if( aBigEndian )
+      {
+	for( ; i + 8 <= aSamples; i += 8 )
+	{
+	  __m128i s = _mm_loadu_si128( reinterpret_cast<const __m128i *>( aPcm + i ) );
+	  _mm_storeu_si128( reinterpret_cast<__m128i *>( aOut + 2 * i ), swap16( s ) );
+	}
+      }
+      toPcm16Scalar( aPcm + i, aSamples - i, aOut + 2 * i, aBigEndian );
+    }
+
+    //! Eight samples take 24 bytes, the first 16 come from one
+    //! shuffle and the last 8 from another with a zero for the low
+    //! byte of every sample
+    __attribute__((target("ssse3")))
+    void toPcm24SSSE3( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      const __m128i little0 = _mm_setr_epi8( -1, 0, 1, -1, 2, 3, -1, 4, 5, -1, 6, 7, -1, 8, 9, -1 );
+      const __m128i little1 = _mm_setr_epi8( 10, 11, -1, 12, 13, -1, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1 );
+      const __m128i big0 = _mm_setr_epi8( 1, 0, -1, 3, 2, -1, 5, 4, -1, 7, 6, -1, 9, 8, -1, 11 );
+      const __m128i big1 = _mm_setr_epi8( 10, -1, 13, 12, -1, 15, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1 );
+      const __m128i mask0 = aBigEndian ? big0 : little0;
+      const __m128i mask1 = aBigEndian ? big1 : little1;
+      size_t i = 0;
+
+      for( ; i + 8 <= aSamples; i += 8 )
+      {
+	__m128i s = _mm_loadu_si128( reinterpret_cast<const __m128i *>( aPcm + i ) );
+	_mm_storeu_si128( reinterpret_cast<__m128i *>( aOut + 3 * i ), _mm_shuffle_epi8( s, mask0 ) );
+	_mm_storel_epi64( reinterpret_cast<__m128i *>( aOut + 3 * i + 16 ), _mm_shuffle_epi8( s, mask1 ) );
+      }
+      toPcm24Scalar( aPcm + i, aSamples - i, aOut + 3 * i, aBigEndian );
+    }
+
+    //! Samples are sign extended to 32 bits by unpacking each into
+    //! the top half of a lane and shifting it down
+    __attribute__((target("sse2")))
+    void toFloat32SSE2( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      const __m128 scale = _mm_set1_ps( FLOAT_SCALE );
+      size_t i = 0;
+
+      for( ; i + 8 <= aSamples; i += 8 )
+      {
+	__m128i s = _mm_loadu_si128( reinterpret_cast<const __m128i *>( aPcm + i ) );
+	__m128i lo = _mm_castps_si128( _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpacklo_epi16( s, s ), 16 ) ), scale ) );
+	__m128i hi = _mm_castps_si128( _mm_mul_ps( _mm_cvtepi32_ps( _mm_srai_epi32( _mm_unpackhi_epi16( s, s ), 16 ) ), scale ) );
+	if( aBigEndian )
+	{
+	  lo = swap32( lo );
+	  hi = swap32( hi );
+	}
+	_mm_storeu_si128( reinterpret_cast<__m128i *>( aOut + 4 * i ), lo );
+	_mm_storeu_si128( reinterpret_cast<__m128i *>( aOut + 4 * i + 16 ), hi );
+      }
+      toFloat32Scalar( aPcm + i, aSamples - i, aOut + 4 * i, aBigEndian );
+    }
+
+    //! Sixteen samples at a time, see the SSE2 version
+    __attribute__((target("avx2")))
+    void toFloat32AVX2( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      const __m256 scale = _mm256_set1_ps( FLOAT_SCALE );
+      const __m256i swap = _mm256_setr_epi8( 3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+					     3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12 );
+      size_t i = 0;
+
+      for( ; i + 16 <= aSamples; i += 16 )
+      {
+	__m128i s0 = _mm_loadu_si128( reinterpret_cast<const __m128i *>( aPcm + i ) );
+	__m128i s1 = _mm_loadu_si128( reinterpret_cast<const __m128i *>( aPcm + i + 8 ) );
+	__m256i f0 = _mm256_castps_si256( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( s0 ) ), scale ) );
+	__m256i f1 = _mm256_castps_si256( _mm256_mul_ps( _mm256_cvtepi32_ps( _mm256_cvtepi16_epi32( s1 ) ), scale ) );
+	if( aBigEndian )
+	{
+	  f0 = _mm256_shuffle_epi8( f0, swap );
+	  f1 = _mm256_shuffle_epi8( f1, swap );
+	}
+	_mm256_storeu_si256( reinterpret_cast<__m256i *>( aOut + 4 * i ), f0 );
+	_mm256_storeu_si256( reinterpret_cast<__m256i *>( aOut + 4 * i + 32 ), f1 );
+      }
+      toFloat32SSE2( aPcm + i, aSamples - i, aOut + 4 * i, aBigEndian );
+    }
+
+#endif
+
+    //! Picks the fastest kernels the cpu supports
+    void selectKernels()
+    {
+      gPcm16Kernel = toPcm16Scalar;
+      gPcm24Kernel = toPcm24Scalar;
+      gFloat32Kernel = toFloat32Scalar;
+
+#ifdef AUDIO_WRITER_X86_KERNELS
+      __builtin_cpu_init();
+      if( __builtin_cpu_supports( "sse2" ) )
+      {
+	gPcm16Kernel = toPcm16SSE2;
+	gFloat32Kernel = toFloat32SSE2;
+      }
+      if( __builtin_cpu_supports( "ssse3" ) )
+      {
+	gPcm24Kernel = toPcm24SSSE3;
+      }
+      if( __builtin_cpu_supports( "avx2" ) )
+      {
+	gFloat32Kernel = toFloat32AVX2;
+      }
+#endif
+    }
+  }
+
+  void SampleConverter::toPcm16
+    (
+    const int16_t * aPcm,	//!< Host order cd samples
+    size_t aSamples,		//!< Samples, not frames, of aPcm
+    uint8_t * aOut,		//!< 2 bytes for each sample
+    bool aBigEndian		//!< Byte order of aOut
+    )
+  {
+    std::call_once( gKernelsOnce, selectKernels );
+    gPcm16Kernel( aPcm, aSamples, aOut, aBigEndian );
+  }
+
+  void SampleConverter::toPcm24
+    (
+    const int16_t * aPcm,	//!< Host order cd samples
+    size_t aSamples,		//!< Samples, not frames, of aPcm
+    uint8_t * aOut,		//!< 3 bytes for each sample
+    bool aBigEndian		//!< Byte order of aOut
+    )
+  {
+    std::call_once( gKernelsOnce, selectKernels );
+    gPcm24Kernel( aPcm, aSamples, aOut, aBigEndian );
+  }
+
+  void SampleConverter::toFloat32
+    (
+    const int16_t * aPcm,	//!< Host order cd samples
+    size_t aSamples,		//!< Samples, not frames, of aPcm
+    uint8_t * aOut,		//!< 4 bytes for each sample
+    bool aBigEndian		//!< Byte order of aOut
+    )
+  {
+    std::call_once( gKernelsOnce, selectKernels );
+    gFloat32Kernel( aPcm, aSamples, aOut, aBigEndian );
+  }
+
+} // end namespace SimpleRipper
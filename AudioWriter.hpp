@@ -0,0 +1,547 @@
+#ifndef AUDIO_WRITER_HPP_
+#define AUDIO_WRITER_HPP_
+
+#include <sys/types.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <new>
+#include <string>
+#include <vector>
+#include "ripper.h"
+
+namespace SimpleRipper
+{
+  //! Converts the 16 bit pcm of the cd to the samples of a file
+  //!
+  //! Each conversion has a portable version and x86 versions
+  //! picked at run time from the features of the cpu, the pcm
+  //! is in host order and aOut in the byte order asked for.
+  class SampleConverter
+  {
+    public:
+
+      static void toPcm16
+	(
+	const int16_t * aPcm,
+	size_t aSamples,
+	uint8_t * aOut,
+	bool aBigEndian
+	);
+
+      //! The cd samples become the top 16 bits
+      static void toPcm24
+	(
+	const int16_t * aPcm,
+	size_t aSamples,
+	uint8_t * aOut,
+	bool aBigEndian
+	);
+
+      //! Samples are scaled to -1.0 up to 1.0
+      static void toFloat32
+	(
+	const int16_t * aPcm,
+	size_t aSamples,
+	uint8_t * aOut,
+	bool aBigEndian
+	);
+  };
+
+  //! 16 bit integer samples as read from the cd
+  struct Pcm16
+  {
+    static const uint BITS = 16;
+    static const uint BYTES = 2;
+    static const bool IS_FLOAT = false;
+
+    static inline void convert( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      SampleConverter::toPcm16( aPcm, aSamples, aOut, aBigEndian );
+    }
+  };
+
+  //! 24 bit integer samples
+  struct Pcm24
+  {
+    static const uint BITS = 24;
+    static const uint BYTES = 3;
+    static const bool IS_FLOAT = false;
+
+    static inline void convert( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      SampleConverter::toPcm24( aPcm, aSamples, aOut, aBigEndian );
+    }
+  };
+
+  //! 32 bit ieee float samples
+  struct Float32
+  {
+    static const uint BITS = 32;
+    static const uint BYTES = 4;
+    static const bool IS_FLOAT = true;
+
+    static inline void convert( const int16_t * aPcm, size_t aSamples, uint8_t * aOut, bool aBigEndian )
+    {
+      SampleConverter::toFloat32( aPcm, aSamples, aOut, aBigEndian );
+    }
+  };
+
+  //! Bytes of the header constants and setters for the sizes
+  //! only known once the track is
+  namespace AudioHeader
+  {
+    constexpr uint8_t le( uint64_t aValue, uint aByte ) { return uint8_t( aValue >> ( 8 * aByte ) ); }
+
+    //! aByte counts from the most significant of aBytes
+    constexpr uint8_t be( uint64_t aValue, uint aByte, uint aBytes ) { return uint8_t( aValue >> ( 8 * ( aBytes - 1 - aByte ) ) ); }
+
+    inline void putLE( uint8_t * aOut, uint64_t aValue, uint aBytes )
+    {
+      for( uint i = 0; i < aBytes; i++ )
+      {
+	aOut[i] = le( aValue, i );
+      }
+    }
+
+    inline void putBE( uint8_t * aOut, uint64_t aValue, uint aBytes )
+    {
+      for( uint i = 0; i < aBytes; i++ )
+      {
+	aOut[i] = be( aValue, i, aBytes );
+      }
+    }
+
+    //! 44100 as an 80 bit extended float, for aiff
+    constexpr uint8_t EXTENDED_RATE[10] = { 0x40, 0x0e, 0xac, 0x44, 0, 0, 0, 0, 0, 0 };
+
+    //! Bits of 44100.0 as a double, for caf
+    const uint64_t DOUBLE_RATE = 0x40e5888000000000ULL;
+  }
+
+  //! Layouts of the file formats.  HEADER is every byte before
+  //! the samples with the sizes left at 0 and setDataSize fills
+  //! them in for aBytes of samples.  Samples are big endian when
+  //! BIG_ENDIAN_SAMPLES is set.
+
+  //! Wav, float samples need the extended format and a fact chunk
+  template<class SampleType, bool Float = SampleType::IS_FLOAT>
+  struct WavLayout
+  {
+    typedef SampleType Sample;
+    static const bool BIG_ENDIAN_SAMPLES = false;
+    static const uint BLOCK_ALIGN = NUM_CHANNELS * Sample::BYTES;
+
+    static constexpr uint8_t HEADER[] =
+      {
+      'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+      'f', 'm', 't', ' ', 16, 0, 0, 0,
+      1, 0, NUM_CHANNELS, 0,
+      AudioHeader::le( SAMPLE_RATE, 0 ), AudioHeader::le( SAMPLE_RATE, 1 ), AudioHeader::le( SAMPLE_RATE, 2 ), AudioHeader::le( SAMPLE_RATE, 3 ),
+      AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 0 ), AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 1 ),
+      AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 2 ), AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 3 ),
+      BLOCK_ALIGN, 0, Sample::BITS, 0,
+      'd', 'a', 't', 'a', 0, 0, 0, 0
+      };
+
+    static inline void setDataSize( uint8_t * aHeader, uint64_t aBytes )
+    {
+      AudioHeader::putLE( aHeader + 4, sizeof( HEADER ) - 8 + aBytes, 4 );
+      AudioHeader::putLE( aHeader + 40, aBytes, 4 );
+    }
+  };
+
+  template<class SampleType>
+  struct WavLayout<SampleType, true>
+  {
+    typedef SampleType Sample;
+    static const bool BIG_ENDIAN_SAMPLES = false;
+    static const uint BLOCK_ALIGN = NUM_CHANNELS * Sample::BYTES;
+
+    static constexpr uint8_t HEADER[] =
+      {
+      'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+      'f', 'm', 't', ' ', 18, 0, 0, 0,
+      3, 0, NUM_CHANNELS, 0,
+      AudioHeader::le( SAMPLE_RATE, 0 ), AudioHeader::le( SAMPLE_RATE, 1 ), AudioHeader::le( SAMPLE_RATE, 2 ), AudioHeader::le( SAMPLE_RATE, 3 ),
+      AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 0 ), AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 1 ),
+      AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 2 ), AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 3 ),
+      BLOCK_ALIGN, 0, Sample::BITS, 0, 0, 0,
+      'f', 'a', 'c', 't', 4, 0, 0, 0, 0, 0, 0, 0,
+      'd', 'a', 't', 'a', 0, 0, 0, 0
+      };
+
+    static inline void setDataSize( uint8_t * aHeader, uint64_t aBytes )
+    {
+      AudioHeader::putLE( aHeader + 4, sizeof( HEADER ) - 8 + aBytes, 4 );
+      AudioHeader::putLE( aHeader + 46, aBytes / BLOCK_ALIGN, 4 );
+      AudioHeader::putLE( aHeader + 54, aBytes, 4 );
+    }
+  };
+
+  template<class SampleType, bool Float>
+  constexpr uint8_t WavLayout<SampleType, Float>::HEADER[];
+
+  template<class SampleType>
+  constexpr uint8_t WavLayout<SampleType, true>::HEADER[];
+
+  //! Rf64, a wav whose sizes are kept in a ds64 chunk so a file
+  //! may grow past 4GB
+  template<class SampleType>
+  struct Rf64Layout
+  {
+    typedef SampleType Sample;
+    static const bool BIG_ENDIAN_SAMPLES = false;
+    static const uint BLOCK_ALIGN = NUM_CHANNELS * Sample::BYTES;
+    static const uint FMT_SIZE = Sample::IS_FLOAT ? 18 : 16;
+
+    static constexpr uint8_t HEADER[] =
+      {
+      'R', 'F', '6', '4', 0xff, 0xff, 0xff, 0xff, 'W', 'A', 'V', 'E',
+      'd', 's', '6', '4', 28, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 0, 0, 0,
+      0, 0, 0, 0,
+      'f', 'm', 't', ' ', FMT_SIZE, 0, 0, 0,
+      Sample::IS_FLOAT ? 3 : 1, 0, NUM_CHANNELS, 0,
+      AudioHeader::le( SAMPLE_RATE, 0 ), AudioHeader::le( SAMPLE_RATE, 1 ), AudioHeader::le( SAMPLE_RATE, 2 ), AudioHeader::le( SAMPLE_RATE, 3 ),
+      AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 0 ), AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 1 ),
+      AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 2 ), AudioHeader::le( SAMPLE_RATE * BLOCK_ALIGN, 3 ),
+      BLOCK_ALIGN, 0, Sample::BITS, 0,
+      // cbSize of the float format, dropped for integers
+      0, 0,
+      'd', 'a', 't', 'a', 0xff, 0xff, 0xff, 0xff
+      };
+
+    //! The integer formats end without cbSize
+    static const size_t HEADER_SIZE = sizeof( HEADER ) - ( Sample::IS_FLOAT ? 0 : 2 );
+
+    static inline void setDataSize( uint8_t * aHeader, uint64_t aBytes )
+    {
+      if( !Sample::IS_FLOAT )
+      {
+	memmove( aHeader + 72, aHeader + 74, 8 );
+      }
+      AudioHeader::putLE( aHeader + 20, HEADER_SIZE - 8 + aBytes, 8 );
+      AudioHeader::putLE( aHeader + 28, aBytes, 8 );
+      AudioHeader::putLE( aHeader + 36, aBytes / BLOCK_ALIGN, 8 );
+    }
+  };
+
+  template<class SampleType>
+  constexpr uint8_t Rf64Layout<SampleType>::HEADER[];
+
+  //! Aiff with big endian integers, aiff-c with fl32 for floats
+  template<class SampleType, bool Float = SampleType::IS_FLOAT>
+  struct AiffLayout
+  {
+    typedef SampleType Sample;
+    static const bool BIG_ENDIAN_SAMPLES = true;
+    static const uint BLOCK_ALIGN = NUM_CHANNELS * Sample::BYTES;
+
+    static constexpr uint8_t HEADER[] =
+      {
+      'F', 'O', 'R', 'M', 0, 0, 0, 0, 'A', 'I', 'F', 'F',
+      'C', 'O', 'M', 'M', 0, 0, 0, 18,
+      0, NUM_CHANNELS, 0, 0, 0, 0, 0, Sample::BITS,
+      AudioHeader::EXTENDED_RATE[0], AudioHeader::EXTENDED_RATE[1], AudioHeader::EXTENDED_RATE[2], AudioHeader::EXTENDED_RATE[3],
+      AudioHeader::EXTENDED_RATE[4], AudioHeader::EXTENDED_RATE[5], AudioHeader::EXTENDED_RATE[6], AudioHeader::EXTENDED_RATE[7],
+      AudioHeader::EXTENDED_RATE[8], AudioHeader::EXTENDED_RATE[9],
+      'S', 'S', 'N', 'D', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+      };
+
+    static inline void setDataSize( uint8_t * aHeader, uint64_t aBytes )
+    {
+      AudioHeader::putBE( aHeader + 4, sizeof( HEADER ) - 8 + aBytes, 4 );
+      AudioHeader::putBE( aHeader + 22, aBytes / BLOCK_ALIGN, 4 );
+      AudioHeader::putBE( aHeader + 42, aBytes + 8, 4 );
+    }
+  };
+
+  template<class SampleType>
+  struct AiffLayout<SampleType, true>
+  {
+    typedef SampleType Sample;
+    static const bool BIG_ENDIAN_SAMPLES = true;
+    static const uint BLOCK_ALIGN = NUM_CHANNELS * Sample::BYTES;
+
+    static constexpr uint8_t HEADER[] =
+      {
+      'F', 'O', 'R', 'M', 0, 0, 0, 0, 'A', 'I', 'F', 'C',
+      'F', 'V', 'E', 'R', 0, 0, 0, 4, 0xa2, 0x80, 0x51, 0x40,
+      'C', 'O', 'M', 'M', 0, 0, 0, 24,
+      0, NUM_CHANNELS, 0, 0, 0, 0, 0, Sample::BITS,
+      AudioHeader::EXTENDED_RATE[0], AudioHeader::EXTENDED_RATE[1], AudioHeader::EXTENDED_RATE[2], AudioHeader::EXTENDED_RATE[3],
+      AudioHeader::EXTENDED_RATE[4], AudioHeader::EXTENDED_RATE[5], AudioHeader::EXTENDED_RATE[6], AudioHeader::EXTENDED_RATE[7],
+      AudioHeader::EXTENDED_RATE[8], AudioHeader::EXTENDED_RATE[9],
+      'f', 'l', '3', '2', 0, 0,
+      'S', 'S', 'N', 'D', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0
+      };
+
+    static inline void setDataSize( uint8_t * aHeader, uint64_t aBytes )
+    {
+      AudioHeader::putBE( aHeader + 4, sizeof( HEADER ) - 8 + aBytes, 4 );
+      AudioHeader::putBE( aHeader + 34, aBytes / BLOCK_ALIGN, 4 );
+      AudioHeader::putBE( aHeader + 60, aBytes + 8, 4 );
+    }
+  };
+
+  template<class SampleType, bool Float>
+  constexpr uint8_t AiffLayout<SampleType, Float>::HEADER[];
+
+  template<class SampleType>
+  constexpr uint8_t AiffLayout<SampleType, true>::HEADER[];
+
+  //! Core audio format.  The header is big endian, the samples
+  //! are flagged little endian so they are written as for wav
+  template<class SampleType>
+  struct CafLayout
+  {
+    typedef SampleType Sample;
+    static const bool BIG_ENDIAN_SAMPLES = false;
+    static const uint BLOCK_ALIGN = NUM_CHANNELS * Sample::BYTES;
+    //! kCAFLinearPCMFormatFlagIsFloat and IsLittleEndian
+    static const uint FORMAT_FLAGS = ( Sample::IS_FLOAT ? 1 : 0 ) | 2;
+
+    static constexpr uint8_t HEADER[] =
+      {
+      'c', 'a', 'f', 'f', 0, 1, 0, 0,
+      'd', 'e', 's', 'c', 0, 0, 0, 0, 0, 0, 0, 32,
+      AudioHeader::be( AudioHeader::DOUBLE_RATE, 0, 8 ), AudioHeader::be( AudioHeader::DOUBLE_RATE, 1, 8 ),
+      AudioHeader::be( AudioHeader::DOUBLE_RATE, 2, 8 ), AudioHeader::be( AudioHeader::DOUBLE_RATE, 3, 8 ),
+      AudioHeader::be( AudioHeader::DOUBLE_RATE, 4, 8 ), AudioHeader::be( AudioHeader::DOUBLE_RATE, 5, 8 ),
+      AudioHeader::be( AudioHeader::DOUBLE_RATE, 6, 8 ), AudioHeader::be( AudioHeader::DOUBLE_RATE, 7, 8 ),
+      'l', 'p', 'c', 'm', 0, 0, 0, FORMAT_FLAGS,
+      0, 0, 0, BLOCK_ALIGN, 0, 0, 0, 1, 0, 0, 0, NUM_CHANNELS, 0, 0, 0, Sample::BITS,
+      'd', 'a', 't', 'a', 0, 0, 0, 0, 0, 0, 0, 0,
+      // edit count
+      0, 0, 0, 0
+      };
+
+    static inline void setDataSize( uint8_t * aHeader, uint64_t aBytes )
+    {
+      AudioHeader::putBE( aHeader + 56, aBytes + 4, 8 );
+    }
+  };
+
+  template<class SampleType>
+  constexpr uint8_t CafLayout<SampleType>::HEADER[];
+
+  //! Size of a layout's header in the file
+  template<class Layout>
+  struct HeaderSize
+  {
+    static const size_t VALUE = sizeof( Layout::HEADER );
+  };
+
+  template<class SampleType>
+  struct HeaderSize< Rf64Layout<SampleType> >
+  {
+    static const size_t VALUE = Rf64Layout<SampleType>::HEADER_SIZE;
+  };
+
+  //! Writes every ripped span to its own file in the layout
+  //!
+  //! The header of each file is copied from the layout, given
+  //! its sizes and written in one call before the samples.  The
+  //! samples are converted a batch at a time into a buffer kept
+  //! for the next batch.  A file the rip failed to finish is
+  //! removed.  The writer must outlive the sink it hands out.
+  template<class Layout>
+  class AudioWriter
+  {
+    public:
+      typedef typename Layout::Sample Sample;
+
+      //! Size of the header in front of the samples
+      static const size_t HEADER_SIZE = HeaderSize<Layout>::VALUE;
+
+    public:
+
+      //! aPath is a filename or, when aPattern is set, a printf
+      //! style pattern taking the track number
+      explicit AudioWriter
+	(
+	const char * aPath,
+	bool aPattern = false
+	)
+      : mPath( aPath )
+      , mPattern( aPattern )
+      , mFd( -1 )
+      {
+      }
+
+      virtual ~AudioWriter()
+      {
+	if( mFd != -1 )
+	{
+	  close( mFd );
+	}
+      }
+
+      AudioWriter( const AudioWriter & ) = delete;
+      AudioWriter & operator=( const AudioWriter & ) = delete;
+
+      //! Fills aHeader, HEADER_SIZE bytes, for a file of aSectors
+      static void getHeader
+	(
+	uint8_t * aHeader,
+	uint64_t aSectors
+	)
+      {
+	memcpy( aHeader, Layout::HEADER, sizeof( Layout::HEADER ) );
+	Layout::setDataSize( aHeader, aSectors * getSectorBytes() );
+      }
+
+      //! \return the bytes a raw cd sector takes in the file
+      static inline size_t getSectorBytes() { return CDIO_CD_FRAMESIZE_RAW / sizeof( int16_t ) * Sample::BYTES; }
+
+      //! \return a sink writing the spans, for ripperRipTrackSink
+      //! and ripperRipDiscSink
+      ripper_sink_t getSink()
+      {
+	ripper_sink_t sink;
+
+	memset( &sink, 0, sizeof( sink ) );
+	sink.begin = &AudioWriter::sinkBegin;
+	sink.write = &AudioWriter::sinkWrite;
+	sink.end = &AudioWriter::sinkEnd;
+	sink.data = this;
+	return sink;
+      }
+
+      //! \return the file being written or last written
+      inline const std::string & getFilename() const { return mFilename; }
+
+    private:
+
+      //! Writes all of aData, short writes are carried on
+      //! \return 1 on success and -1 on error
+      int put
+	(
+	const uint8_t * aData,
+	size_t aLength
+	)
+      {
+	while( aLength > 0 )
+	{
+	  ssize_t written = ::write( mFd, aData, aLength );
+	  if( written < 0 && errno == EINTR )
+	  {
+	    continue;
+	  }
+	  if( written <= 0 )
+	  {
+	    return -1;
+	  }
+	  aData += written;
+	  aLength -= written;
+	}
+	return 1;
+      }
+
+      static int sinkBegin
+	(
+	ripper_sink_t * aSink,
+	const ripper_span_t * aSpan
+	)
+      {
+	AudioWriter * writer = static_cast<AudioWriter *>( aSink->data );
+	char filename[FILENAME_MAX];
+
+	if( writer->mPattern )
+	{
+	  snprintf( filename, sizeof( filename ), writer->mPath.c_str(), aSpan->track );
+	}
+	else
+	{
+	  snprintf( filename, sizeof( filename ), "%s", writer->mPath.c_str() );
+	}
+	writer->mFilename = filename;
+	writer->mFd = open( filename, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+	if( writer->mFd == -1 )
+	{
+	  printf( "Error: Unable to open file %s for writing.\n", filename );
+	  return -1;
+	}
+
+	uint8_t header[sizeof( Layout::HEADER )];
+	getHeader( header, aSpan->last - aSpan->first + 1 );
+	return writer->put( header, HEADER_SIZE );
+      }
+
+      static int sinkWrite
+	(
+	ripper_sink_t * aSink,
+	const int16_t * aPcm,
+	long aSectors
+	)
+      {
+	AudioWriter * writer = static_cast<AudioWriter *>( aSink->data );
+	size_t samples = aSectors * ( CDIO_CD_FRAMESIZE_RAW / sizeof( int16_t ) );
+
+	try
+	{
+	  if( writer->mBuffer.size() < samples * Sample::BYTES )
+	  {
+	    writer->mBuffer.resize( samples * Sample::BYTES );
+	  }
+	}
+	catch( const std::bad_alloc & )
+	{
+	  return -1;
+	}
+	Sample::convert( aPcm, samples, writer->mBuffer.data(), Layout::BIG_ENDIAN_SAMPLES );
+	return writer->put( writer->mBuffer.data(), samples * Sample::BYTES );
+      }
+
+      static int sinkEnd
+	(
+	ripper_sink_t * aSink,
+	int aStatus
+	)
+      {
+	AudioWriter * writer = static_cast<AudioWriter *>( aSink->data );
+
+	if( writer->mFd != -1 && close( writer->mFd ) != 0 )
+	{
+	  aStatus = -1;
+	}
+	writer->mFd = -1;
+	if( aStatus != 1 )
+	{
+	  unlink( writer->mFilename.c_str() );
+	}
+	return aStatus;
+      }
+
+    protected:
+
+      std::string		mPath;		//!< Filename or pattern of the files
+      bool			mPattern;	//!< Set when mPath takes the track number
+      std::string		mFilename;	//!< File of the current span
+      int			mFd;		//!< Open file or -1
+      std::vector<uint8_t>	mBuffer;	//!< Samples of the last batch converted
+
+  };
+
+  typedef AudioWriter< WavLayout<Pcm16> >	Wav16Writer;
+  typedef AudioWriter< WavLayout<Pcm24> >	Wav24Writer;
+  typedef AudioWriter< WavLayout<Float32> >	WavFloatWriter;
+  typedef AudioWriter< Rf64Layout<Pcm16> >	Rf6416Writer;
+  typedef AudioWriter< Rf64Layout<Pcm24> >	Rf6424Writer;
+  typedef AudioWriter< Rf64Layout<Float32> >	Rf64FloatWriter;
+  typedef AudioWriter< AiffLayout<Pcm16> >	Aiff16Writer;
+  typedef AudioWriter< AiffLayout<Pcm24> >	Aiff24Writer;
+  typedef AudioWriter< AiffLayout<Float32> >	AiffFloatWriter;
+  typedef AudioWriter< CafLayout<Pcm16> >	Caf16Writer;
+  typedef AudioWriter< CafLayout<Pcm24> >	Caf24Writer;
+  typedef AudioWriter< CafLayout<Float32> >	CafFloatWriter;
+
+} // end namespace SimpleRipper
+
+#endif
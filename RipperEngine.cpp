@@ -1,19 +1,118 @@
-
+#include <stdexcept>
 #include "RipperEngine.hpp"
 
 namespace SimpleRipper
 {
   RipperEngine::RipperEngine
     (
-    CDDrive & aDrive	//!< CD Drive to rip tracks from
+    const char * aSource,	//!< Device or disc image, NULL for the first drive
+    driver_id_t aDriver		//!< libcdio driver used to open aSource
+    )
+  : mRipper( ripperInitSource( aSource, aDriver ) )
+  {
+    if( mRipper == NULL )
+    {
+      throw std::runtime_error( "Unable to open the cd" );
+    }
+  }
+
+  RipperEngine::RipperEngine
+    (
+    ripper_cd_data_t * aRipper	//!< Ripper the engine takes over
+    )
+  : mRipper( aRipper )
+  {
+    if( mRipper == NULL )
+    {
+      throw std::invalid_argument( "No ripper was given" );
+    }
+  }
+
+  RipperEngine::RipperEngine
+    (
+    RipperEngine && aOther	//!< Engine giving up its ripper
+    )
+  : mRipper( aOther.mRipper )
+  {
+    aOther.mRipper = NULL;
+  }
+
+  RipperEngine & RipperEngine::operator=
+    (
+    RipperEngine && aOther	//!< Engine giving up its ripper
     )
-  : mDrive( aDrive )
-  , mType( aDrive.getCDType() )
   {
+    if( this != &aOther )
+    {
+      ripperCDDataDestroy( mRipper );
+      mRipper = aOther.mRipper;
+      aOther.mRipper = NULL;
+    }
+    return *this;
   }
-  
+
   RipperEngine::~RipperEngine()
   {
+    ripperCDDataDestroy( mRipper );
+  }
+
+  bool RipperEngine::ripTrack
+    (
+    uint aTrackNum,		//!< Track to rip, starting at 1
+    const char * aFilename	//!< File to write the track to
+    )
+  {
+    return ripperRipTrack( mRipper, aTrackNum, const_cast<char *>( aFilename ) ) == 1;
   }
-   
-} // end namespace SimpleRipper
\ No newline at end of file
+
+  bool RipperEngine::ripTrack
+    (
+    uint aTrackNum,		//!< Track to rip, starting at 1
+    ripper_sink_t & aSink	//!< Sink receiving the audio
+    )
+  {
+    return ripperRipTrackSink( mRipper, aTrackNum, &aSink ) == 1;
+  }
+
+  bool RipperEngine::ripTrack
+    (
+    uint aTrackNum,		//!< Track to rip, starting at 1
+    AudioTrack & aTrack		//!< Track receiving the pcm
+    )
+  {
+    ripper_sink_t sink = aTrack.getSink();
+
+    if( ripperRipTrackSink( mRipper, aTrackNum, &sink ) != 1 )
+    {
+      return false;
+    }
+    const ripper_track_checksums_t * checksums = getRipperTrackChecksums( mRipper, aTrackNum );
+    if( checksums != NULL )
+    {
+      aTrack.setChecksums( *checksums );
+    }
+    return true;
+  }
+
+  AudioTrack RipperEngine::ripTrack
+    (
+    uint aTrackNum,		//!< Track to rip, starting at 1
+    SectorArena & aArena	//!< Arena holding the pcm
+    )
+  {
+    AudioTrack track( aArena );
+
+    ripTrack( aTrackNum, track );
+    return track;
+  }
+
+  bool RipperEngine::ripDisc
+    (
+    RIPPER_DISC_OUTPUT_TYPE aOutput,	//!< Track files or bin/cue
+    const char * aFilename		//!< Filename or track pattern
+    )
+  {
+    return ripperRipDisc( mRipper, aOutput, aFilename ) == 1;
+  }
+
+} // end namespace SimpleRipper
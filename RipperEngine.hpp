@@ -1,65 +1,198 @@
-
 #ifndef RIPPER_ENGINE_HPP_
 #define RIPPER_ENGINE_HPP_
 
 #include <sys/types.h>
+#include "ripper.h"
+#include "AudioTrack.hpp"
 
 namespace SimpleRipper
 {
-  // Forward Declarations
-  class CDDrive;
-  class AudioDrive;
-  class AudioTrack;
-
-  //! Abstract class for ripping audo tracks from a cd
+  //! Rips audio tracks from a cd through the libripper c api
+  //!
+  //! The engine owns its ripper_cd_data_t and with it the cdio,
+  //! cdda and paranoia handles, which are released when the
+  //! engine is destroyed.  Engines can be moved but not copied.
+  //! Progress and cancel may be used from any thread while a
+  //! rip is running on another one.
   class RipperEngine
   {
     public:
       //! Type of cd in the drive
       typedef enum
       {
-	AUDIO_CD,
-	DATA_CD,
-	MIXED_MODE_CD,
-	NO_CD
-      } CDType;      
-      
+	AUDIO_CD = ::AUDIO_CD,
+	DATA_CD = ::DATA_CD,
+	MIXED_MODE_CD = ::MIXED_MODE_CD,
+	NO_CD = ::NO_CD
+      } CDType;
+
     public:
-      
+
+      //! Opens the cd in aSource, see ripperInitSource
+      //! Throws std::runtime_error if the source can't be opened
+      explicit RipperEngine
+	(
+	const char * aSource = NULL,
+	driver_id_t aDriver = DRIVER_DEVICE
+	);
+
+      //! Takes ownership of a ripper opened with ripperInit
+      explicit RipperEngine
+	(
+	ripper_cd_data_t * aRipper
+	);
+
       RipperEngine
 	(
-	CDDrive & aDrive
+	RipperEngine && aOther
+	);
+
+      RipperEngine & operator=
+	(
+	RipperEngine && aOther
+	);
+
+      virtual ~RipperEngine();
+
+      //! Rips the track to aFilename in the engine's format
+      //! \return true on success
+      bool ripTrack
+	(
+	uint aTrackNum,
+	const char * aFilename
+	);
+
+      //! Rips the track into aSink
+      //! \return true on success
+      bool ripTrack
+	(
+	uint aTrackNum,
+	ripper_sink_t & aSink
+	);
+
+      //! Rips the track into memory, aTrack is cleared first and
+      //! keeps its blocks if the rip fails
+      //! \return true on success
+      bool ripTrack
+	(
+	uint aTrackNum,
+	AudioTrack & aTrack
+	);
+
+      //! Rips the track into a new AudioTrack stored in aArena
+      //! \return the track, incomplete if the rip failed
+      AudioTrack ripTrack
+	(
+	uint aTrackNum,
+	SectorArena & aArena
+	);
+
+      //! Rips every audio track, see ripperRipDisc
+      //! \return true on success
+      bool ripDisc
+	(
+	RIPPER_DISC_OUTPUT_TYPE aOutput,
+	const char * aFilename
 	);
-      
-      virtual RipperEngine();
-      
-      virtual AudioTrack * ripTrack
+
+      //! Rips the track, or every audio track for 0, and calls
+      //! aCallback( const int16_t * aPcm, long aSectors, int aTrackNum )
+      //! for every batch.  The pcm is only valid during the call and
+      //! the callback returns false to stop the rip
+      //! \return true on success
+      template<class Callback>
+      bool streamTrack
+	(
+	uint aTrackNum,
+	Callback & aCallback
+	)
+      {
+	return ripperRipTrackStream( mRipper, aTrackNum, &RipperEngine::streamBatch<Callback>, &aCallback ) == 1;
+      }
+
+      //! Stops the rip in progress, safe to call from any thread
+      inline void cancel() { ripperCancelRip( mRipper ); }
+
+      //! \return how much of the current rip is done from 0 to 100
+      inline int getProgress() const { return getRipperProgress( mRipper ); }
+
+      //! \return the checksums of a ripped track or NULL
+      inline const ripper_track_checksums_t * getChecksums
+	(
+	uint aTrackNum
+	) const
+      {
+	return getRipperTrackChecksums( mRipper, aTrackNum );
+      }
+
+      //! \return the statistics of the last rip of a track or NULL
+      inline const ripper_rip_stats_t * getStats
 	(
 	uint aTrackNum
-	int * aProgress,
-	bool * aCancel
-	) = 0;
-	
-      inline void setDrive
+	) const
+      {
+	return getRipperTrackStats( mRipper, aTrackNum );
+      }
+
+      //! \return the statistics of the last rip
+      inline const ripper_rip_stats_t * getStats() const { return getRipperRipStats( mRipper ); }
+
+      inline CDType getCDType() const { return static_cast<CDType>( getRipperCDType( mRipper ) ); }
+
+      inline int getNumTracks() const { return getRipperNumTracks( mRipper ); }
+
+      inline int getNumAudioTracks() const { return getRipperNumAudioTracks( mRipper ); }
+
+      inline void setFormat
+	(
+	RIPPER_FORMAT_TYPE aFormat
+	)
+      {
+	setRipperFormat( mRipper, aFormat );
+      }
+
+      inline void setReadMode
+	(
+	RIPPER_READ_MODE aMode
+	)
+      {
+	setRipperReadMode( mRipper, aMode );
+      }
+
+      inline void setPipelineDepth
+	(
+	uint aDepth
+	)
+      {
+	setRipperPipelineDepth( mRipper, aDepth );
+      }
+
+      //! \return the underlying ripper, still owned by the engine
+      inline ripper_cd_data_t * getRipper() const { return mRipper; }
+
+    private:
+
+      RipperEngine( const RipperEngine & ) = delete;
+      RipperEngine & operator=( const RipperEngine & ) = delete;
+
+      template<class Callback>
+      static int streamBatch
 	(
-	CDDrive * aDrive	//!< Pointer to the cd drive to use
+	const int16_t * aPcm,
+	long aSectors,
+	int aTrackNum,
+	void * aCallback
 	)
       {
-	mDrive = aDrive;
-      }	  
-	
-      inline const CDDrive & getDrive() const { return mDrive; }
-      
-      inline CDType getCDType() const { return mType; }
-      
+	return ( *static_cast<Callback *>( aCallback ) )( aPcm, aSectors, aTrackNum ) ? 1 : -1;
+      }
+
     protected:
-      
-      CDType	&mType;		//!< CD Type - Audio, Mixed Mode, etc	
-      CDDrive 	*mDrive;	//!< Pointer to the cd drive in use
-      
-	
+
+      ripper_cd_data_t	*mRipper;	//!< Ripper owning the drive handles, NULL once moved from
+
   };
 
 } //end namespace SimpleRipper
 
-#endif
\ No newline at end of file
+#endif
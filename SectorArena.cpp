@@ -0,0 +1,124 @@
+#include <stdlib.h>
+#include <new>
+#include "SectorArena.hpp"
+
+namespace SimpleRipper
+{
+  const size_t SectorArena::SECTORS_PER_BLOCK;
+  const size_t SectorArena::BLOCK_SIZE;
+
+  SectorArena::SectorArena
+    (
+    size_t aMaxFreeBlocks	//!< Blocks kept for reuse, 0 keeps every block
+    )
+  : mAllocated( 0 )
+  , mMaxFreeBlocks( aMaxFreeBlocks )
+  {
+  }
+
+  SectorArena::~SectorArena()
+  {
+    trim();
+  }
+
+  int16_t * SectorArena::allocateBlock()
+  {
+    void * block = NULL;
+
+    if( posix_memalign( &block, RIPPER_BUFFER_ALIGNMENT, BLOCK_SIZE ) != 0 )
+    {
+      return NULL;
+    }
+    return static_cast<int16_t *>( block );
+  }
+
+  int16_t * SectorArena::acquire()
+  {
+    std::lock_guard<std::mutex> lock( mLock );
+
+    if( !mFree.empty() )
+    {
+      int16_t * block = mFree.back();
+      mFree.pop_back();
+      return block;
+    }
+
+    int16_t * block = allocateBlock();
+    if( block == NULL )
+    {
+      throw std::bad_alloc();
+    }
+    mAllocated++;
+    // keep room for every block so release never allocates
+    mFree.reserve( mAllocated );
+    return block;
+  }
+
+  void SectorArena::release
+    (
+    int16_t * aBlock	//!< Block from acquire
+    )
+  {
+    if( aBlock == NULL )
+    {
+      return;
+    }
+
+    std::lock_guard<std::mutex> lock( mLock );
+
+    if( mMaxFreeBlocks != 0 && mFree.size() >= mMaxFreeBlocks )
+    {
+      free( aBlock );
+      mAllocated--;
+    }
+    else
+    {
+      mFree.push_back( aBlock );
+    }
+  }
+
+  void SectorArena::reserve
+    (
+    size_t aBlocks	//!< Number of free blocks wanted
+    )
+  {
+    std::lock_guard<std::mutex> lock( mLock );
+
+    mFree.reserve( mAllocated + aBlocks );
+    while( mFree.size() < aBlocks )
+    {
+      int16_t * block = allocateBlock();
+      if( block == NULL )
+      {
+	throw std::bad_alloc();
+      }
+      mAllocated++;
+      mFree.push_back( block );
+    }
+  }
+
+  void SectorArena::trim()
+  {
+    std::lock_guard<std::mutex> lock( mLock );
+
+    for( size_t i = 0; i < mFree.size(); i++ )
+    {
+      free( mFree[i] );
+    }
+    mAllocated -= mFree.size();
+    mFree.clear();
+  }
+
+  size_t SectorArena::getFreeBlocks() const
+  {
+    std::lock_guard<std::mutex> lock( mLock );
+    return mFree.size();
+  }
+
+  size_t SectorArena::getAllocatedBlocks() const
+  {
+    std::lock_guard<std::mutex> lock( mLock );
+    return mAllocated;
+  }
+
+} // end namespace SimpleRipper
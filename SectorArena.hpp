@@ -0,0 +1,82 @@
+#ifndef SECTOR_ARENA_HPP_
+#define SECTOR_ARENA_HPP_
+
+#include <sys/types.h>
+#include <mutex>
+#include <vector>
+#include "ripper.h"
+
+namespace SimpleRipper
+{
+  //! Pool of sector aligned blocks that AudioTracks store pcm in
+  //!
+  //! Blocks given back by tracks are kept and handed out again,
+  //! so once an arena has held the largest track or disc ripped
+  //! later rips don't allocate at all.  Every block is the same
+  //! size which keeps the heap from fragmenting.  The arena may
+  //! be shared by tracks on different threads and must outlive
+  //! the tracks using it.
+  class SectorArena
+  {
+    public:
+      //! Number of raw cd sectors in each block
+      static const size_t SECTORS_PER_BLOCK = 1024;
+
+      //! Size of each block in bytes, a multiple of RIPPER_BUFFER_ALIGNMENT
+      static const size_t BLOCK_SIZE = SECTORS_PER_BLOCK * CDIO_CD_FRAMESIZE_RAW;
+
+    public:
+
+      //! Creates an empty arena
+      explicit SectorArena
+	(
+	size_t aMaxFreeBlocks = 0
+	);
+
+      ~SectorArena();
+
+      SectorArena( const SectorArena & ) = delete;
+      SectorArena & operator=( const SectorArena & ) = delete;
+
+      //! \return a block from the pool or a new one
+      //! Throws std::bad_alloc if no block can be allocated
+      int16_t * acquire();
+
+      //! Returns a block to the pool
+      void release
+	(
+	int16_t * aBlock
+	);
+
+      //! Allocates blocks until aBlocks are free
+      void reserve
+	(
+	size_t aBlocks
+	);
+
+      //! Frees every block in the pool
+      void trim();
+
+      //! \return the number of blocks waiting in the pool
+      size_t getFreeBlocks() const;
+
+      //! \return the number of blocks allocated by the arena
+      size_t getAllocatedBlocks() const;
+
+    private:
+
+      //! Allocates one aligned block, NULL on failure
+      static int16_t * allocateBlock();
+
+    protected:
+
+      mutable std::mutex	mLock;		//!< Guards the pool
+      std::vector<int16_t *>	mFree;		//!< Blocks ready to be handed out
+      size_t			mAllocated;	//!< Blocks allocated and not freed
+      size_t			mMaxFreeBlocks;	//!< Blocks kept in the pool, 0 for all
+
+  };
+
+} //end namespace SimpleRipper
+
+#endif
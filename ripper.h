@@ -1,18 +1,26 @@
 #ifndef RIPPER_H_
 #define RIPPER_H_
+#include <stdio.h>
 #include <sys/types.h>
+#include <pthread.h>
 #include <cdio/cdio.h>
 #include <cdio/cdda.h>
 #include <cdio/cd_types.h>
 #include <cdio/paranoia.h>
 #include <cddb/cddb.h>
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 //wav header constants
 const static char WAV_HDR_CHNK_ID[] = "RIFF";
 const static char RIFF_TYPE[] = "WAVE";
 const static char FORMAT_ID[] = "fmt ";
 const static char DATA_ID[] = "data";
-//may make some of the following definitions configurable later.
+//format of the wav files the C library writes, 16 bit
+//stereo at 44100Hz.  AudioWriter.hpp writes other sample
+//formats and containers from the C++ wrapper
 const static int FMT_CHUNK_SIZE = 16;
 const static int SAMPLE_RATE = 44100;
 const static short COMPRESSION_CODE = 1;
@@ -26,17 +34,356 @@ const static int AVG_BYTES_PER_SEC = 176400;
 //size of wav header used in determing wav file size
 const static int WAV_HEADER_SIZE = 36;
 
+//number of sectors ripperRipTrack reads before each write
+const static unsigned int RIPPER_DEFAULT_BATCH_SECTORS = 64;
+//alignment of the read buffer, a page so the buffer
+//can be handed straight to the kernel
+const static size_t RIPPER_BUFFER_ALIGNMENT = 4096;
+//number of batches a pipelined rip can hold between the
+//drive and the output. 0 reads and writes on one thread
+const static unsigned int RIPPER_DEFAULT_PIPELINE_DEPTH = 0;
+//bytes staged before each write in RIPPER_OUTPUT_DIRECT,
+//a multiple of RIPPER_BUFFER_ALIGNMENT
+const static size_t RIPPER_DIRECT_WRITE_BYTES = 1 << 20;
+//flac compression level used for FLAC_AUDIO, 0 to 8
+const static unsigned int RIPPER_DEFAULT_FLAC_COMPRESSION = 5;
+//bytes of pcm a flac sink can hold for each of its
+//encoder threads before the rip waits for them
+const static size_t RIPPER_FLAC_QUEUE_BYTES = 8 << 20;
+//sectors ripped between the checkpoints a journaled rip
+//records, at most this much is ripped again after a crash
+const static long RIPPER_JOURNAL_INTERVAL = 4096;
+//sectors the adaptive speed control judges at a time,
+//ten seconds of audio
+const static long RIPPER_SPEED_REGION_SECTORS = 750;
+//a region needing more than one reread for this many
+//sectors counts as damaged
+const static long RIPPER_SPEED_REREAD_RATIO = 16;
+//clean regions in a row before the speed is raised
+const static int RIPPER_SPEED_CLEAN_REGIONS = 3;
+//smallest and largest drive cache in sectors paranoia is
+//told to bust on rereads, the smallest is paranoia's own
+//default
+const static long RIPPER_SPEED_MIN_WINDOW = 1200;
+const static long RIPPER_SPEED_MAX_WINDOW = 9600;
+
 typedef
 	enum RIPPER_CD_TYPE { AUDIO_CD, DATA_CD, MIXED_MODE_CD, NO_CD }
 RIPPER_CD_TYPE;
 
 typedef 
-	enum RIPPER_FORMAT_TYPE { RAW_CD_DATA, UNCOMPRESSED_WAV }
+	enum RIPPER_FORMAT_TYPE { RAW_CD_DATA, UNCOMPRESSED_WAV, FLAC_AUDIO }
 RIPPER_FORMAT_TYPE;
 
+//how sectors are read from the drive
+//RIPPER_READ_PARANOIA reads every sector through paranoia
+//RIPPER_READ_BURST reads each track twice at full speed
+//and compares the passes, only the batches that differ
+//are read again through paranoia
+typedef
+	enum RIPPER_READ_MODE { RIPPER_READ_PARANOIA, RIPPER_READ_BURST }
+RIPPER_READ_MODE;
+
+//how output files are written. every mode except
+//RIPPER_OUTPUT_STDIO allocates the whole file before the
+//first write so files written side by side don't fragment
+//RIPPER_OUTPUT_STDIO appends through a buffered FILE
+//RIPPER_OUTPUT_MMAP copies into a shared mapping of the file,
+//or writes through a FILE when the filesystem can't
+//allocate it
+//RIPPER_OUTPUT_DIRECT writes aligned blocks with O_DIRECT,
+//bypassing the page cache where the filesystem allows it
+typedef
+	enum RIPPER_OUTPUT_MODE { RIPPER_OUTPUT_STDIO, RIPPER_OUTPUT_MMAP, RIPPER_OUTPUT_DIRECT }
+RIPPER_OUTPUT_MODE;
+
+//output layouts for ripperRipDisc
+typedef
+	enum RIPPER_DISC_OUTPUT_TYPE { RIPPER_DISC_TRACK_FILES, RIPPER_DISC_BIN_CUE }
+RIPPER_DISC_OUTPUT_TYPE;
+
+//checksums of one ripped track, computed as the
+//track is read. valid is 0 until the track has been
+//ripped successfully
+typedef struct ripper_track_checksums_t {
+	uint32_t crc32;
+	uint32_t accuraterip_v1;
+	uint32_t accuraterip_v2;
+	int valid;
+}ripper_track_checksums_t;
+
+//paranoia_cb_mode_t events counted by the rip statistics,
+//every mode up to PARANOIA_CB_CACHEERR
+#define RIPPER_STATS_EVENTS (PARANOIA_CB_CACHEERR + 1)
+
+//statistics of a ripped track or of a whole rip.
+//reads counts the reads asked of the drive and rereads the
+//ones that went back over sectors already read, burst
+//batches read again through paranoia included.  events
+//counts the events paranoia reported by paranoia_cb_mode_t,
+//e.g. events[PARANOIA_CB_SKIP].  bytes_written is the pcm
+//handed to the output.  read_ns is the time spent waiting
+//on the drive, write_ns the time spent in the output and
+//wait_ns the time a pipelined rip waited on the output for
+//a free batch.  elapsed_ns is only set for a whole rip
+typedef struct ripper_rip_stats_t {
+	long sectors_read;
+	long reads;
+	long rereads;
+	long events[RIPPER_STATS_EVENTS];
+	uint64_t bytes_written;
+	uint64_t read_ns;
+	uint64_t write_ns;
+	uint64_t wait_ns;
+	uint64_t elapsed_ns;
+}ripper_rip_stats_t;
+
+//running checksums of a track being ripped
+//positions count samples from 1 and only samples between
+//check_start and check_end are part of the AccurateRip sums
+typedef struct ripper_checksum_state_t {
+	uint32_t crc32;
+	uint32_t ar_lo;
+	uint32_t ar_hi;
+	uint32_t position;
+	uint32_t check_start;
+	uint32_t check_end;
+}ripper_checksum_state_t;
+
+//checksum of one batch from the first burst pass
+typedef struct ripper_burst_batch_t {
+	uint32_t crc;
+	int valid;
+}ripper_burst_batch_t;
+
+//a run of consecutive sectors belonging to one track.
+//start is the first sector read, it is after first when
+//a journaled rip is resumed part way through the track
+typedef struct ripper_span_t {
+	int track;
+	lsn_t first;
+	lsn_t last;
+	lsn_t start;
+}ripper_span_t;
+
+//destination for ripped audio, the read loop hands it
+//every batch as soon as it is read. begin is called
+//before the first batch of every span and end after its
+//last batch or after an error, with status 1 or -1.
+//flush is called once after the last span and waits for
+//output still being written, it may be NULL. destroy
+//frees the sink and may be NULL for sinks on the stack.
+//every call returns 1 on success and -1 on error
+typedef struct ripper_sink_t {
+	int (*begin)(struct ripper_sink_t *,const ripper_span_t *);
+	int (*write)(struct ripper_sink_t *,const int16_t *,long);
+	int (*end)(struct ripper_sink_t *,int);
+	void * data;
+	int (*flush)(struct ripper_sink_t *);
+	void (*destroy)(struct ripper_sink_t *);
+}ripper_sink_t;
+
+//record kinds in a rip journal. A PROGRESS record marks
+//every sector before next_sector as safely in the output
+//and a COMPLETE record marks the whole track as ripped
+typedef
+	enum RIPPER_JOURNAL_RECORD_TYPE { RIPPER_JOURNAL_PROGRESS = 1, RIPPER_JOURNAL_COMPLETE = 2 }
+RIPPER_JOURNAL_RECORD_TYPE;
+
+//one fixed size journal record. output identifies the file
+//or pattern the track went to and offset is the number of
+//bytes of it that were synced to disk. state holds the
+//checksums of the sectors before next_sector so a resumed
+//rip still gets whole track checksums. inode, size and
+//mtime_ns identify a finished flac file, whose pcm can't be
+//checked against state. crc covers every field before it
+//and catches records torn by a crash
+typedef struct ripper_journal_record_t {
+	uint32_t magic;
+	uint32_t type;
+	uint32_t track;
+	int32_t next_sector;
+	uint64_t output;
+	uint64_t offset;
+	uint64_t inode;
+	uint64_t size;
+	int64_t mtime_ns;
+	ripper_checksum_state_t state;
+	uint32_t reserved;
+	uint32_t crc;
+}ripper_journal_record_t;
+
+//faults a simulated drive can be scheduled to make
+//RIPPER_SIM_READ_ERROR fails reads of the sectors
+//RIPPER_SIM_JITTER starts reads amount samples off
+//RIPPER_SIM_DROP skips the sectors, the sectors after them
+//come back early
+//RIPPER_SIM_CORRUPT flips bits differently on every read
+//RIPPER_SIM_LATENCY adds amount microseconds to each read
+typedef
+	enum RIPPER_SIM_FAULT_TYPE { RIPPER_SIM_READ_ERROR, RIPPER_SIM_JITTER, RIPPER_SIM_DROP, RIPPER_SIM_CORRUPT, RIPPER_SIM_LATENCY }
+RIPPER_SIM_FAULT_TYPE;
+
+//a fault covering the sectors first to last. it spoils
+//the first reads reads of them, every read when reads is 0
+typedef struct ripper_sim_fault_t {
+	RIPPER_SIM_FAULT_TYPE type;
+	lsn_t first;
+	lsn_t last;
+	int reads;
+	long amount;
+	int hits;
+	int active;
+}ripper_sim_fault_t;
+
+//one read of a recorded drive trace. result is what the
+//drive returned, crc is of the data read and ns the time
+//the read took
+typedef struct ripper_sim_trace_read_t {
+	int32_t begin;
+	int32_t sectors;
+	int32_t result;
+	uint32_t crc;
+	uint64_t ns;
+}ripper_sim_trace_read_t;
+
+//simulated drive, see ripperSimCreate.  The counts are
+//kept from the last ripperSimReset and elapsed_ns is the
+//time the reads would have taken on the drive
+typedef struct ripper_sim_t {
+	cdrom_drive_t * drive;
+	pthread_mutex_t lock;
+	uint32_t seed;
+	int speed;
+	int max_speed;
+	long sector_ns;
+	int realtime;
+	ripper_sim_fault_t * faults;
+	int numFaults;
+	int sizeFaults;
+	ripper_sim_trace_read_t * trace;
+	long numTrace;
+	long trace_pos;
+	long trace_misses;
+	long reads;
+	long failed_reads;
+	long sectors_read;
+	long speed_changes;
+	long q_reads;
+	uint64_t elapsed_ns;
+	//INDEX 00 of every track, see ripperSimSetPregap
+	lsn_t * pregaps;
+}ripper_sim_t;
+
+//recording of a real drive, see ripperSimRecordStart
+typedef struct ripper_sim_recorder_t ripper_sim_recorder_t;
+
+//kinds of events recorded by a rip trace
+//RIPPER_TRACE_READ is one sector read through paranoia,
+//RIPPER_TRACE_BURST_READ a read of the drive in burst
+//mode, RIPPER_TRACE_SEEK a seek of
+//paranoia, RIPPER_TRACE_PARANOIA an event paranoia
+//reported, RIPPER_TRACE_WRITE a batch handed to the output,
+//RIPPER_TRACE_WAIT the reader waiting on the output in a
+//pipelined rip and RIPPER_TRACE_FLUSH the output being
+//synced or flushed
+typedef
+	enum RIPPER_TRACE_EVENT_TYPE { RIPPER_TRACE_READ, RIPPER_TRACE_BURST_READ, RIPPER_TRACE_SEEK, RIPPER_TRACE_PARANOIA,
+		RIPPER_TRACE_WRITE, RIPPER_TRACE_WAIT, RIPPER_TRACE_FLUSH }
+RIPPER_TRACE_EVENT_TYPE;
+
+//one recorded event.  start and duration are nanoseconds,
+//duration is 0 for events without one.  sectors is the
+//length of reads and writes and the paranoia_cb_mode_t of
+//paranoia events
+typedef struct ripper_trace_event_t {
+	uint64_t start;
+	uint64_t duration;
+	int32_t sector;
+	int32_t sectors;
+	uint16_t type;
+	uint16_t track;
+}ripper_trace_event_t;
+
+//events of one thread, the newest size events are kept
+typedef struct ripper_trace_ring_t {
+	ripper_trace_event_t * events;
+	long size;
+	//events recorded, events[count % size] is written next
+	uint64_t count;
+	long tid;
+	char name[16];
+}ripper_trace_ring_t;
+
+//trace of the rips of a ripper, see setRipperTrace.  Every
+//thread taking part in a rip records into its own ring so
+//recording takes no lock
+typedef struct ripper_trace_t {
+	pthread_mutex_t lock;
+	ripper_trace_ring_t ** rings;
+	int numRings;
+	int sizeRings;
+	long ring_events;
+	uint64_t id;
+	uint64_t start;
+}ripper_trace_t;
+
+//journal of the rips made from one disc, see setRipperJournal
+//records holds the latest record of every track and output
+typedef struct ripper_journal_t {
+	char * path;
+	int fd;
+	uint64_t toc_hash;
+	ripper_journal_record_t * records;
+	int numRecords;
+	int sizeRecords;
+}ripper_journal_t;
+
+//adaptive drive speed, see ripperSpeedUpdate.  speed is
+//the speed asked of the drive and window the cache size
+//paranoia assumes.  the counts are of the current region
+//max_speed is 0 when the drive keeps its own speed
+typedef struct ripper_speed_control_t {
+	int min_speed;
+	int max_speed;
+	int speed;
+	long window;
+	long region_sectors;
+	long errors;
+	long rereads;
+	int clean_regions;
+}ripper_speed_control_t;
+
+//a track of the table of contents, sectors are counted
+//from the start of the program area.  first is INDEX 01 and
+//pregap INDEX 00, the same as first when the track has no
+//pregap or the disc hasn't been scanned, see
+//ripperScanIndexes.  The pregap is ripped with the track
+//before it
+typedef struct ripper_toc_track_t {
+	lsn_t first;
+	lsn_t last;
+	lsn_t pregap;
+	int audio;
+}ripper_toc_track_t;
+
+//position read from the q subchannel of a sector, the
+//track and index are binary
+typedef struct ripper_subchannel_q_t {
+	int track;
+	int index;
+}ripper_subchannel_q_t;
+
+//reads the position in the q subchannel of sector
+//returns 1 on success, 0 if the sector carries another kind
+//of q frame and -1 on error
+typedef int (*ripper_q_reader_t)(void * arg,lsn_t sector,ripper_subchannel_q_t * q);
+
 typedef struct ripper_cd_data_t {
 	RIPPER_CD_TYPE type;
 	RIPPER_FORMAT_TYPE format;
+	RIPPER_READ_MODE read_mode;
+	RIPPER_OUTPUT_MODE output_mode;
 	CdIo_t * cdio_p;
 	cdrom_drive_t * drive;
 	cdrom_paranoia_t * p_paranoia;
@@ -45,14 +392,152 @@ typedef struct ripper_cd_data_t {
 	unsigned int totalTracks;
 	int * frame_offsets;
 	unsigned int cd_length;
+	//every track of the disc, totalTracks long.  Read once
+	//when the ripper is made so looking at the disc doesn't
+	//need the drive or paranoia, see ripperOpenDrive
+	ripper_toc_track_t * toc;
+	//set for disc images, paranoia only passes their
+	//sectors through
+	int image;
+	//set once the pregaps of the toc are known, see
+	//ripperScanIndexes.  toc_identity is the disc's key in
+	//the toc cache, 0 when it isn't cached
+	int indexed;
+	uint64_t toc_identity;
+	//reads the q subchannel for ripperScanIndexes, NULL
+	//reads it from the drive through cdio
+	ripper_q_reader_t read_q;
+	void * read_q_arg;
+	//sectors read per batch and the reusable
+	//buffer they are read into
+	unsigned int batch_sectors;
+	int16_t * read_buffer;
+	//number of batches in the pipeline ring and the
+	//buffer backing it
+	unsigned int pipeline_depth;
+	int16_t * ring_buffer;
+	//set by ripperCancelRip, only accessed atomically
+	int cancel;
+	//sectors written and to be written by the rip in
+	//progress, only accessed atomically
+	long progress_done;
+	long progress_total;
+	//sector paranoia will return next or
+	//CDIO_INVALID_LSN if it needs a seek
+	lsn_t next_sector;
+	//first pass checksums of the span being burst read,
+	//burst_count is 0 when no span has been scanned
+	ripper_burst_batch_t * burst_batches;
+	long burst_count;
+	long burst_size;
+	lsn_t burst_first;
+	//checksums of every track, totalTracks long
+	ripper_track_checksums_t * checksums;
+	//statistics of the last rip of every track, totalTracks
+	//long, and of the last rip as a whole
+	ripper_rip_stats_t * track_stats;
+	ripper_rip_stats_t rip_stats;
+	//furthest position paranoia has read since its last
+	//seek, -1 right after a seek
+	long read_position;
+	//trace of the rips, NULL unless tracing
+	ripper_trace_t * trace;
+	//cddb server used for queries, NULL and 0 use the
+	//libcddb defaults
+	char * cddb_server;
+	int cddb_port;
+	//journal of ripped sectors, NULL when rips aren't
+	//journaled
+	ripper_journal_t * journal;
+	//drive speed adjusted to the errors paranoia reports
+	ripper_speed_control_t speed_control;
+	//set when the drive belongs to the caller, see
+	//ripperInitDrive
+	int external_drive;
 }ripper_cd_data_t;
 
+//receives the pcm of every batch as it is ripped. pcm
+//points into the ripper's own buffers and is only valid
+//until the callback returns. returns 1 to continue or -1
+//to stop the rip
+typedef int (*ripper_stream_callback_t)(const int16_t * pcm,long sectors,int trackNum,void * arg);
+
+//rip read one batch at a time with ripperStreamNext
+typedef struct ripper_stream_t {
+	ripper_cd_data_t * ripper;
+	int trackNum;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	//batch waiting for the caller.  taken is set once the
+	//caller has it and ready is cleared when the caller asks
+	//for the next one
+	const int16_t * pcm;
+	long sectors;
+	int track;
+	int ready;
+	int taken;
+	int done;
+	int result;
+	int closing;
+}ripper_stream_t;
+
 typedef struct ripper_cddb_data_t {
 	cddb_disc_t * disc;
 	cddb_conn_t * conn;
 	unsigned int totalTracks;
+	//result of the last query or -1
+	int numMatches;
 }ripper_cddb_data_t;
 
+//one unit of work for ripperRunJobs
+//source is the disc image or device the job runs on, NULL
+//runs the job on whichever drive picks it up. run is
+//called with a ripper opened on the source and returns 1
+//on success or -1 on error, status is set to its result
+//or -1 if the source can't be opened
+typedef struct ripper_job_t {
+	const char * source;
+	driver_id_t driver;
+	int (*run)(ripper_cd_data_t *,void * arg);
+	void * arg;
+	int status;
+}ripper_job_t;
+
+//persistent cache of cddb query results kept in a
+//directory, see ripperCDDBCacheOpen
+typedef struct ripper_cddb_cache_t {
+	char * dir;
+	int index_fd;
+	int data_fd;
+	void * index;
+	size_t index_size;
+	uint32_t generation;
+	unsigned int max_entries;
+	long max_data_bytes;
+	pthread_mutex_t lock;
+}ripper_cddb_cache_t;
+
+//block of memory in a cddb arena, its data follows
+typedef struct ripper_arena_block_t {
+	struct ripper_arena_block_t * next;
+	size_t size;
+	size_t used;
+}ripper_arena_block_t;
+
+//memory holding a set of cddb results, see ripper_arena.c.
+//strings is the table of the strings interned so far and
+//results the array of numMatches results it was made for
+typedef struct ripper_cddb_arena_t {
+	ripper_arena_block_t * first;
+	ripper_arena_block_t * current;
+	char ** strings;
+	size_t numStrings;
+	size_t sizeStrings;
+	int numMatches;
+	struct ripper_cddb_query_results_t * results;
+}ripper_cddb_arena_t;
+
 //stores information for each track
 //on the cd information.
 //track length is in seconds
@@ -64,7 +549,9 @@ typedef struct ripper_cddb_track_t {
 //stores all of the information
 //retrieved from the cddb query
 //tracks is an array of ripper_cddb_track_t structs
-//of length numTracks
+//of length numTracks.  results made by the library are
+//held in arena with their tracks and strings, the strings
+//are shared between the results and must not be changed
 typedef struct ripper_cddb_query_results_t {
 	char * category;
 	char * artist;
@@ -74,22 +561,196 @@ typedef struct ripper_cddb_query_results_t {
 	unsigned int year;
 	int numTracks;
 	ripper_cddb_track_t * tracks;
+	ripper_cddb_arena_t * arena;
 }ripper_cddb_query_results_t;
 
+//matches of a cddb query read one at a time, see
+//ripperCDDBMatchesOpen.  result is followed by a zeroed
+//result so it reads like a results array of one
+typedef struct ripper_cddb_matches_t {
+	ripper_cddb_data_t * cddb;
+	ripper_cddb_arena_t * arena;
+	ripper_cddb_query_results_t result[2];
+	int numMatches;
+	int read;
+}ripper_cddb_matches_t;
+
+//called on the lookup thread once an asynchronous query
+//finishes, before ripperCDDBLookupWait returns. results
+//are owned by the lookup and may be NULL
+typedef void (*ripper_cddb_callback_t)(ripper_cddb_query_results_t * results,int numMatches,void * arg);
+
+//cddb query running on its own thread, see ripperCDDBQueryAsync
+//toc is a copy of the disc layout so the ripper it was
+//started from can rip while the query runs
+typedef struct ripper_cddb_lookup_t {
+	pthread_t thread;
+	pthread_mutex_t lock;
+	pthread_cond_t finished;
+	ripper_cd_data_t * toc;
+	ripper_cddb_cache_t * cache;
+	ripper_cddb_callback_t callback;
+	void * arg;
+	ripper_cddb_query_results_t * results;
+	int numMatches;
+	int done;
+}ripper_cddb_lookup_t;
+
 //determines the type of cd and the number of audio
 //and data tracks on the cd.
 ripper_cd_data_t * ripperInit();
 
+//same as ripperInit() but reads the cd from source using
+//the inputed libcdio driver. source is a device path for
+//DRIVER_DEVICE, NULL picks the first drive found, or a
+//disc image for DRIVER_BINCUE (.cue or .bin),
+//DRIVER_CDRDAO (.toc) and DRIVER_NRG (.nrg)
+//returns NULL on error
+ripper_cd_data_t * ripperInitSource(const char * source,driver_id_t driver);
+
+//same as ripperInit() but rips from a drive that is already
+//open, such as the drive of a ripper_sim_t.  The drive is
+//not closed by ripperCDDataDestroy and has to outlive the
+//ripper.  returns NULL on error
+ripper_cd_data_t * ripperInitDrive(cdrom_drive_t * drive);
+
+//finds INDEX 00 of every audio track and with it the
+//pregaps and any audio hidden before the first track.  The
+//q subchannel is only read around the start of each track,
+//binary searching from the start of the track before, so a
+//track takes a few dozen reads.  Images take the pregaps of
+//their cue sheet or toc file.  Rippers of the same disc in
+//the same drive share the result.  ripperRipDisc scans the
+//disc for its cue sheet when it hasn't been scanned
+//returns 1 on success and -1 if the drive can't read the
+//q subchannel
+int ripperScanIndexes(ripper_cd_data_t *);
+
+//opens the drive for cdda through the ripper's cdio handle
+//and sets up paranoia.  Rippers only read the table of
+//contents when they are made, every rip calls this first
+//so it is only needed before using ripper->drive directly
+//returns 1 on success and -1 on error
+int ripperOpenDrive(ripper_cd_data_t *);
+
 //frees the memory allocated in ripperInit()
 //always returns NULL
 ripper_cd_data_t * ripperCDDataDestroy(ripper_cd_data_t *);
 
 //rips the inputed track number and writes
-//it to the inputed file.
+//it to the inputed file. the file is a wav file unless
+//the format is RAW_CD_DATA or FLAC_AUDIO
 //
 //returns 1 for sucess and -1 on error
 int ripperRipTrack(ripper_cd_data_t *,int,char *);
 
+//same as ripperRipTrack but writes to a file descriptor
+//opened by the caller, e.g. a pipe to an encoder or a
+//socket. the wav header is left out for RAW_CD_DATA.
+//FLAC_AUDIO isn't supported and fails with -1 as the
+//encoder has to seek back to finish its header.
+//the descriptor is left open
+//returns 1 for sucess and -1 on error
+int ripperRipTrackFd(ripper_cd_data_t *,int trackNum,int fd);
+
+//rips every audio track on the cd in one sequential pass,
+//paranoia is only seeked once at the start of the disc
+//and where data tracks are skipped.
+//RIPPER_DISC_TRACK_FILES writes each track to its own wav
+//file, the filename is a printf style pattern taking the
+//track number e.g. "track%02d.wav"
+//RIPPER_DISC_BIN_CUE writes all tracks to a single raw bin
+//image named filename and a cue sheet describing it with
+//the same name and a .cue extension.  An image named .cue
+//has .cue appended for its sheet, disc.cue.cue
+//
+//returns 1 for sucess and -1 on error
+int ripperRipDisc(ripper_cd_data_t *,RIPPER_DISC_OUTPUT_TYPE,const char * filename);
+
+//same as ripperRipTrack and ripperRipDisc but the audio
+//is written to the inputed sink, one span per track
+//returns 1 for sucess and -1 on error
+int ripperRipTrackSink(ripper_cd_data_t *,int trackNum,ripper_sink_t *);
+int ripperRipDiscSink(ripper_cd_data_t *,ripper_sink_t *);
+
+//rips the track, or every audio track for a trackNum of 0,
+//and hands each batch to callback without writing a file
+//returns 1 for sucess and -1 on error or if the callback
+//stopped the rip
+int ripperRipTrackStream(ripper_cd_data_t *,int trackNum,ripper_stream_callback_t callback,void * arg);
+
+//pull version of ripperRipTrackStream. The rip runs on its
+//own thread and waits for each batch to be taken, so the
+//ripper can't be used until the stream is closed
+//returns NULL on error
+ripper_stream_t * ripperStreamOpen(ripper_cd_data_t *,int trackNum);
+//sets pcm to the next batch and trackNum, which may be NULL,
+//to its track. pcm stays valid until the next call
+//returns the number of sectors in the batch, 0 once the
+//rip is finished and -1 on error
+long ripperStreamNext(ripper_stream_t *,const int16_t ** pcm,int * trackNum);
+//stops the rip if it is still running and frees the
+//stream, always returns NULL
+ripper_stream_t * ripperStreamClose(ripper_stream_t *);
+
+//built in sinks, freed with ripperSinkDestroy
+//filename is a printf style pattern taking the track
+//number when pattern is set, otherwise every track is
+//written to the same file
+//returns NULL on error
+ripper_sink_t * ripperWavSinkInit(const char * filename,int pattern,RIPPER_OUTPUT_MODE mode);
+//same as ripperWavSinkInit without the wav header
+ripper_sink_t * ripperRawSinkInit(const char * filename,int pattern,RIPPER_OUTPUT_MODE mode);
+//writes every track to fd. every track starts with a wav
+//header unless raw is set.  A pipe or socket whose reader
+//goes away fails the rip, SIGPIPE is kept from the process
+ripper_sink_t * ripperFdSinkInit(int fd,int raw);
+//encodes every track to flac on its own threads so the
+//drive is read while earlier sectors are compressed.
+//threads of 0 uses one thread per processor.  With a
+//pattern each track is encoded on one of the threads,
+//without one libFLAC 1.5 splits the file over all of them
+ripper_sink_t * ripperFLACSinkInit(const char * filename,int pattern,unsigned int compression,unsigned int threads);
+//frees the sink, always returns NULL
+ripper_sink_t * ripperSinkDestroy(ripper_sink_t *);
+
+//cancels the rip in progress on the inputed ripper.
+//the rip returns -1 once the current batch is finished.
+//if no rip is running the next one is cancelled.
+//safe to call from any thread
+void ripperCancelRip(ripper_cd_data_t *);
+
+//returns how much of the rip in progress, or the last rip,
+//has been written from 0 to 100. safe to call from any
+//thread. returns -1 if a null pointer is passed
+int getRipperProgress(ripper_cd_data_t *);
+
+//returns the checksums computed during the last successful
+//rip of the inputed track or NULL if it hasn't been ripped
+const ripper_track_checksums_t * getRipperTrackChecksums(ripper_cd_data_t *,unsigned int trackNum);
+
+//returns the statistics of the last rip of the inputed
+//track, all 0 if it hasn't been ripped. A rip that failed
+//keeps the statistics up to the failure. returns NULL if
+//a null pointer or an invalid track is passed
+const ripper_rip_stats_t * getRipperTrackStats(ripper_cd_data_t *,unsigned int trackNum);
+//returns the statistics of the last rip, the sum of the
+//tracks it ripped, or NULL if a null pointer is passed
+const ripper_rip_stats_t * getRipperRipStats(ripper_cd_data_t *);
+
+//checksum functions used during the rip, they are
+//exported for callers checking pcm from other sources
+//
+//continues the crc32 of a stream, start with a crc of 0
+uint32_t ripperCRC32Update(uint32_t crc,const void * data,size_t length);
+//starts the checksums of a track sectors long.  the
+//AccurateRip sums leave out 5 sectors at the start of the
+//first track and the end of the last track of the disc
+void ripperChecksumInit(ripper_checksum_state_t *,long sectors,int firstTrack,int lastTrack);
+//adds the next sectors of the track to the checksums
+void ripperChecksumUpdate(ripper_checksum_state_t *,const int16_t * pcm,long sectors);
+void ripperChecksumFinish(const ripper_checksum_state_t *,ripper_track_checksums_t *);
+
 //writes the wav header to the inputed
 //file.  returns 1 on sucess and -1 on error
 int ripperWriteWavHeader(FILE * fp,int data_size);
@@ -104,22 +765,92 @@ int ripperGetFrameOffset(CdIo_t *,track_t,unsigned int);
 //returns the length of the cd or -1 on error
 int ripperGetDiskLength(CdIo_t *);
 
+//returns a NULL terminated list of the cd drives found
+//and sets numDrives to its length
+//returns NULL if no drives are found
+char ** ripperGetDrives(int * numDrives);
+//frees the list returned by ripperGetDrives
+//always returns NULL
+char ** ripperFreeDrives(char ** drives);
+
+//runs the jobs with one worker thread per drive. every
+//worker takes the next job from the shared list until it
+//is empty and each job gets its own ripper, so drives
+//never wait on each other. drives may be NULL when every
+//job names its own source
+//returns the number of failed jobs or -1 on error
+int ripperRunJobs(char ** drives,int numDrives,ripper_job_t * jobs,int numJobs);
+
+//frees global resources held by libcddb. call once when
+//no ripper or cddb query is in use anymore
+void ripperShutdown();
+
 //ripper set methods
+//sets the cddb server queried for the disc, a NULL server
+//or a port of 0 keeps the libcddb default
+void setRipperCDDBServer(ripper_cd_data_t * ripper, const char * server, int port);
 void setRipperFormat(ripper_cd_data_t * ripper, RIPPER_FORMAT_TYPE fileType);
+//sets the number of sectors read before each write
+//a value of 0 restores RIPPER_DEFAULT_BATCH_SECTORS
+void setRipperBatchSectors(ripper_cd_data_t * ripper, unsigned int sectors);
+//sets the number of batches that can be queued between
+//the thread reading the drive and the thread writing the
+//output. a depth greater than 0 enables the pipelined rip
+void setRipperPipelineDepth(ripper_cd_data_t * ripper, unsigned int depth);
+void setRipperReadMode(ripper_cd_data_t * ripper, RIPPER_READ_MODE mode);
+//sets how ripperRipTrack and ripperRipDisc write wav and
+//bin files
+void setRipperOutputMode(ripper_cd_data_t * ripper, RIPPER_OUTPUT_MODE mode);
+//journals the rips made by ripperRipTrack and ripperRipDisc
+//in the file path, creating it if needed.  A rip that was
+//interrupted starts again from the last checkpoint and the
+//tracks already ripped to the same output are skipped.
+//flac files are only skipped once complete.  A journal
+//written for a different disc is cleared.  NULL stops
+//journaling.  returns 1 on success and -1 on error
+int setRipperJournal(ripper_cd_data_t * ripper, const char * path);
+//lets the drive speed follow the condition of the disc.
+//The first rip after this call starts at maxSpeed and each
+//later one at the speed the last ended on, the speed is
+//halved down to minSpeed where paranoia finds errors and
+//raised again once the reads are clean.  a maxSpeed of 0
+//turns it off and puts an open drive back at its own speed
+void setRipperAdaptiveSpeed(ripper_cd_data_t * ripper, int minSpeed, int maxSpeed);
+//records timestamped events of every rip from now on,
+//keeping the newest events of every thread taking part.
+//events of 0 stops tracing and drops the trace, otherwise
+//the events recorded so far are dropped as well
+//returns 1 on success and -1 on error
+int setRipperTrace(ripper_cd_data_t * ripper, long events);
 
 //ripper get methods 
 //return -1 if a null pointer is passed
 //except ripperGetCDType which returns NO_CD 
 //when a null pointer has passed
 RIPPER_FORMAT_TYPE getRipperFormat(ripper_cd_data_t * ripper);
+RIPPER_READ_MODE getRipperReadMode(ripper_cd_data_t * ripper);
+RIPPER_OUTPUT_MODE getRipperOutputMode(ripper_cd_data_t * ripper);
 RIPPER_CD_TYPE getRipperCDType(ripper_cd_data_t * ripper);
 int getRipperNumAudioTracks(ripper_cd_data_t * ripper);
 int getRipperNumDataTracks(ripper_cd_data_t * ripper);
 int getRipperNumTracks(ripper_cd_data_t * ripper);
+int getRipperBatchSectors(ripper_cd_data_t * ripper);
+int getRipperPipelineDepth(ripper_cd_data_t * ripper);
+//returns the speed last asked of the drive or 0 if the
+//drive is at its own speed
+int getRipperSpeed(ripper_cd_data_t * ripper);
 //returns the length of the cd in seconds
 //this may not be correct if there are data
 //tracks?
 int getRipperCDLength(ripper_cd_data_t * ripper);
+//returns the number of sectors in the pregap of the track,
+//0 until the disc is scanned, see ripperScanIndexes
+//returns -1 for an invalid track
+int getRipperTrackPregap(ripper_cd_data_t * ripper,unsigned int trackNum);
+//returns the number of sectors of audio hidden before the
+//first track, 0 if there are none or the disc hasn't been
+//scanned
+int getRipperHiddenTrackSectors(ripper_cd_data_t * ripper);
 
 //initializes a new ripper_cddb_data_t 
 //Creates all necessary objects through libcddb
@@ -137,8 +868,13 @@ ripper_cddb_data_t * ripperCDDBDestroy(ripper_cddb_data_t *);
 //disc or -1 on error
 int ripperGetNumCDDBMatches(ripper_cddb_data_t *);
 
+//returns the cddb disc id of the cd computed from
+//its table of contents
+unsigned int ripperGetCDDBDiscId(ripper_cd_data_t *);
+
 //retrieves all available cddb query results
 //returns an array of ripper_cddb_query_results_t *
+//the array ends with a zeroed result whose tracks are NULL
 //numMatches will be set to the number of results found
 //numMatches is set to -1 on error
 //returns NULL on error or if no results are found
@@ -148,6 +884,172 @@ ripper_cddb_query_results_t * ripperCDDBQuery(ripper_cd_data_t *,int * numMatche
 //always returns NULL
 ripper_cddb_query_results_t * ripperCDDBQueryDestroy(ripper_cddb_query_results_t *);
 
+//returns the number of results in the array returned by
+//ripperCDDBQuery or -1 if a null pointer is passed
+int getRipperCDDBNumMatches(const ripper_cddb_query_results_t *);
+
+//starts a cddb query whose matches are read one at a time
+//with ripperCDDBMatchesNext rather than all at once.
+//numMatches is set the same way as by ripperCDDBQuery
+//returns NULL on error or if no matches are found
+ripper_cddb_matches_t * ripperCDDBMatchesOpen(ripper_cd_data_t *,int * numMatches);
+//reads the next match from the server.  The result and its
+//strings are reused by the next call, the memory they
+//take is allocated once and kept for the later matches
+//returns NULL after the last match or on error
+const ripper_cddb_query_results_t * ripperCDDBMatchesNext(ripper_cddb_matches_t *);
+//frees the query and its last result, always returns NULL
+ripper_cddb_matches_t * ripperCDDBMatchesClose(ripper_cddb_matches_t *);
+
+//starts ripperCDDBQueryCached on a new thread and returns
+//right away so the disc can be ripped while the server
+//answers. cache may be NULL to always ask the server and
+//callback may be NULL
+//returns NULL on error
+ripper_cddb_lookup_t * ripperCDDBQueryAsync(ripper_cd_data_t *,ripper_cddb_cache_t * cache,ripper_cddb_callback_t callback,void * arg);
+//returns 1 if the lookup has finished, 0 if it is still
+//running and -1 if a null pointer is passed
+int ripperCDDBLookupDone(ripper_cddb_lookup_t *);
+//waits for the lookup to finish and returns its results the
+//same way as ripperCDDBQuery. The results stay owned by
+//the lookup and are freed by ripperCDDBLookupDestroy
+ripper_cddb_query_results_t * ripperCDDBLookupWait(ripper_cddb_lookup_t *,int * numMatches);
+//waits for the lookup to finish and frees it and its
+//results, always returns NULL
+ripper_cddb_lookup_t * ripperCDDBLookupDestroy(ripper_cddb_lookup_t *);
+
+//opens the cddb cache stored in the directory dir creating
+//it if needed.  The cache holds at most maxEntries discs
+//and maxDataBytes of results, 0 leaves the size unlimited.
+//once full the least recently used discs are dropped.
+//the cache can be shared by threads and processes
+//returns NULL on error
+ripper_cddb_cache_t * ripperCDDBCacheOpen(const char * dir,unsigned int maxEntries,long maxDataBytes);
+//closes the cache, always returns NULL
+ripper_cddb_cache_t * ripperCDDBCacheClose(ripper_cddb_cache_t *);
+//same as ripperCDDBQuery but answers from the cache when
+//the disc has been looked up before.  Discs without
+//matches are cached too. Results are keyed by the disc id
+//and the track offsets and freed with ripperCDDBQueryDestroy
+ripper_cddb_query_results_t * ripperCDDBQueryCached(ripper_cddb_cache_t *,ripper_cd_data_t *,int * numMatches);
+//removes the disc from the cache so the next query goes
+//to the server. returns 1 if the disc was removed, 0 if
+//it wasn't cached and -1 on error
+int ripperCDDBCacheInvalidate(ripper_cddb_cache_t *,ripper_cd_data_t *);
+//removes every disc from the cache
+//returns 1 on success and -1 on error
+int ripperCDDBCacheClear(ripper_cddb_cache_t *);
+//returns the number of discs in the cache or -1 if a
+//null pointer is passed
+int getRipperCDDBCacheCount(ripper_cddb_cache_t *);
+
+//simulated drive, see ripper_sim.c
+//creates a drive holding an audio cd whose tracks start at
+//the sectors in trackStarts and end before leadout.  Every
+//sample is generated from its position and seed
+//returns NULL on error
+ripper_sim_t * ripperSimCreate(const lsn_t * trackStarts,int numTracks,lsn_t leadout,uint32_t seed);
+//frees the drive, the rippers using it must be destroyed
+//first.  always returns NULL
+ripper_sim_t * ripperSimDestroy(ripper_sim_t *);
+//same as ripperInitDrive on the simulated drive
+ripper_cd_data_t * ripperInitSim(ripper_sim_t *);
+//marks the track as a data track
+//returns 1 on success and -1 on error
+int ripperSimSetDataTrack(ripper_sim_t *,int trackNum);
+//gives the track a pregap of sectors before its start in
+//the q subchannel, the pregap of the first track always
+//starts at sector 0.  returns 1 on success and -1 on error
+int ripperSimSetPregap(ripper_sim_t *,int trackNum,lsn_t sectors);
+//fills pcm with the sector as the disc holds it
+void ripperSimFillSector(const ripper_sim_t *,lsn_t sector,int16_t * pcm);
+//sets the time a sector takes to read at single speed and
+//the fastest speed of the drive, 48 when maxSpeed is 0.
+//the reads only take that long when realtime is set,
+//elapsed_ns counts it either way
+void ripperSimSetTiming(ripper_sim_t *,long sectorNs,int maxSpeed,int realtime);
+//schedules a fault, see ripper_sim_fault_t
+//returns 1 on success and -1 on error
+int ripperSimAddFault(ripper_sim_t *,RIPPER_SIM_FAULT_TYPE type,lsn_t first,lsn_t last,int reads,long amount);
+//clears the counts, restarts the faults and the trace and
+//puts the drive back at full speed
+void ripperSimReset(ripper_sim_t *);
+//replays the trace in path for the reads that match it
+//returns 1 on success and -1 on error
+int ripperSimLoadTrace(ripper_sim_t *,const char * path);
+//records every read the ripper's drive makes to path until
+//ripperSimRecordStop.  returns NULL on error
+ripper_sim_recorder_t * ripperSimRecordStart(ripper_cd_data_t *,const char * path);
+//ends the recording and frees the recorder
+//returns 1 on success and -1 on error
+int ripperSimRecordStop(ripper_sim_recorder_t *);
+
+//writes the events traced so far to path in the chrome
+//trace event format, which perfetto and chrome://tracing
+//open.  must not be called while a rip is running
+//returns 1 on success and -1 on error
+int ripperTraceWrite(ripper_cd_data_t *,const char * path);
+
+//cddb result arenas, see ripper_arena.c
+//creates an arena with a first block of about size bytes
+//returns NULL on error
+ripper_cddb_arena_t * ripperCDDBArenaCreate(size_t size);
+void ripperCDDBArenaDestroy(ripper_cddb_arena_t *);
+//forgets everything allocated but keeps the blocks
+void ripperCDDBArenaReset(ripper_cddb_arena_t *);
+//returns size zeroed bytes or NULL on error
+void * ripperCDDBArenaAlloc(ripper_cddb_arena_t *,size_t size);
+//returns the arena's copy of the length bytes of string,
+//equal strings share one copy.  returns NULL on error
+char * ripperCDDBArenaIntern(ripper_cddb_arena_t *,const char * string,size_t length);
+//returns a zeroed array of matches results followed by
+//the zeroed result ending it, in a new arena with about
+//size bytes to spare.  returns NULL on error
+ripper_cddb_query_results_t * ripperCDDBResultsCreate(int matches,size_t size);
+
+//rip tracing internals, see ripper_trace.c
+ripper_trace_t * ripperTraceCreate(long events);
+//always returns NULL
+ripper_trace_t * ripperTraceDestroy(ripper_trace_t *);
+//records an event that began at start and ends now, start
+//is 0 for an event without a duration.  times are taken
+//from CLOCK_MONOTONIC in nanoseconds
+void ripperTraceEvent(ripper_trace_t *,RIPPER_TRACE_EVENT_TYPE type,uint64_t start,int track,long sector,long sectors);
+
+//table of contents internals, see ripper_toc.c
+//reads the tracks of the disc in the ripper's cdio handle,
+//source is the name it was opened with and may be NULL.
+//sets toc, frame_offsets, cd_length, the track counts and
+//the type of the ripper
+//returns 1 on success and -1 on error or without a disc
+int ripperTocRead(ripper_cd_data_t *,const char * source);
+//same as ripperTocRead for a drive that is already open
+int ripperTocReadDrive(ripper_cd_data_t *,cdrom_drive_t * drive);
+
+//adaptive speed control, see ripper_speed.c
+//starts a controller between minSpeed and maxSpeed
+void ripperSpeedInit(ripper_speed_control_t *,int minSpeed,int maxSpeed);
+//forgets the region in progress before a new rip
+void ripperSpeedReset(ripper_speed_control_t *);
+//counts an event reported by the paranoia callback
+void ripperSpeedEvent(ripper_speed_control_t *,paranoia_cb_mode_t);
+//adds sectors read since the last update and judges the
+//region once it is complete
+//returns 1 if the speed changed and 0 otherwise
+int ripperSpeedUpdate(ripper_speed_control_t *,long sectors);
+
+//journal internals used by the rip, see ripper_journal.c
+void ripperJournalClose(ripper_journal_t *);
+//returns an id for an output file or pattern, kind tells
+//apart outputs with the same name written differently
+uint64_t ripperJournalOutputId(const char * path,uint32_t kind);
+//returns the latest record of the track written to output
+//or NULL if there is none
+const ripper_journal_record_t * ripperJournalFind(const ripper_journal_t *,int track,uint64_t output);
+//appends the record and syncs it to disk
+//returns 1 on success and -1 on error
+int ripperJournalAppend(ripper_journal_t *,ripper_journal_record_t * record);
+
 //cddb accessor methods
 char * getRipperCDDBCategory(const ripper_cddb_query_results_t *);
 char * getRipperCDDBArtist(const ripper_cddb_query_results_t *);
@@ -172,10 +1074,13 @@ void setRipperCDDBGenre(ripper_cddb_query_results_t *,char * genre);
 void setRipperCDDBExtData(ripper_cddb_query_results_t *,char * ext_data);
 void setRipperCDDBYear(ripper_cddb_query_results_t *,int year);
 //cddb track mutator methods
-//all char * passed will be freed when ripperCDDBDestroy is called so
-//they must be able to be freed using free
+//the strings passed are copied
 void setRipperCDDBTrackTitle(ripper_cddb_query_results_t *,char * title,unsigned int trackNum);
 void setRipperCDDBTrackArtist(ripper_cddb_query_results_t *,char * artist, unsigned int trackNum);
 void setRipperCDDBTrackLength(ripper_cddb_query_results_t *, int length,unsigned int trackNum);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
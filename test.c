@@ -1,13 +1,223 @@
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
 #include "ripper.h"
 
 
 #define MAX_FILENAME_SIZE 100
 
+//rips a track of a simulated disc through a stream that is
+//read late, so the first batch is handed off before it is
+//asked for, and checks the pcm against the rip's checksums
+//returns 1 when they match
+static int checkDelayedStream(void)
+{
+	lsn_t starts[2] = {0,1000};
+	ripper_sim_t * sim = ripperSimCreate(starts,2,2000,7);
+	ripper_cd_data_t * rp = ripperInitSim(sim);
+	ripper_stream_t * stream = ripperStreamOpen(rp,1);
+	const int16_t * pcm;
+	long sectors = -1;
+	long total = 0;
+	uint32_t crc = 0;
+	
+	usleep(200000);
+	while(stream != NULL && (sectors = ripperStreamNext(stream,&pcm,NULL)) > 0) {
+		crc = ripperCRC32Update(crc,pcm,sectors * CDIO_CD_FRAMESIZE_RAW);
+		total += sectors;
+	}
+	stream = ripperStreamClose(stream);
+	
+	const ripper_track_checksums_t * checksums = getRipperTrackChecksums(rp,1);
+	int matches = sectors == 0 && total == 1000 && checksums != NULL && checksums->crc32 == crc;
+	printf("Delayed stream: %ld sectors, %s\n",total,matches ? "checksums match" : "checksums differ");
+	
+	rp = ripperCDDataDestroy(rp);
+	ripperSimDestroy(sim);
+	return matches;
+}
+
+//speed of the drive after every batch of a rip, taken by
+//a sink as the batches arrive
+#define MAX_SPEED_SAMPLES 256
+
+typedef struct speed_samples_t {
+	ripper_cd_data_t * rp;
+	lsn_t sector;
+	int count;
+	lsn_t firsts[MAX_SPEED_SAMPLES];
+	lsn_t lasts[MAX_SPEED_SAMPLES];
+	int speeds[MAX_SPEED_SAMPLES];
+} speed_samples_t;
+
+static int speedSampleBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	speed_samples_t * samples = sink->data;
+	
+	samples->sector = span->start;
+	return 1;
+}
+
+static int speedSampleWrite(ripper_sink_t * sink,const int16_t * pcm,long sectors)
+{
+	speed_samples_t * samples = sink->data;
+	
+	if(samples->count < MAX_SPEED_SAMPLES) {
+		samples->firsts[samples->count] = samples->sector;
+		samples->lasts[samples->count] = samples->sector + sectors - 1;
+		samples->speeds[samples->count++] = getRipperSpeed(samples->rp);
+	}
+	samples->sector += sectors;
+	return 1;
+}
+
+static int speedSampleEnd(ripper_sink_t * sink,int status)
+{
+	return status;
+}
+
+//rips a simulated disc with a scratch that reads back
+//differently every time with adaptive speed on.  The drive
+//must slow down inside the scratch and only speed up again
+//once RIPPER_SPEED_CLEAN_REGIONS clean regions are read
+//returns 1 when it does
+static int checkAdaptiveSpeed(void)
+{
+	lsn_t starts[2] = {0,4500};
+	lsn_t scratchFirst = 700;
+	lsn_t scratchLast = 900;
+	int maxSpeed = 8;
+	ripper_sim_t * sim = ripperSimCreate(starts,2,5000,7);
+	ripperSimAddFault(sim,RIPPER_SIM_CORRUPT,scratchFirst,scratchLast,0,0);
+	ripper_cd_data_t * rp = ripperInitSim(sim);
+	speed_samples_t samples;
+	ripper_sink_t sink = { speedSampleBegin,speedSampleWrite,speedSampleEnd,&samples,NULL,NULL };
+	int i;
+	
+	memset(&samples,0,sizeof(samples));
+	samples.rp = rp;
+	setRipperAdaptiveSpeed(rp,1,maxSpeed);
+	ripperRipTrackSink(rp,1,&sink);
+	
+	//the slowest batch read inside the scratch and the first
+	//batch the drive read faster than the one before it
+	int slowest = maxSpeed;
+	lsn_t raised = -1;
+	for(i = 0;i < samples.count;i++) {
+		if(samples.firsts[i] <= scratchLast && samples.lasts[i] >= scratchFirst && samples.speeds[i] < slowest)
+			slowest = samples.speeds[i];
+		if(raised == -1 && i > 0 && samples.speeds[i] > samples.speeds[i - 1])
+			raised = samples.lasts[i];
+	}
+	
+	int adapts = slowest < maxSpeed && raised != -1
+		&& raised - scratchLast >= RIPPER_SPEED_CLEAN_REGIONS * RIPPER_SPEED_REGION_SECTORS
+		&& sim->speed_changes > 0;
+	printf("Adaptive speed: %dx in the scratch, faster again at sector %d, %ld speed changes, %s\n",
+		slowest,raised,sim->speed_changes,adapts ? "as expected" : "not as expected");
+	
+	rp = ripperCDDataDestroy(rp);
+	ripperSimDestroy(sim);
+	return adapts;
+}
+
+//rips the track through a stream and returns the sectors
+//read, the checksums are left in the ripper
+static long drainTrack(ripper_cd_data_t * rp,int trackNum)
+{
+	ripper_stream_t * stream = ripperStreamOpen(rp,trackNum);
+	const int16_t * pcm;
+	long sectors;
+	long total = 0;
+	
+	while(stream != NULL && (sectors = ripperStreamNext(stream,&pcm,NULL)) > 0)
+		total += sectors;
+	stream = ripperStreamClose(stream);
+	return total;
+}
+
+//crc32 of the sectors first to last as the disc holds them
+static uint32_t simCRC(const ripper_sim_t * sim,lsn_t first,lsn_t last)
+{
+	int16_t pcm[CDIO_CD_FRAMESIZE_RAW / 2];
+	uint32_t crc = 0;
+	lsn_t i;
+	
+	for(i = first;i <= last;i++) {
+		ripperSimFillSector(sim,i,pcm);
+		crc = ripperCRC32Update(crc,pcm,CDIO_CD_FRAMESIZE_RAW);
+	}
+	return crc;
+}
+
+//checks the faults of the simulated drive spoil reads and
+//wear off, and that a recorded rip replays the same way
+//returns 1 when they do
+static int checkSimulatorFaults(void)
+{
+	lsn_t starts[2] = {0,500};
+	const char * trace = "/tmp/ripper_sim_check.trace";
+	int16_t expected[CDIO_CD_FRAMESIZE_RAW / 2];
+	int16_t read[CDIO_CD_FRAMESIZE_RAW / 2];
+	const ripper_track_checksums_t * checksums;
+	
+	//a jittered read differs from the disc, paranoia reads
+	//past it once the fault wears off
+	ripper_sim_t * sim = ripperSimCreate(starts,2,1000,7);
+	ripperSimAddFault(sim,RIPPER_SIM_JITTER,100,110,1,3);
+	ripper_cd_data_t * rp = ripperInitSim(sim);
+	ripperOpenDrive(rp);
+	ripperSimFillSector(sim,100,expected);
+	int jitters = cdio_cddap_read(rp->drive,read,100,1) == 1 && memcmp(read,expected,sizeof(read)) != 0;
+	ripperSimReset(sim);
+	checksums = drainTrack(rp,1) == 500 ? getRipperTrackChecksums(rp,1) : NULL;
+	jitters = jitters && checksums != NULL && checksums->crc32 == simCRC(sim,0,499);
+	rp = ripperCDDataDestroy(rp);
+	ripperSimDestroy(sim);
+	
+	//a read error that fails two reads is recovered from,
+	//and the rip is recorded
+	sim = ripperSimCreate(starts,2,1000,7);
+	ripperSimAddFault(sim,RIPPER_SIM_READ_ERROR,300,300,2,0);
+	rp = ripperInitSim(sim);
+	ripper_sim_recorder_t * recorder = ripperSimRecordStart(rp,trace);
+	checksums = drainTrack(rp,1) == 500 ? getRipperTrackChecksums(rp,1) : NULL;
+	uint32_t crc = checksums != NULL ? checksums->crc32 : 0;
+	int recovers = ripperSimRecordStop(recorder) == 1 && checksums != NULL
+		&& crc == simCRC(sim,0,499) && sim->faults[0].hits == 2 && sim->failed_reads > 0;
+	long reads = sim->reads;
+	long failedReads = sim->failed_reads;
+	rp = ripperCDDataDestroy(rp);
+	ripperSimDestroy(sim);
+	
+	//the trace alone fails the same reads on a drive with no
+	//faults and the rip comes out the same
+	sim = ripperSimCreate(starts,2,1000,7);
+	rp = ripperInitSim(sim);
+	int replays = ripperSimLoadTrace(sim,trace) == 1;
+	checksums = drainTrack(rp,1) == 500 ? getRipperTrackChecksums(rp,1) : NULL;
+	replays = replays && checksums != NULL && checksums->crc32 == crc
+		&& sim->reads == reads && sim->failed_reads == failedReads;
+	long misses = sim->trace_misses;
+	rp = ripperCDDataDestroy(rp);
+	ripperSimDestroy(sim);
+	unlink(trace);
+	
+	printf("Simulated faults: jitter %s, read error %s, trace %s with %ld misses\n",
+		jitters ? "corrected" : "not corrected",recovers ? "recovered" : "not recovered",
+		replays ? "replayed" : "not replayed",misses);
+	return jitters && recovers && replays && misses == 0;
+}
+
 int main() {
 	
+	if(!checkDelayedStream() || !checkAdaptiveSpeed() || !checkSimulatorFaults())
+		return 1;
+	
 	char filename[MAX_FILENAME_SIZE] = "/home/johnson/track1.wav";
 	ripper_cd_data_t * rp = ripperInit();
+	//the lookup runs while the disc is ripped
+	ripper_cddb_lookup_t * lookup = ripperCDDBQueryAsync(rp,NULL,NULL,NULL);
 	if(rp->type == AUDIO_CD) {
 		printf("Audio CD\n");
 		printf("%d Tracks\n",rp->numAudioTracks);
@@ -23,8 +233,11 @@ int main() {
 	
 	int i = 0;
 	
+	printf("Ripping %d Tracks\n",rp->numAudioTracks);
+	ripperRipDisc(rp,RIPPER_DISC_TRACK_FILES,"track%02d.wav");
+	
 	int numMatches = 0;
-	ripper_cddb_query_results_t * res = ripperCDDBQuery(rp,&numMatches);
+	ripper_cddb_query_results_t * res = ripperCDDBLookupWait(lookup,&numMatches);
 	
 	if(res != NULL & numMatches > 0) {
 		printf("Artist = %s\n",getRipperCDDBArtist(&res[0]));
@@ -41,15 +254,19 @@ int main() {
 		printf("Error: No CDDB Record found.\n");
 	}
 
-	for(i = 1;i <= res[0].numTracks;++i) 
+	//name the tracks once the lookup has answered
+	for(i = 1;res != NULL && i <= res[0].numTracks;++i) 
 	{
-	  printf("Ripping Track %d: %s\n",i,getRipperCDDBTrackTitle(&res[0],i));
-	  ripperRipTrack(rp,i,getRipperCDDBTrackTitle(&res[0],i));
+	  snprintf(filename,MAX_FILENAME_SIZE,"track%02d.wav",i);
+	  printf("Track %d: %s\n",i,getRipperCDDBTrackTitle(&res[0],i));
+	  if(getRipperCDDBTrackTitle(&res[0],i) != NULL)
+	    rename(filename,getRipperCDDBTrackTitle(&res[0],i));
 	}
 
 	printf("Complete.\n");
-	res = ripperCDDBQueryDestroy(res);
+	lookup = ripperCDDBLookupDestroy(lookup);
 	rp = ripperCDDataDestroy(rp);
+	ripperShutdown();
 	
  	return 0;
 }
@@ -0,0 +1,767 @@
+/**
+  libripper
+
+  Benchmarks of the rip, checksum and cddb paths.
+
+  Compile Command: gcc -O2 -DRIPPER_BENCH_ALLOCS -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=posix_memalign -lcdio -lcdio_cdda -lcdio_paranoia -lcddb -lFLAC -lpthread -o bench ripper.c ripper_checksum.c ripper_cache.c ripper_flac.c ripper_journal.c ripper_speed.c ripper_sim.c ripper_trace.c ripper_arena.c ripper_toc.c bench.c
+
+  usage: bench [-i image] [-n iterations] [-t tracks] [-l sectors] [-d dir]
+
+  Rips a simulated disc of tracks tracks of sectors sectors
+  each, or the disc image or drive given with -i, and prints
+  one json object with the results to stdout so runs can be
+  compared between releases.  Every benchmark is run
+  iterations times and reports the median and fastest run.
+  Outputs are written to a new directory in dir, /tmp by
+  default, and removed afterwards.
+
+  The cddb benchmarks answer from a cddbp server started on
+  the loopback interface so they measure the time spent
+  building the results rather than the network.
+
+  Allocations are only counted when the allocator is
+  wrapped as in the compile command, they cover the calls
+  made by libripper and not the ones made inside libcdio,
+  libcddb or libFLAC.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <getopt.h>
+#include <poll.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "ripper.h"
+
+#define RIPPER_BENCH_MAX_RESULTS 32
+#define RIPPER_BENCH_PATH_SIZE 512
+//matches the cddb server returns for every query
+#define RIPPER_BENCH_CDDB_MATCHES 4
+//queries made per iteration of the cddb benchmarks
+#define RIPPER_BENCH_CDDB_QUERIES 100
+//wav headers written per iteration
+#define RIPPER_BENCH_WAV_HEADERS 100000
+//sectors summed per iteration of the checksum benchmark
+#define RIPPER_BENCH_CHECKSUM_SECTORS 75000
+
+//one line of the json output
+typedef struct ripper_bench_result_t {
+	const char * name;
+	int ok;
+	int iterations;
+	uint64_t median_ns;
+	uint64_t min_ns;
+	//sectors or operations done by one iteration
+	long sectors;
+	long operations;
+	//allocations of the median iteration, -1 when they
+	//aren't counted
+	long allocs;
+	long alloc_bytes;
+}ripper_bench_result_t;
+
+typedef struct ripper_bench_t {
+	const char * image;
+	int iterations;
+	int tracks;
+	long trackSectors;
+	char dir[RIPPER_BENCH_PATH_SIZE];
+	ripper_sim_t * sim;
+	ripper_bench_result_t results[RIPPER_BENCH_MAX_RESULTS];
+	int numResults;
+}ripper_bench_t;
+
+#ifdef RIPPER_BENCH_ALLOCS
+static long ripper_bench_allocs = 0;
+static long ripper_bench_alloc_bytes = 0;
+
+void * __real_malloc(size_t);
+void * __real_calloc(size_t,size_t);
+void * __real_realloc(void *,size_t);
+int __real_posix_memalign(void **,size_t,size_t);
+
+static void ripperBenchCountAlloc(size_t size)
+{
+	__atomic_fetch_add(&ripper_bench_allocs,1,__ATOMIC_RELAXED);
+	__atomic_fetch_add(&ripper_bench_alloc_bytes,(long)size,__ATOMIC_RELAXED);
+}
+
+void * __wrap_malloc(size_t size)
+{
+	ripperBenchCountAlloc(size);
+	return __real_malloc(size);
+}
+
+void * __wrap_calloc(size_t count,size_t size)
+{
+	ripperBenchCountAlloc(count * size);
+	return __real_calloc(count,size);
+}
+
+void * __wrap_realloc(void * ptr,size_t size)
+{
+	ripperBenchCountAlloc(size);
+	return __real_realloc(ptr,size);
+}
+
+int __wrap_posix_memalign(void ** ptr,size_t alignment,size_t size)
+{
+	ripperBenchCountAlloc(size);
+	return __real_posix_memalign(ptr,alignment,size);
+}
+
+static void ripperBenchAllocs(long * allocs,long * bytes)
+{
+	*allocs = __atomic_load_n(&ripper_bench_allocs,__ATOMIC_RELAXED);
+	*bytes = __atomic_load_n(&ripper_bench_alloc_bytes,__ATOMIC_RELAXED);
+}
+#else
+static void ripperBenchAllocs(long * allocs,long * bytes)
+{
+	*allocs = -1;
+	*bytes = -1;
+}
+#endif
+
+static uint64_t ripperBenchNow()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//a benchmark iteration, returns the number of sectors or
+//operations done or -1 on error
+typedef long (*ripper_bench_fn_t)(ripper_bench_t *,ripper_cd_data_t *,void *);
+
+typedef struct ripper_bench_sample_t {
+	uint64_t ns;
+	long allocs;
+	long alloc_bytes;
+}ripper_bench_sample_t;
+
+static int ripperBenchCompareSample(const void * a,const void * b)
+{
+	const ripper_bench_sample_t * x = a;
+	const ripper_bench_sample_t * y = b;
+
+	return x->ns < y->ns ? -1 : x->ns > y->ns;
+}
+
+//runs fn iterations times and keeps the median and fastest
+//run. sectors is set when fn counts sectors, operations
+//otherwise
+static void ripperBenchRun(ripper_bench_t * bench,const char * name,int sectors,ripper_cd_data_t * ripper,ripper_bench_fn_t fn,void * arg)
+{
+	ripper_bench_result_t * result;
+	ripper_bench_sample_t * samples;
+	long done = 0;
+	int i;
+
+	if(bench->numResults == RIPPER_BENCH_MAX_RESULTS)
+		return;
+	result = &bench->results[bench->numResults++];
+	memset(result,0,sizeof(*result));
+	result->name = name;
+	result->allocs = -1;
+	result->alloc_bytes = -1;
+
+	samples = calloc(sizeof(ripper_bench_sample_t),bench->iterations);
+	if(samples == NULL)
+		return;
+
+	for(i = 0;i < bench->iterations;i++) {
+		long allocs,bytes,endAllocs,endBytes;
+		uint64_t start;
+
+		if(bench->sim != NULL)
+			ripperSimReset(bench->sim);
+		ripperBenchAllocs(&allocs,&bytes);
+		start = ripperBenchNow();
+		done = fn(bench,ripper,arg);
+		samples[i].ns = ripperBenchNow() - start;
+		ripperBenchAllocs(&endAllocs,&endBytes);
+		samples[i].allocs = allocs < 0 ? -1 : endAllocs - allocs;
+		samples[i].alloc_bytes = bytes < 0 ? -1 : endBytes - bytes;
+		if(done < 0) {
+			fprintf(stderr,"Error: Benchmark %s failed.\n",name);
+			free(samples);
+			return;
+		}
+	}
+
+	qsort(samples,bench->iterations,sizeof(ripper_bench_sample_t),ripperBenchCompareSample);
+	result->ok = 1;
+	result->iterations = bench->iterations;
+	result->min_ns = samples[0].ns;
+	result->median_ns = samples[bench->iterations / 2].ns;
+	result->allocs = samples[bench->iterations / 2].allocs;
+	result->alloc_bytes = samples[bench->iterations / 2].alloc_bytes;
+	if(sectors)
+		result->sectors = done;
+	else
+		result->operations = done;
+
+	free(samples);
+}
+
+//sink that only counts what it is given
+static int ripperBenchSinkBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	return 1;
+}
+
+static int ripperBenchSinkWrite(ripper_sink_t * sink,const int16_t * pcm,long sectors)
+{
+	*(long *)sink->data += sectors;
+	return 1;
+}
+
+static int ripperBenchSinkEnd(ripper_sink_t * sink,int ok)
+{
+	return ok ? 1 : -1;
+}
+
+static void ripperBenchSinkInit(ripper_sink_t * sink,long * sectors)
+{
+	memset(sink,0,sizeof(*sink));
+	sink->begin = ripperBenchSinkBegin;
+	sink->write = ripperBenchSinkWrite;
+	sink->end = ripperBenchSinkEnd;
+	sink->data = sectors;
+}
+
+static int ripperBenchIsAudio(ripper_cd_data_t * ripper,int track)
+{
+	return ripper->toc[track - 1].audio;
+}
+
+static long ripperBenchTrackSectors(ripper_cd_data_t * ripper,int track)
+{
+	return ripper->toc[track - 1].last - ripper->toc[track - 1].first + 1;
+}
+
+//every audio track ripped on its own to a sink
+static long ripperBenchTrackSink(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	ripper_sink_t sink;
+	long sectors = 0;
+	int i;
+
+	ripperBenchSinkInit(&sink,&sectors);
+	for(i = 1;i <= getRipperNumTracks(ripper);i++) {
+		if(ripperBenchIsAudio(ripper,i) && ripperRipTrackSink(ripper,i,&sink) != 1)
+			return -1;
+	}
+
+	return sectors;
+}
+
+//every audio track ripped on its own to a wav file
+static long ripperBenchTrackFiles(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	char filename[RIPPER_BENCH_PATH_SIZE + 32];
+	long sectors = 0;
+	int i;
+
+	for(i = 1;i <= getRipperNumTracks(ripper);i++) {
+		if(!ripperBenchIsAudio(ripper,i))
+			continue;
+		snprintf(filename,sizeof(filename),"%s/track%02d.wav",bench->dir,i);
+		if(ripperRipTrack(ripper,i,filename) != 1)
+			return -1;
+		sectors += ripperBenchTrackSectors(ripper,i);
+	}
+
+	return sectors;
+}
+
+static long ripperBenchDiscSink(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	ripper_sink_t sink;
+	long sectors = 0;
+
+	ripperBenchSinkInit(&sink,&sectors);
+	if(ripperRipDiscSink(ripper,&sink) != 1)
+		return -1;
+
+	return sectors;
+}
+
+//whole disc written with the output layout in arg
+static long ripperBenchDiscFiles(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	RIPPER_DISC_OUTPUT_TYPE output = *(RIPPER_DISC_OUTPUT_TYPE *)arg;
+	char filename[RIPPER_BENCH_PATH_SIZE + 32];
+	long sectors = 0;
+	int i;
+
+	if(output == RIPPER_DISC_BIN_CUE)
+		snprintf(filename,sizeof(filename),"%s/disc.bin",bench->dir);
+	else
+		snprintf(filename,sizeof(filename),"%s/track%%02d.wav",bench->dir);
+	if(ripperRipDisc(ripper,output,filename) != 1)
+		return -1;
+
+	for(i = 1;i <= getRipperNumTracks(ripper);i++) {
+		if(ripperBenchIsAudio(ripper,i))
+			sectors += ripperBenchTrackSectors(ripper,i);
+	}
+
+	return sectors;
+}
+
+//checksums of a buffer of pcm, nothing is read
+static long ripperBenchChecksum(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	const int16_t * pcm = arg;
+	ripper_checksum_state_t state;
+	ripper_track_checksums_t checksums;
+	long sectors = 0;
+
+	ripperChecksumInit(&state,RIPPER_BENCH_CHECKSUM_SECTORS,1,1);
+	while(sectors < RIPPER_BENCH_CHECKSUM_SECTORS) {
+		ripperChecksumUpdate(&state,pcm,RIPPER_DEFAULT_BATCH_SECTORS);
+		sectors += RIPPER_DEFAULT_BATCH_SECTORS;
+	}
+	ripperChecksumFinish(&state,&checksums);
+
+	return sectors;
+}
+
+static long ripperBenchWavHeader(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	FILE * fp = arg;
+	long i;
+
+	for(i = 0;i < RIPPER_BENCH_WAV_HEADERS;i++) {
+		rewind(fp);
+		if(ripperWriteWavHeader(fp,CDIO_CD_FRAMESIZE_RAW * i) != 1)
+			return -1;
+	}
+
+	return RIPPER_BENCH_WAV_HEADERS;
+}
+
+static long ripperBenchCDDBQuery(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	int numMatches = 0;
+	int i;
+
+	for(i = 0;i < RIPPER_BENCH_CDDB_QUERIES;i++) {
+		ripper_cddb_query_results_t * results = ripperCDDBQuery(ripper,&numMatches);
+		if(results == NULL)
+			return -1;
+		ripperCDDBQueryDestroy(results);
+	}
+
+	return RIPPER_BENCH_CDDB_QUERIES;
+}
+
+static long ripperBenchCDDBCached(ripper_bench_t * bench,ripper_cd_data_t * ripper,void * arg)
+{
+	int numMatches = 0;
+	int i;
+
+	for(i = 0;i < RIPPER_BENCH_CDDB_QUERIES;i++) {
+		ripper_cddb_query_results_t * results = ripperCDDBQueryCached(arg,ripper,&numMatches);
+		if(results == NULL)
+			return -1;
+		ripperCDDBQueryDestroy(results);
+	}
+
+	return RIPPER_BENCH_CDDB_QUERIES;
+}
+
+//cddbp server answering every query with the same matches
+typedef struct ripper_bench_cddb_t {
+	int fd;
+	int port;
+	int stop;
+	pthread_t thread;
+}ripper_bench_cddb_t;
+
+static int ripperBenchCDDBSend(int fd,const char * line)
+{
+	size_t length = strlen(line);
+	size_t done = 0;
+
+	while(done < length) {
+		ssize_t sent = send(fd,line + done,length - done,MSG_NOSIGNAL);
+		if(sent == -1 && errno == EINTR)
+			continue;
+		if(sent <= 0)
+			return -1;
+		done += sent;
+	}
+
+	return 1;
+}
+
+//reads one line without its line ending
+//returns 1 on success and -1 once the client is gone
+static int ripperBenchCDDBReadLine(int fd,char * line,size_t size)
+{
+	size_t length = 0;
+	char c;
+
+	while(1) {
+		ssize_t got = recv(fd,&c,1,0);
+		if(got == -1 && errno == EINTR)
+			continue;
+		if(got <= 0)
+			return -1;
+		if(c == '\n')
+			break;
+		if(c != '\r' && length + 1 < size)
+			line[length++] = c;
+	}
+	line[length] = '\0';
+
+	return 1;
+}
+
+static void ripperBenchCDDBAnswer(int fd)
+{
+	char line[1024];
+	char reply[256];
+	char category[64];
+	unsigned int discid = 0;
+	int tracks = 0;
+	int i;
+
+	ripperBenchCDDBSend(fd,"201 localhost CDDBP server v1.5PL3 ready\r\n");
+	while(ripperBenchCDDBReadLine(fd,line,sizeof(line)) == 1) {
+		if(strncmp(line,"cddb hello",10) == 0) {
+			ripperBenchCDDBSend(fd,"200 Hello and welcome\r\n");
+		} else if(strncmp(line,"proto",5) == 0) {
+			ripperBenchCDDBSend(fd,"201 OK, CDDB protocol level now: 6\r\n");
+		} else if(sscanf(line,"cddb query %x %d",&discid,&tracks) == 2) {
+			ripperBenchCDDBSend(fd,"210 Found exact matches, list follows (until terminating `.')\r\n");
+			for(i = 0;i < RIPPER_BENCH_CDDB_MATCHES;i++) {
+				snprintf(reply,sizeof(reply),"misc %08x Bench Artist %d / Bench Album %d\r\n",discid + i,i,i);
+				ripperBenchCDDBSend(fd,reply);
+			}
+			ripperBenchCDDBSend(fd,".\r\n");
+		} else if(sscanf(line,"cddb read %63s %x",category,&discid) == 2) {
+			snprintf(reply,sizeof(reply),"210 %s %08x CD database entry follows (until terminating `.')\r\n",category,discid);
+			ripperBenchCDDBSend(fd,reply);
+			ripperBenchCDDBSend(fd,"# xmcd\r\n#\r\n");
+			snprintf(reply,sizeof(reply),"DISCID=%08x\r\nDTITLE=Bench Artist / Bench Album\r\nDYEAR=1999\r\nDGENRE=Bench\r\n",discid);
+			ripperBenchCDDBSend(fd,reply);
+			for(i = 0;i < tracks;i++) {
+				snprintf(reply,sizeof(reply),"TTITLE%d=Guest Artist %d / Bench Track %d\r\n",i,i + 1,i + 1);
+				ripperBenchCDDBSend(fd,reply);
+			}
+			ripperBenchCDDBSend(fd,"EXTD=Served by the libripper benchmark\r\n");
+			for(i = 0;i < tracks;i++) {
+				snprintf(reply,sizeof(reply),"EXTT%d=\r\n",i);
+				ripperBenchCDDBSend(fd,reply);
+			}
+			ripperBenchCDDBSend(fd,"PLAYORDER=\r\n.\r\n");
+		} else if(strncmp(line,"quit",4) == 0) {
+			ripperBenchCDDBSend(fd,"230 Closing connection.  Goodbye.\r\n");
+			break;
+		} else {
+			ripperBenchCDDBSend(fd,"500 Unrecognized command.\r\n");
+		}
+	}
+}
+
+static void * ripperBenchCDDBThread(void * arg)
+{
+	ripper_bench_cddb_t * server = arg;
+	struct pollfd pfd;
+
+	pfd.fd = server->fd;
+	pfd.events = POLLIN;
+	while(!__atomic_load_n(&server->stop,__ATOMIC_ACQUIRE)) {
+		if(poll(&pfd,1,100) <= 0)
+			continue;
+		int client = accept(server->fd,NULL,NULL);
+		if(client == -1)
+			continue;
+		ripperBenchCDDBAnswer(client);
+		close(client);
+	}
+
+	return NULL;
+}
+
+//returns 1 on success and -1 on error
+static int ripperBenchCDDBStart(ripper_bench_cddb_t * server)
+{
+	struct sockaddr_in addr;
+	socklen_t length = sizeof(addr);
+
+	memset(server,0,sizeof(*server));
+	server->fd = socket(AF_INET,SOCK_STREAM | SOCK_CLOEXEC,0);
+	if(server->fd == -1)
+		return -1;
+
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if(bind(server->fd,(struct sockaddr *)&addr,sizeof(addr)) == -1
+		|| listen(server->fd,4) == -1
+		|| getsockname(server->fd,(struct sockaddr *)&addr,&length) == -1
+		|| pthread_create(&server->thread,NULL,ripperBenchCDDBThread,server) != 0) {
+		close(server->fd);
+		return -1;
+	}
+	server->port = ntohs(addr.sin_port);
+
+	return 1;
+}
+
+static void ripperBenchCDDBStop(ripper_bench_cddb_t * server)
+{
+	__atomic_store_n(&server->stop,1,__ATOMIC_RELEASE);
+	pthread_join(server->thread,NULL);
+	close(server->fd);
+}
+
+//removes the files the benchmarks left in dir and dir
+static void ripperBenchRemoveDir(const char * dir)
+{
+	char path[RIPPER_BENCH_PATH_SIZE];
+	struct dirent * entry;
+	DIR * d = opendir(dir);
+
+	if(d == NULL)
+		return;
+	while((entry = readdir(d)) != NULL) {
+		if(strcmp(entry->d_name,".") == 0 || strcmp(entry->d_name,"..") == 0)
+			continue;
+		snprintf(path,RIPPER_BENCH_PATH_SIZE,"%s/%s",dir,entry->d_name);
+		if(entry->d_type == DT_DIR)
+			ripperBenchRemoveDir(path);
+		else
+			unlink(path);
+	}
+	closedir(d);
+	rmdir(dir);
+}
+
+static driver_id_t ripperBenchDriver(const char * image)
+{
+	const char * ext = strrchr(image,'.');
+
+	if(ext == NULL)
+		return DRIVER_DEVICE;
+	if(strcasecmp(ext,".cue") == 0 || strcasecmp(ext,".bin") == 0)
+		return DRIVER_BINCUE;
+	if(strcasecmp(ext,".toc") == 0)
+		return DRIVER_CDRDAO;
+	if(strcasecmp(ext,".nrg") == 0)
+		return DRIVER_NRG;
+
+	return DRIVER_DEVICE;
+}
+
+static ripper_cd_data_t * ripperBenchOpen(ripper_bench_t * bench)
+{
+	if(bench->image != NULL)
+		return ripperInitSource(bench->image,ripperBenchDriver(bench->image));
+
+	lsn_t * starts = calloc(sizeof(lsn_t),bench->tracks);
+	int i;
+
+	if(starts == NULL)
+		return NULL;
+	for(i = 0;i < bench->tracks;i++)
+		starts[i] = i * bench->trackSectors;
+	bench->sim = ripperSimCreate(starts,bench->tracks,bench->tracks * bench->trackSectors,1);
+	free(starts);
+	if(bench->sim == NULL)
+		return NULL;
+
+	return ripperInitSim(bench->sim);
+}
+
+static void ripperBenchPrintString(const char * string)
+{
+	putchar('"');
+	for(;*string != '\0';string++) {
+		if(*string == '"' || *string == '\\')
+			printf("\\%c",*string);
+		else if((unsigned char)*string < 0x20)
+			printf("\\u%04x",*string);
+		else
+			putchar(*string);
+	}
+	putchar('"');
+}
+
+static void ripperBenchPrint(ripper_bench_t * bench,ripper_cd_data_t * ripper)
+{
+	long sectors = 0;
+	int i;
+
+	for(i = 1;i <= getRipperNumTracks(ripper);i++) {
+		if(ripperBenchIsAudio(ripper,i))
+			sectors += ripperBenchTrackSectors(ripper,i);
+	}
+
+	printf("{\n  \"source\": ");
+	ripperBenchPrintString(bench->image != NULL ? bench->image : "sim");
+	printf(",\n  \"audio_tracks\": %d,\n  \"audio_sectors\": %ld,\n  \"iterations\": %d,\n",
+		getRipperNumAudioTracks(ripper),sectors,bench->iterations);
+	printf("  \"benchmarks\": [\n");
+	for(i = 0;i < bench->numResults;i++) {
+		ripper_bench_result_t * result = &bench->results[i];
+		double seconds = result->median_ns / 1e9;
+
+		printf("    {\"name\": \"%s\", \"ok\": %s",result->name,result->ok ? "true" : "false");
+		if(result->ok) {
+			printf(", \"median_ns\": %llu, \"min_ns\": %llu",
+				(unsigned long long)result->median_ns,(unsigned long long)result->min_ns);
+			if(result->sectors > 0)
+				printf(", \"sectors\": %ld, \"sectors_per_sec\": %.1f, \"bytes_per_sec\": %.1f",
+					result->sectors,result->sectors / seconds,result->sectors * (double)CDIO_CD_FRAMESIZE_RAW / seconds);
+			else
+				printf(", \"operations\": %ld, \"ns_per_operation\": %.1f",
+					result->operations,result->operations > 0 ? result->median_ns / (double)result->operations : 0.0);
+			if(result->allocs >= 0)
+				printf(", \"allocs\": %ld, \"alloc_bytes\": %ld",result->allocs,result->alloc_bytes);
+			else
+				printf(", \"allocs\": null, \"alloc_bytes\": null");
+		}
+		printf("}%s\n",i + 1 < bench->numResults ? "," : "");
+	}
+	printf("  ]\n}\n");
+}
+
+int main(int argc,char ** argv)
+{
+	ripper_bench_t bench;
+	ripper_bench_cddb_t server;
+	ripper_cd_data_t * ripper;
+	const char * dir = "/tmp";
+	int opt;
+
+	memset(&bench,0,sizeof(bench));
+	bench.iterations = 5;
+	bench.tracks = 8;
+	bench.trackSectors = 4500;
+	while((opt = getopt(argc,argv,"i:n:t:l:d:")) != -1) {
+		switch(opt) {
+			case 'i': bench.image = optarg; break;
+			case 'n': bench.iterations = atoi(optarg); break;
+			case 't': bench.tracks = atoi(optarg); break;
+			case 'l': bench.trackSectors = atol(optarg); break;
+			case 'd': dir = optarg; break;
+			default:
+				fprintf(stderr,"usage: %s [-i image] [-n iterations] [-t tracks] [-l sectors] [-d dir]\n",argv[0]);
+				return 2;
+		}
+	}
+	if(bench.iterations < 1 || bench.tracks < 1 || bench.tracks > 99 || bench.trackSectors < 300) {
+		fprintf(stderr,"Error: Invalid benchmark size.\n");
+		return 2;
+	}
+
+	snprintf(bench.dir,RIPPER_BENCH_PATH_SIZE,"%s/ripper-bench-XXXXXX",dir);
+	if(mkdtemp(bench.dir) == NULL) {
+		fprintf(stderr,"Error: Unable to create a directory in %s.\n",dir);
+		return 1;
+	}
+
+	//the rip prints its progress to stdout, which only
+	//carries the results
+	ripper = ripperBenchOpen(&bench);
+	if(ripper == NULL) {
+		fprintf(stderr,"Error: Unable to open the disc.\n");
+		ripperBenchRemoveDir(bench.dir);
+		ripperSimDestroy(bench.sim);
+		return 1;
+	}
+
+	//rips
+	fflush(stdout);
+	int out = dup(STDOUT_FILENO);
+	FILE * devnull = freopen("/dev/null","w",stdout);
+
+	ripperBenchRun(&bench,"track_sink",1,ripper,ripperBenchTrackSink,NULL);
+	ripperBenchRun(&bench,"disc_sink",1,ripper,ripperBenchDiscSink,NULL);
+	setRipperPipelineDepth(ripper,4);
+	ripperBenchRun(&bench,"disc_sink_pipelined",1,ripper,ripperBenchDiscSink,NULL);
+	setRipperPipelineDepth(ripper,0);
+	ripperBenchRun(&bench,"track_wav_stdio",1,ripper,ripperBenchTrackFiles,NULL);
+
+	RIPPER_DISC_OUTPUT_TYPE trackFiles = RIPPER_DISC_TRACK_FILES;
+	RIPPER_DISC_OUTPUT_TYPE binCue = RIPPER_DISC_BIN_CUE;
+	ripperBenchRun(&bench,"disc_wav_stdio",1,ripper,ripperBenchDiscFiles,&trackFiles);
+	ripperBenchRun(&bench,"disc_bin_stdio",1,ripper,ripperBenchDiscFiles,&binCue);
+	setRipperOutputMode(ripper,RIPPER_OUTPUT_MMAP);
+	ripperBenchRun(&bench,"disc_bin_mmap",1,ripper,ripperBenchDiscFiles,&binCue);
+	//fails on file systems without O_DIRECT such as tmpfs
+	setRipperOutputMode(ripper,RIPPER_OUTPUT_DIRECT);
+	ripperBenchRun(&bench,"disc_bin_direct",1,ripper,ripperBenchDiscFiles,&binCue);
+	setRipperOutputMode(ripper,RIPPER_OUTPUT_STDIO);
+
+	//in memory paths
+	int16_t * pcm = malloc(RIPPER_DEFAULT_BATCH_SECTORS * CDIO_CD_FRAMESIZE_RAW);
+	if(pcm != NULL) {
+		long i;
+		for(i = 0;i < RIPPER_DEFAULT_BATCH_SECTORS * CDIO_CD_FRAMESIZE_RAW / 2;i++)
+			pcm[i] = (int16_t)(i * 2654435761u >> 16);
+		ripperBenchRun(&bench,"checksum",1,ripper,ripperBenchChecksum,pcm);
+		free(pcm);
+	}
+
+	FILE * header = tmpfile();
+	if(header != NULL) {
+		ripperBenchRun(&bench,"wav_header",0,ripper,ripperBenchWavHeader,header);
+		fclose(header);
+	}
+
+	//keeps libcddb's own disc cache from answering the
+	//queries in place of the server
+	setenv("HOME","/dev/null",1);
+	if(ripperBenchCDDBStart(&server) == 1) {
+		char cacheDir[RIPPER_BENCH_PATH_SIZE + 32];
+		ripper_cddb_cache_t * cache;
+		int numMatches = 0;
+
+		setRipperCDDBServer(ripper,"127.0.0.1",server.port);
+		ripperBenchRun(&bench,"cddb_query",0,ripper,ripperBenchCDDBQuery,NULL);
+
+		snprintf(cacheDir,sizeof(cacheDir),"%s/cddb",bench.dir);
+		cache = ripperCDDBCacheOpen(cacheDir,16,0);
+		if(cache != NULL) {
+			//the first query fills the cache
+			ripperCDDBQueryDestroy(ripperCDDBQueryCached(cache,ripper,&numMatches));
+			ripperBenchRun(&bench,"cddb_cached",0,ripper,ripperBenchCDDBCached,cache);
+			ripperCDDBCacheClose(cache);
+		}
+		ripperBenchCDDBStop(&server);
+	}
+
+	fflush(stdout);
+	if(devnull != NULL && out != -1) {
+		dup2(out,STDOUT_FILENO);
+		close(out);
+	}
+
+	ripperBenchPrint(&bench,ripper);
+
+	ripper = ripperCDDataDestroy(ripper);
+	bench.sim = ripperSimDestroy(bench.sim);
+	ripperBenchRemoveDir(bench.dir);
+	ripperShutdown();
+
+	return 0;
+}
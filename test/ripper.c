@@ -1,17 +1,32 @@
 /**
   libripper
 
-  Compile Command: gcc -lcdio -lcdio_cdda -lcdio_paranoia -lcddb -o test ripper.c test.c
+  Compile Command: gcc -lcdio -lcdio_cdda -lcdio_paranoia -lcddb -lFLAC -lpthread -o test ripper.c ripper_checksum.c ripper_cache.c ripper_flac.c ripper_journal.c ripper_speed.c ripper_sim.c ripper_trace.c ripper_arena.c ripper_toc.c test.c
 
 **/
 #ifdef HAVE_CONFIG_H
 #include "config.h"
 #endif
 
+//O_DIRECT is only declared for gnu sources
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
 #include <sys/types.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
 #include <cdio/cdio.h>
 #include <cdio/cdda.h>
 #include <cdio/cd_types.h>
@@ -33,6 +48,14 @@
 
 */
 ripper_cd_data_t * ripperInit()
+{
+	return ripperInitSource(NULL,DRIVER_DEVICE);
+}
+
+//allocates a ripper with every setting at its default and
+//no drive
+//returns NULL on error
+static ripper_cd_data_t * ripperCDDataNew(void)
 {
 	ripper_cd_data_t * ripper = malloc(sizeof(ripper_cd_data_t));
 	if(ripper == NULL) {
@@ -42,21 +65,71 @@ ripper_cd_data_t * ripperInit()
 	//intialize the structure
 	ripper->type = NO_CD;
 	ripper->frame_offsets = NULL;
+	ripper->toc = NULL;
+	ripper->image = 0;
+	ripper->indexed = 0;
+	ripper->toc_identity = 0;
+	ripper->read_q = NULL;
+	ripper->read_q_arg = NULL;
 	ripper->drive = NULL;
 	ripper->p_paranoia = NULL;
 	ripper->numAudioTracks = 0;
 	ripper->numDataTracks = 0;
 	ripper->totalTracks = 0;
 	ripper->format = UNCOMPRESSED_WAV;
+	ripper->read_mode = RIPPER_READ_PARANOIA;
+	ripper->output_mode = RIPPER_OUTPUT_STDIO;
+	ripper->batch_sectors = RIPPER_DEFAULT_BATCH_SECTORS;
+	ripper->read_buffer = NULL;
+	ripper->pipeline_depth = RIPPER_DEFAULT_PIPELINE_DEPTH;
+	ripper->ring_buffer = NULL;
+	ripper->cancel = 0;
+	ripper->progress_done = 0;
+	ripper->progress_total = 0;
+	ripper->next_sector = CDIO_INVALID_LSN;
+	ripper->burst_batches = NULL;
+	ripper->burst_count = 0;
+	ripper->burst_size = 0;
+	ripper->burst_first = 0;
+	ripper->checksums = NULL;
+	ripper->track_stats = NULL;
+	memset(&ripper->rip_stats,0,sizeof(ripper->rip_stats));
+	ripper->read_position = -1;
+	ripper->trace = NULL;
+	ripper->cddb_server = NULL;
+	ripper->cddb_port = 0;
+	ripper->journal = NULL;
+	ripperSpeedInit(&ripper->speed_control,1,0);
+	ripper->cdio_p = NULL;
+	ripper->external_drive = 0;
 	
-	ripper->cdio_p = cdio_open(NULL,DRIVER_DEVICE);
+	return ripper;
+}
+
+/**
+	ripper_cd_data_t * ripperInitSource(const char *,driver_id_t)
 
-	track_t i_tracks;
-	track_t first_track_num;
+	Same as ripperInit() but reads the cd from source
+	using the inputed libcdio driver.  Source is a device
+	for DRIVER_DEVICE, where NULL picks the first drive
+	found, or an image file for DRIVER_BINCUE, DRIVER_CDRDAO
+	and DRIVER_NRG.  Images are read without paranoia's
+	checks since they can't contain read errors.  Only the
+	table of contents is read here, the drive is opened for
+	cdda through the same handle by the first rip.
 
-	unsigned int numAudio = 0;
-	unsigned int numData = 0;
-	unsigned int i,j;
+	Returns NULL on error.
+*/
+ripper_cd_data_t * ripperInitSource(const char * source,driver_id_t driver)
+{
+	ripper_cd_data_t * ripper = ripperCDDataNew();
+	if(ripper == NULL) {
+		return ripper;
+	}
+	
+	//the one handle serves the table of contents now and
+	//cdda once the disc is ripped
+	ripper->cdio_p = cdio_open(source,driver);
 
 	//check if a driver can be found for the cdrom
 	//if not return NO_CD since we can't do anything
@@ -66,94 +139,192 @@ ripper_cd_data_t * ripperInit()
 		ripperCDDataDestroy(ripper);
 		return NULL;
 	}
+	//an image reads back the same data every time so
+	//paranoia only has to pass the sectors through
+	ripper->image = driver != DRIVER_DEVICE;
+	
+	if(ripperTocRead(ripper,source) == -1) {
+		return ripperCDDataDestroy(ripper);
+	}
+	
+	ripper->checksums = calloc(sizeof(ripper_track_checksums_t),ripper->totalTracks);
+	ripper->track_stats = calloc(sizeof(ripper_rip_stats_t),ripper->totalTracks);
+	if(ripper->checksums == NULL || ripper->track_stats == NULL) {
+		printf("Error: Allocating memory for the track list\n");
+		return ripperCDDataDestroy(ripper);
+	}
+	
+	return ripper;
+}
+
+/**
+	ripper_cd_data_t * ripperInitDrive(cdrom_drive_t *)
+
+	Same as ripperInit() but rips from a drive that is
+	already open, such as the drive of a ripper_sim_t.
+	The table of contents is read from the drive and
+	paranoia runs in full.  The drive stays owned by the
+	caller and has to outlive the ripper.
+
+	Returns NULL on error.
+*/
+ripper_cd_data_t * ripperInitDrive(cdrom_drive_t * drive)
+{
+	if(drive == NULL) {
+		return NULL;
+	}
+	
+	ripper_cd_data_t * ripper = ripperCDDataNew();
+	if(ripper == NULL) {
+		return ripper;
+	}
+	ripper->drive = drive;
+	ripper->external_drive = 1;
+	
+	if(ripperTocReadDrive(ripper,drive) == -1) {
+		return ripperCDDataDestroy(ripper);
+	}
 	
+	ripper->checksums = calloc(sizeof(ripper_track_checksums_t),ripper->totalTracks);
+	ripper->track_stats = calloc(sizeof(ripper_rip_stats_t),ripper->totalTracks);
+	if(ripper->checksums == NULL || ripper->track_stats == NULL) {
+		printf("Error: Allocating memory for the track list\n");
+		return ripperCDDataDestroy(ripper);
+	}
 	
-	ripper->drive = cdio_cddap_find_a_cdrom(1,NULL);
+	return ripper;
+}
+
+int ripperOpenDrive(ripper_cd_data_t * ripper)
+{
+	if(ripper == NULL) {
+		return -1;
+	}
 	
 	if(ripper->drive == NULL) {
-		printf("An error occured initalizing the drive for ripping.\n");
-		return NULL;
-	}
-	
-	cdio_cddap_open(ripper->drive);
-	
-	cdio_cddap_verbose_set(ripper->drive, CDDA_MESSAGE_PRINTIT, CDDA_MESSAGE_PRINTIT);
-	
-	ripper->p_paranoia = cdio_paranoia_init(ripper->drive);
-	
-	first_track_num = cdio_get_first_track_num(ripper->cdio_p);
-	//make sure there is a cd inserted
-	if(first_track_num == CDIO_INVALID_TRACK) {
-		ripper->type = NO_CD;
-		ripper = ripperCDDataDestroy(ripper);
-	}
-	else {
-		//get the total number of tracks on the cd data and audio
-		i_tracks = cdio_get_num_tracks(ripper->cdio_p);
-		ripper->totalTracks = i_tracks;
-		//allocate enough space to store all of the frame offsets
-		ripper->frame_offsets = calloc(sizeof(int),i_tracks);
-		if(ripper->frame_offsets == NULL)
-		{
-			printf("Error: Allocating memory for frame offsets\n");
-			ripper = ripperCDDataDestroy(ripper);
-			return ripper;
-		}
-		//look for audio and data tracks
-		for(i = first_track_num,j=1;i <= i_tracks;i++,j++) {
-			if(TRACK_FORMAT_AUDIO == cdio_get_track_format(ripper->cdio_p,i)) {
-				ripper->frame_offsets[j - 1] = ripperGetFrameOffset(ripper->cdio_p,i,j);
-				//return NULL if unable to calculate a frame offset
-				if(ripper->frame_offsets[j - 1] == -1) {
-					//free allocated memory
-					ripperCDDataDestroy(ripper);
-					return NULL;
-				}
-				numAudio++;
-			} else {
-				ripper->frame_offsets[j-1] =ripperGetFrameOffset(ripper->cdio_p,i,j);
-				if(ripper->frame_offsets[j - 1] == -1) {
-					ripperCDDataDestroy(ripper);
-					return NULL;
-				}
-				numData++;
-			}
-		}
-		//get the length of the cd n seconds
-		ripper->cd_length = ripperGetDiskLength(ripper->cdio_p);
-		//make sure we are able to get the disc length
-		if(ripper->cd_length == -1) {
-			ripperCDDataDestroy(ripper);
-			return NULL;
+		//cdda reads through the handle the toc came from
+		//rather than looking for the drive again
+		ripper->drive = cdio_cddap_identify_cdio(ripper->cdio_p,1,NULL);
+		if(ripper->drive == NULL || cdio_cddap_open(ripper->drive) != 0) {
+			printf("An error occured initalizing the drive for ripping.\n");
+			if(ripper->drive != NULL)
+				cdio_cddap_close_no_free_cdio(ripper->drive);
+			ripper->drive = NULL;
+			return -1;
 		}
-		//determine the cd types
-		//this isn't complete but enough for the purposes
-		//of this library
-		if(numAudio > 0 && numData == 0)
-			ripper->type = AUDIO_CD;
-		else if(numData > 0 && numAudio == 0)
-			ripper->type = DATA_CD;
-		else if(numData > 0 && numAudio > 0)
-			ripper->type = MIXED_MODE_CD;
-		else
-			ripper->type = NO_CD; //not sure why this might happen?
+		cdio_cddap_verbose_set(ripper->drive, CDDA_MESSAGE_PRINTIT, CDDA_MESSAGE_PRINTIT);
 	}
 	
-	ripper->numAudioTracks = numAudio;
-	ripper->numDataTracks = numData;
-	ripper->totalTracks = numData + numAudio;
+	if(ripper->p_paranoia == NULL) {
+		ripper->p_paranoia = cdio_paranoia_init(ripper->drive);
+		if(ripper->p_paranoia == NULL) {
+			printf("An error occured initalizing paranoia.\n");
+			return -1;
+		}
+		if(ripper->image)
+			cdio_paranoia_modeset(ripper->p_paranoia,PARANOIA_MODE_DISABLE);
+	}
 	
-	return ripper;
+	return 1;
 }
 
 //ripper_cd_data_t set methods
 
+void setRipperCDDBServer(ripper_cd_data_t * ripper, const char * server, int port)
+{
+	if(ripper != NULL) {
+		free(ripper->cddb_server);
+		ripper->cddb_server = NULL;
+		if(server != NULL) {
+			ripper->cddb_server = calloc(sizeof(char),strlen(server)+1);
+			if(ripper->cddb_server != NULL)
+				strcpy(ripper->cddb_server,server);
+		}
+		ripper->cddb_port = port;
+	}
+}
+
 void setRipperFormat(ripper_cd_data_t * ripper, RIPPER_FORMAT_TYPE fileType)
 {
 	if(ripper != NULL)
 		ripper->format = fileType;
 }
 
+void setRipperBatchSectors(ripper_cd_data_t * ripper, unsigned int sectors)
+{
+	if(ripper != NULL) {
+		if(sectors == 0)
+			sectors = RIPPER_DEFAULT_BATCH_SECTORS;
+		//the buffer is sized for the batch so drop it
+		//and let the next rip allocate a new one
+		if(sectors != ripper->batch_sectors) {
+			free(ripper->read_buffer);
+			free(ripper->ring_buffer);
+			ripper->read_buffer = NULL;
+			ripper->ring_buffer = NULL;
+		}
+		ripper->batch_sectors = sectors;
+	}
+}
+
+void setRipperReadMode(ripper_cd_data_t * ripper, RIPPER_READ_MODE mode)
+{
+	if(ripper != NULL)
+		ripper->read_mode = mode;
+}
+
+void setRipperOutputMode(ripper_cd_data_t * ripper, RIPPER_OUTPUT_MODE mode)
+{
+	if(ripper != NULL)
+		ripper->output_mode = mode;
+}
+
+void setRipperAdaptiveSpeed(ripper_cd_data_t * ripper, int minSpeed, int maxSpeed)
+{
+	if(ripper == NULL)
+		return;
+	
+	int wasAdaptive = ripper->speed_control.max_speed > 0;
+	ripperSpeedInit(&ripper->speed_control,minSpeed,maxSpeed > 0 ? maxSpeed : 0);
+	
+	//an open drive is left at the speed the last adaptive
+	//rip ended on, give it back its own speed and paranoia
+	//its default cache
+	if(wasAdaptive && maxSpeed <= 0 && ripper->drive != NULL) {
+		if(cdio_cddap_speed_set(ripper->drive,-1) != 0)
+			printf("Warning: Unable to return the drive to its own speed.\n");
+		if(ripper->p_paranoia != NULL)
+			cdio_paranoia_cachemodel_size(ripper->p_paranoia,ripper->speed_control.window);
+	}
+}
+
+int setRipperTrace(ripper_cd_data_t * ripper, long events)
+{
+	if(ripper == NULL || events < 0) {
+		return -1;
+	}
+	
+	ripper->trace = ripperTraceDestroy(ripper->trace);
+	if(events > 0) {
+		ripper->trace = ripperTraceCreate(events);
+		if(ripper->trace == NULL)
+			return -1;
+	}
+	
+	return 1;
+}
+
+void setRipperPipelineDepth(ripper_cd_data_t * ripper, unsigned int depth)
+{
+	if(ripper != NULL) {
+		if(depth != ripper->pipeline_depth) {
+			free(ripper->ring_buffer);
+			ripper->ring_buffer = NULL;
+		}
+		ripper->pipeline_depth = depth;
+	}
+}
+
 //ripper_cd_data_t get methods
 RIPPER_CD_TYPE getRipperCDType(ripper_cd_data_t * ripper)
 {
@@ -169,6 +340,20 @@ RIPPER_FORMAT_TYPE getRipperFormat(ripper_cd_data_t * ripper)
 	else
 		return -1;
 }
+RIPPER_READ_MODE getRipperReadMode(ripper_cd_data_t * ripper)
+{
+	if(ripper != NULL)
+		return ripper->read_mode;
+	else
+		return -1;
+}
+RIPPER_OUTPUT_MODE getRipperOutputMode(ripper_cd_data_t * ripper)
+{
+	if(ripper != NULL)
+		return ripper->output_mode;
+	else
+		return -1;
+}
 int getRipperNumAudioTracks(ripper_cd_data_t * ripper) 
 {
 	if(ripper != NULL)
@@ -197,6 +382,80 @@ int getRipperCDLength(ripper_cd_data_t * ripper)
 	else
 		return -1;
 }
+int getRipperTrackPregap(ripper_cd_data_t * ripper,unsigned int trackNum)
+{
+	if(ripper != NULL && trackNum >= 1 && trackNum <= ripper->totalTracks)
+		return ripper->toc[trackNum - 1].first - ripper->toc[trackNum - 1].pregap;
+	else
+		return -1;
+}
+int getRipperHiddenTrackSectors(ripper_cd_data_t * ripper)
+{
+	//the pregap of the first track holds audio when the
+	//track starts late
+	if(ripper != NULL && ripper->totalTracks > 0 && ripper->toc[0].audio)
+		return ripper->toc[0].first - ripper->toc[0].pregap;
+	else
+		return 0;
+}
+int getRipperBatchSectors(ripper_cd_data_t * ripper)
+{
+	if(ripper != NULL)
+		return ripper->batch_sectors;
+	else
+		return -1;
+}
+int getRipperPipelineDepth(ripper_cd_data_t * ripper)
+{
+	if(ripper != NULL)
+		return ripper->pipeline_depth;
+	else
+		return -1;
+}
+int getRipperSpeed(ripper_cd_data_t * ripper)
+{
+	if(ripper != NULL)
+		return ripper->speed_control.max_speed > 0 ? ripper->speed_control.speed : 0;
+	else
+		return -1;
+}
+int getRipperProgress(ripper_cd_data_t * ripper)
+{
+	if(ripper == NULL) {
+		return -1;
+	}
+	
+	long total = __atomic_load_n(&ripper->progress_total,__ATOMIC_RELAXED);
+	long done = __atomic_load_n(&ripper->progress_done,__ATOMIC_RELAXED);
+	if(total == 0)
+		return 0;
+	
+	return done >= total ? 100 : (int)(done * 100 / total);
+}
+const ripper_track_checksums_t * getRipperTrackChecksums(ripper_cd_data_t * ripper,unsigned int trackNum)
+{
+	if(ripper != NULL && trackNum >= 1 && trackNum <= ripper->totalTracks
+		&& ripper->checksums[trackNum - 1].valid)
+		return &ripper->checksums[trackNum - 1];
+	else
+		return NULL;
+}
+
+const ripper_rip_stats_t * getRipperTrackStats(ripper_cd_data_t * ripper,unsigned int trackNum)
+{
+	if(ripper != NULL && trackNum >= 1 && trackNum <= ripper->totalTracks)
+		return &ripper->track_stats[trackNum - 1];
+	else
+		return NULL;
+}
+
+const ripper_rip_stats_t * getRipperRipStats(ripper_cd_data_t * ripper)
+{
+	if(ripper != NULL)
+		return &ripper->rip_stats;
+	else
+		return NULL;
+}
 		
 
 /**
@@ -210,10 +469,23 @@ ripper_cd_data_t * ripperCDDataDestroy(ripper_cd_data_t * ripper)
 {
 	if(ripper != NULL) {
 		//free cdio memory
-		cdio_paranoia_free(ripper->p_paranoia);
-		cdio_cddap_close(ripper->drive);
-		cdio_destroy(ripper->cdio_p);
+		if(ripper->p_paranoia != NULL)
+			cdio_paranoia_free(ripper->p_paranoia);
+		//the drive shares the ripper's cdio handle
+		if(!ripper->external_drive && ripper->drive != NULL)
+			cdio_cddap_close_no_free_cdio(ripper->drive);
+		if(ripper->cdio_p != NULL)
+			cdio_destroy(ripper->cdio_p);
 		free(ripper->frame_offsets);
+		free(ripper->toc);
+		free(ripper->read_buffer);
+		free(ripper->ring_buffer);
+		free(ripper->burst_batches);
+		free(ripper->checksums);
+		free(ripper->track_stats);
+		ripperTraceDestroy(ripper->trace);
+		free(ripper->cddb_server);
+		ripperJournalClose(ripper->journal);
 		free(ripper);
 	}	
 	return NULL;
@@ -262,6 +534,9 @@ int ripperGetDiskLength(CdIo_t * p_cdio)
 	return length;
 }
 
+//serializes the creation of cddb connections
+static pthread_mutex_t ripper_cddb_lock = PTHREAD_MUTEX_INITIALIZER;
+
 //initializes a new ripper_cddb_data_t object using an already
 //initialized ripper_cd_data_t object.
 //returns the ripper_cddb_data_t object or NULL on error
@@ -281,6 +556,8 @@ ripper_cddb_data_t * ripperCDDBInit(ripper_cd_data_t * rp)
 		}
 		
 		rp_cddb->totalTracks = 0;
+		rp_cddb->numMatches = -1;
+		rp_cddb->conn = NULL;
 		rp_cddb->disc = cddb_disc_new();
 		
 		if(rp_cddb->disc == NULL) {
@@ -314,10 +591,19 @@ ripper_cddb_data_t * ripperCDDBInit(ripper_cd_data_t * rp)
 			//calculate the disc id, necessary to do queries
 			rp_cddb->disc,cddb_disc_calc_discid(rp_cddb->disc);
 			//unsigned int id = cddb_disc_get_discid(rp_cddb->disc);
+			//libcddb sets up its globals in the first cddb_new
+			//so connections are created one at a time
+			pthread_mutex_lock(&ripper_cddb_lock);
 			rp_cddb->conn = cddb_new();
+			pthread_mutex_unlock(&ripper_cddb_lock);
 			if(rp_cddb->conn == NULL) {
 				printf("Error: Unable to allocate memory for cddb connection.\n");
 				rp_cddb = ripperCDDBDestroy(rp_cddb);
+			} else {
+				if(rp->cddb_server != NULL)
+					cddb_set_server_name(rp_cddb->conn,rp->cddb_server);
+				if(rp->cddb_port > 0)
+					cddb_set_server_port(rp_cddb->conn,rp->cddb_port);
 			}
 		}
 		
@@ -341,8 +627,6 @@ ripper_cddb_data_t * ripperCDDBDestroy(ripper_cddb_data_t * rp_cddb)
 		if(rp_cddb->conn != NULL) {
 			cddb_destroy(rp_cddb->conn);
 		}
-		//free any global resources used by libcddb
-		libcddb_shutdown();
 		//free the ripper_cddb_data_t object
 		free(rp_cddb);
 	}
@@ -354,13 +638,91 @@ ripper_cddb_data_t * ripperCDDBDestroy(ripper_cddb_data_t * rp_cddb)
 //returns -1 on error
 int ripperGetNumCDDBMatches(ripper_cddb_data_t * rp_cddb)
 {
-	static num;
-	
 	if(rp_cddb != NULL) {
-		num =  cddb_query(rp_cddb->conn,rp_cddb->disc);
+		rp_cddb->numMatches = cddb_query(rp_cddb->conn,rp_cddb->disc);
+		return rp_cddb->numMatches;
+	}
+	
+	return -1;
+}
+
+//computes the cddb disc id the same way as
+//cddb_disc_calc_discid without building a cddb disc
+unsigned int ripperGetCDDBDiscId(ripper_cd_data_t * rp)
+{
+	unsigned int sum = 0;
+	unsigned int i;
+	
+	if(rp == NULL || rp->totalTracks == 0) {
+		return 0;
+	}
+	
+	for(i = 0;i < rp->totalTracks;i++) {
+		unsigned int seconds = FRAMES_TO_SECONDS(rp->frame_offsets[i]);
+		do {
+			sum += seconds % 10;
+			seconds /= 10;
+		} while(seconds != 0);
+	}
+	
+	unsigned int length = rp->cd_length - FRAMES_TO_SECONDS(rp->frame_offsets[0]);
+	
+	return (sum % 0xff) << 24 | length << 8 | rp->totalTracks;
+}
+
+//frees any global resources used by libcddb
+void ripperShutdown()
+{
+	libcddb_shutdown();
+}
+
+//copies the disc libcddb read last into result, its
+//tracks and strings are allocated in the arena
+//returns 1 on success and -1 on error
+static int ripperCDDBReadMatch(ripper_cddb_arena_t * arena,cddb_disc_t * disc,ripper_cddb_query_results_t * result)
+{
+	const char * strings[5] = { cddb_disc_get_category_str(disc), cddb_disc_get_artist(disc),
+		cddb_disc_get_title(disc), cddb_disc_get_genre(disc), cddb_disc_get_ext_data(disc) };
+	char ** fields[5] = { &result->category, &result->artist, &result->title, &result->genre, &result->ext_data };
+	int i;
+	
+	for(i = 0;i < 5;i++) {
+		*fields[i] = NULL;
+		if(strings[i] != NULL && (*fields[i] = ripperCDDBArenaIntern(arena,strings[i],strlen(strings[i]))) == NULL)
+			return -1;
+	}
+	result->year = cddb_disc_get_year(disc);
+	result->numTracks = cddb_disc_get_track_count(disc);
+	result->arena = arena;
+	
+	//the tracks array is never empty so a NULL tracks
+	//pointer only marks the end of the results
+	result->tracks = ripperCDDBArenaAlloc(arena,sizeof(ripper_cddb_track_t) * (result->numTracks + 1));
+	if(result->tracks == NULL)
+		return -1;
+	
+	int j = 0;
+	cddb_track_t * curTrack = cddb_disc_get_track_first(disc);
+	while(curTrack != NULL && j < result->numTracks) {
+		const char * title = cddb_track_get_title(curTrack);
+		const char * artist = cddb_track_get_artist(curTrack);
+		
+		result->tracks[j].length = cddb_track_get_length(curTrack);
+		if(title != NULL && (result->tracks[j].title = ripperCDDBArenaIntern(arena,title,strlen(title))) == NULL)
+			return -1;
+		if(artist != NULL && (result->tracks[j].artist = ripperCDDBArenaIntern(arena,artist,strlen(artist))) == NULL)
+			return -1;
+		curTrack = cddb_disc_get_track_next(disc);
+		j++;
 	}
 	
-	return num;
+	return 1;
+}
+
+//bytes an arena is started with for the matches of a disc
+static size_t ripperCDDBArenaSize(int matches,unsigned int tracks)
+{
+	return (size_t)matches * (sizeof(ripper_cddb_track_t) * (tracks + 1) + 64 * (tracks + 4));
 }
 
 ripper_cddb_query_results_t * ripperCDDBQuery(ripper_cd_data_t * rp,int * numMatches)
@@ -375,79 +737,37 @@ ripper_cddb_query_results_t * ripperCDDBQuery(ripper_cd_data_t * rp,int * numMat
 		int matches = ripperGetNumCDDBMatches(rp_cddb);
 		//check for no results
 		//may modify this behavior later
-		if(matches == 0) {
-			*numMatches = 0;
+		if(matches <= 0) {
+			*numMatches = matches;
 			ripperCDDBDestroy(rp_cddb);
 			return NULL;
 		}
 		
-		ripper_cddb_query_results_t * cddb_results = calloc(sizeof(ripper_cddb_query_results_t),matches);
+		//every match goes into the same arena, one extra
+		//zeroed result marks the end of the array
+		ripper_cddb_query_results_t * cddb_results = ripperCDDBResultsCreate(matches,ripperCDDBArenaSize(matches,rp->totalTracks));
 		
 		if(cddb_results != NULL) {
 			int i = 0;
 			
 			do {
 				cddb_read(rp_cddb->conn,rp_cddb->disc);
-				cddb_results[i].tracks =  calloc(sizeof(ripper_cddb_track_t),cddb_disc_get_track_count(rp_cddb->disc));
-				if(cddb_results[i].tracks == NULL) {
-					free(cddb_results);
+				if(ripperCDDBReadMatch(cddb_results->arena,rp_cddb->disc,&cddb_results[i]) == -1) {
+					cddb_results = ripperCDDBQueryDestroy(cddb_results);
+					matches = -1;
 					printf("Error: Unable to allocate memory for tracks.\n");
 					break;
 				}
-				//add the disk data
-				cddb_results[i].numTracks = cddb_disc_get_track_count(rp_cddb->disc);
-				//get category
-				if(cddb_disc_get_category_str(rp_cddb->disc)) {
-				cddb_results[i].category = calloc(sizeof(char),strlen(cddb_disc_get_category_str(rp_cddb->disc))+1);
-				strcpy(cddb_results[i].category,cddb_disc_get_category_str(rp_cddb->disc));
-				}
-				//get artist				
-				if(cddb_disc_get_artist(rp_cddb->disc)) {
-				cddb_results[i].artist = calloc(sizeof(char),strlen(cddb_disc_get_artist(rp_cddb->disc))+1);
-				strcpy(cddb_results[i].artist,cddb_disc_get_artist(rp_cddb->disc));
-				}
-				//get title
-				if(cddb_disc_get_title(rp_cddb->disc)) {
-				cddb_results[i].title = calloc(sizeof(char),strlen(cddb_disc_get_title(rp_cddb->disc))+1);
-				strcpy(cddb_results[i].title,cddb_disc_get_title(rp_cddb->disc));
-				}
-				//get genre
-				if(cddb_disc_get_genre(rp_cddb->disc)) {
-				cddb_results[i].genre = calloc(sizeof(char),strlen(cddb_disc_get_genre(rp_cddb->disc))+1);
-				strcpy(cddb_results[i].genre,cddb_disc_get_genre(rp_cddb->disc));
-				}
-				//get year
-				cddb_results[i].year = cddb_disc_get_year(rp_cddb->disc);
-				//get extended data
-				if(cddb_disc_get_ext_data(rp_cddb->disc)) {
-				cddb_results[i].ext_data = calloc(sizeof(char),strlen(cddb_disc_get_ext_data(rp_cddb->disc))+1);
-				strcpy(cddb_results[i].ext_data,cddb_disc_get_ext_data(rp_cddb->disc));
-				}
-				
-				
-				//add the track data
-				int j = 0;
-				cddb_track_t * curTrack = cddb_disc_get_track_first(rp_cddb->disc);
-				while(curTrack != NULL) {
-					//get track length
-					cddb_results[i].tracks[j].length = cddb_track_get_length(curTrack);
-					//get track title
-					if(cddb_track_get_title(curTrack)) {
-					cddb_results[i].tracks[j].title = calloc(sizeof(char),strlen(cddb_track_get_title(curTrack))+1);
-					strcpy(cddb_results[i].tracks[j].title,cddb_track_get_title(curTrack));
-					}
-					if(cddb_track_get_artist(curTrack)) {
-						cddb_results[i].tracks[j].artist = calloc(sizeof(char),strlen(cddb_track_get_artist(curTrack))+1);
-						strcpy(cddb_results[i].tracks[j].artist,cddb_track_get_artist(curTrack));
-					}
-					curTrack = cddb_disc_get_track_next(rp_cddb->disc);
-					j++;
-				}
-				
 				i++;
 				
-			} while(cddb_query_next(rp_cddb->conn,rp_cddb->disc));
+			} while(i < matches && cddb_query_next(rp_cddb->conn,rp_cddb->disc));
 			
+			//the server may list fewer matches than it counted
+			if(cddb_results != NULL)
+				cddb_results->arena->numMatches = matches = i;
+		} else {
+			matches = -1;
+			printf("Error: Unable to allocate memory for the cddb results.\n");
 		}
 		*numMatches = matches;
 		ripperCDDBDestroy(rp_cddb);
@@ -462,20 +782,20 @@ ripper_cddb_query_results_t * ripperCDDBQuery(ripper_cd_data_t * rp,int * numMat
 //always returns NULL;
 ripper_cddb_query_results_t * ripperCDDBQueryDestroy(ripper_cddb_query_results_t * cddb_res)
 {
-	if(cddb_res != NULL) {
-		int length = ripperGetNumCDDBMatches(NULL);
-		
+	if(cddb_res != NULL && cddb_res->arena != NULL) {
+		//results of the library go with their arena
+		ripperCDDBArenaDestroy(cddb_res->arena);
+	} else if(cddb_res != NULL) {
 		int i;
-		//free each result
-		for(i = 0;i<length;i++) {
+		//free each result, the array ends with
+		//a result without tracks
+		for(i = 0;cddb_res[i].tracks != NULL;i++) {
 			int j;
 			//free the data from each track on
 			//the current result
-			if(cddb_res[i].tracks != NULL) {
-				for(j = 0;j < cddb_res[i].numTracks;j++) {
-					free(cddb_res[i].tracks[j].title);	
-					free(cddb_res[i].tracks[j].artist);
-				}
+			for(j = 0;j < cddb_res[i].numTracks;j++) {
+				free(cddb_res[i].tracks[j].title);	
+				free(cddb_res[i].tracks[j].artist);
 			}
 			//free all other disc data
 			free(cddb_res[i].tracks);
@@ -493,58 +813,271 @@ ripper_cddb_query_results_t * ripperCDDBQueryDestroy(ripper_cddb_query_results_t
 	return NULL;
 }
 
-//cddb accessor methods
-char * getRipperCDDBCategory(const ripper_cddb_query_results_t * rp_cddb)
+int getRipperCDDBNumMatches(const ripper_cddb_query_results_t * cddb_res)
 {
-	if(rp_cddb != NULL) {
-		return rp_cddb->category;	
-	} else
-		return NULL;
+	int matches = 0;
+	
+	if(cddb_res == NULL)
+		return -1;
+	if(cddb_res->arena != NULL && cddb_res->arena->results == cddb_res)
+		return cddb_res->arena->numMatches;
+	
+	while(cddb_res[matches].tracks != NULL)
+		matches++;
+	
+	return matches;
 }
 
-char * getRipperCDDBArtist(const ripper_cddb_query_results_t * rp_cddb) 
+ripper_cddb_matches_t * ripperCDDBMatchesOpen(ripper_cd_data_t * rp,int * numMatches)
 {
-	if(rp_cddb != NULL) {
-		return rp_cddb->artist;
-	} else
+	if(rp == NULL) {
+		*numMatches = -1;
+		return NULL;
+	}
+	
+	ripper_cddb_matches_t * matches = calloc(sizeof(ripper_cddb_matches_t),1);
+	if(matches == NULL) {
+		printf("Error: Unable to allocate memory for the cddb query.\n");
+		*numMatches = -1;
 		return NULL;
+	}
+	
+	matches->cddb = ripperCDDBInit(rp);
+	matches->arena = ripperCDDBArenaCreate(ripperCDDBArenaSize(1,rp->totalTracks));
+	if(matches->cddb == NULL || matches->arena == NULL) {
+		*numMatches = -1;
+		return ripperCDDBMatchesClose(matches);
+	}
+	
+	matches->numMatches = ripperGetNumCDDBMatches(matches->cddb);
+	*numMatches = matches->numMatches;
+	if(matches->numMatches <= 0)
+		return ripperCDDBMatchesClose(matches);
+	
+	return matches;
 }
 
-char * getRipperCDDBTitle(const ripper_cddb_query_results_t * rp_cddb)
+const ripper_cddb_query_results_t * ripperCDDBMatchesNext(ripper_cddb_matches_t * matches)
 {
-	if(rp_cddb != NULL) {
-		return rp_cddb->title;
-	} else
+	if(matches == NULL || matches->read >= matches->numMatches)
+		return NULL;
+	
+	//the query starts on the first match
+	if(matches->read > 0 && !cddb_query_next(matches->cddb->conn,matches->cddb->disc)) {
+		matches->read = matches->numMatches;
+		return NULL;
+	}
+	
+	//the last match is dropped, its memory holds the next
+	ripperCDDBArenaReset(matches->arena);
+	memset(matches->result,0,sizeof(matches->result));
+	cddb_read(matches->cddb->conn,matches->cddb->disc);
+	if(ripperCDDBReadMatch(matches->arena,matches->cddb->disc,&matches->result[0]) == -1) {
+		printf("Error: Unable to allocate memory for tracks.\n");
+		matches->read = matches->numMatches;
 		return NULL;
+	}
+	matches->read++;
+	
+	return &matches->result[0];
 }
 
-char * getRipperCDDBGenre(const ripper_cddb_query_results_t * rp_cddb)
+ripper_cddb_matches_t * ripperCDDBMatchesClose(ripper_cddb_matches_t * matches)
 {
-	if(rp_cddb != NULL) {
-		return rp_cddb->genre;
-	} else
-		return NULL;
+	if(matches != NULL) {
+		ripperCDDBDestroy(matches->cddb);
+		ripperCDDBArenaDestroy(matches->arena);
+		free(matches);
+	}
+	
+	return NULL;
 }
 
-char * getRipperCDDBExtData(const ripper_cddb_query_results_t * rp_cddb)
+//copies the parts of the ripper a cddb query reads so the
+//query doesn't share the ripper with the rip
+//returns NULL on error
+static ripper_cd_data_t * ripperCopyTOC(const ripper_cd_data_t * rp)
 {
-	if(rp_cddb != NULL) {
-		return rp_cddb->ext_data;
-	} else
+	ripper_cd_data_t * toc = calloc(1,sizeof(ripper_cd_data_t));
+	if(toc == NULL)
+		return NULL;
+
+	toc->type = rp->type;
+	toc->numAudioTracks = rp->numAudioTracks;
+	toc->numDataTracks = rp->numDataTracks;
+	toc->totalTracks = rp->totalTracks;
+	toc->cd_length = rp->cd_length;
+	toc->cddb_port = rp->cddb_port;
+	toc->frame_offsets = malloc(sizeof(int) * (rp->totalTracks + 1));
+	if(rp->cddb_server != NULL)
+		toc->cddb_server = strdup(rp->cddb_server);
+	if(toc->frame_offsets == NULL || (rp->cddb_server != NULL && toc->cddb_server == NULL)) {
+		free(toc->frame_offsets);
+		free(toc->cddb_server);
+		free(toc);
 		return NULL;
+	}
+	memcpy(toc->frame_offsets,rp->frame_offsets,sizeof(int) * rp->totalTracks);
+
+	return toc;
 }
 
-int getRipperCDDBYear(const ripper_cddb_query_results_t * rp_cddb)
+static void * ripperCDDBLookupRun(void * arg)
 {
-	if(rp_cddb != NULL) {
-		return rp_cddb->year;
-	} else
-		return -1;
+	ripper_cddb_lookup_t * lookup = arg;
+	int numMatches = -1;
+
+	ripper_cddb_query_results_t * results = ripperCDDBQueryCached(lookup->cache,lookup->toc,&numMatches);
+	lookup->results = results;
+	lookup->numMatches = numMatches;
+	if(lookup->callback != NULL)
+		lookup->callback(results,numMatches,lookup->arg);
+
+	pthread_mutex_lock(&lookup->lock);
+	lookup->done = 1;
+	pthread_cond_broadcast(&lookup->finished);
+	pthread_mutex_unlock(&lookup->lock);
+
+	return NULL;
 }
 
-char * getRipperCDDBTrackTitle(const ripper_cddb_query_results_t * rp_cddb,unsigned int trackNum)
+ripper_cddb_lookup_t * ripperCDDBQueryAsync(ripper_cd_data_t * rp,ripper_cddb_cache_t * cache,ripper_cddb_callback_t callback,void * arg)
 {
-	if(rp_cddb != NULL && trackNum <= rp_cddb->numTracks) {
+	if(rp == NULL) {
+		return NULL;
+	}
+	if(rp->type != AUDIO_CD && rp->type != MIXED_MODE_CD) {
+		printf("Error: No Audio CD available.\n");
+		return NULL;
+	}
+
+	ripper_cddb_lookup_t * lookup = calloc(1,sizeof(ripper_cddb_lookup_t));
+	if(lookup == NULL) {
+		printf("Error: Unable to allocate memory for cddb lookup.\n");
+		return NULL;
+	}
+	lookup->toc = ripperCopyTOC(rp);
+	if(lookup->toc == NULL) {
+		printf("Error: Unable to allocate memory for cddb lookup.\n");
+		free(lookup);
+		return NULL;
+	}
+	lookup->cache = cache;
+	lookup->callback = callback;
+	lookup->arg = arg;
+	lookup->numMatches = -1;
+	pthread_mutex_init(&lookup->lock,NULL);
+	pthread_cond_init(&lookup->finished,NULL);
+
+	if(pthread_create(&lookup->thread,NULL,ripperCDDBLookupRun,lookup) != 0) {
+		printf("Error: Unable to start cddb lookup.\n");
+		pthread_cond_destroy(&lookup->finished);
+		pthread_mutex_destroy(&lookup->lock);
+		ripperCDDataDestroy(lookup->toc);
+		free(lookup);
+		return NULL;
+	}
+
+	return lookup;
+}
+
+int ripperCDDBLookupDone(ripper_cddb_lookup_t * lookup)
+{
+	if(lookup == NULL) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&lookup->lock);
+	int done = lookup->done;
+	pthread_mutex_unlock(&lookup->lock);
+
+	return done;
+}
+
+ripper_cddb_query_results_t * ripperCDDBLookupWait(ripper_cddb_lookup_t * lookup,int * numMatches)
+{
+	if(lookup == NULL) {
+		*numMatches = -1;
+		return NULL;
+	}
+
+	pthread_mutex_lock(&lookup->lock);
+	while(!lookup->done)
+		pthread_cond_wait(&lookup->finished,&lookup->lock);
+	pthread_mutex_unlock(&lookup->lock);
+
+	*numMatches = lookup->numMatches;
+	return lookup->results;
+}
+
+ripper_cddb_lookup_t * ripperCDDBLookupDestroy(ripper_cddb_lookup_t * lookup)
+{
+	if(lookup != NULL) {
+		//libcddb can't abort a query so this waits
+		//for the server to answer
+		pthread_join(lookup->thread,NULL);
+		pthread_cond_destroy(&lookup->finished);
+		pthread_mutex_destroy(&lookup->lock);
+		ripperCDDBQueryDestroy(lookup->results);
+		ripperCDDataDestroy(lookup->toc);
+		free(lookup);
+	}
+
+	return NULL;
+}
+
+//cddb accessor methods
+char * getRipperCDDBCategory(const ripper_cddb_query_results_t * rp_cddb)
+{
+	if(rp_cddb != NULL) {
+		return rp_cddb->category;	
+	} else
+		return NULL;
+}
+
+char * getRipperCDDBArtist(const ripper_cddb_query_results_t * rp_cddb) 
+{
+	if(rp_cddb != NULL) {
+		return rp_cddb->artist;
+	} else
+		return NULL;
+}
+
+char * getRipperCDDBTitle(const ripper_cddb_query_results_t * rp_cddb)
+{
+	if(rp_cddb != NULL) {
+		return rp_cddb->title;
+	} else
+		return NULL;
+}
+
+char * getRipperCDDBGenre(const ripper_cddb_query_results_t * rp_cddb)
+{
+	if(rp_cddb != NULL) {
+		return rp_cddb->genre;
+	} else
+		return NULL;
+}
+
+char * getRipperCDDBExtData(const ripper_cddb_query_results_t * rp_cddb)
+{
+	if(rp_cddb != NULL) {
+		return rp_cddb->ext_data;
+	} else
+		return NULL;
+}
+
+int getRipperCDDBYear(const ripper_cddb_query_results_t * rp_cddb)
+{
+	if(rp_cddb != NULL) {
+		return rp_cddb->year;
+	} else
+		return -1;
+}
+
+char * getRipperCDDBTrackTitle(const ripper_cddb_query_results_t * rp_cddb,unsigned int trackNum)
+{
+	if(rp_cddb != NULL && trackNum >= 1 && trackNum <= rp_cddb->numTracks) {
 		return rp_cddb->tracks[trackNum - 1].title;
 	} else
 		return NULL;
@@ -552,7 +1085,7 @@ char * getRipperCDDBTrackTitle(const ripper_cddb_query_results_t * rp_cddb,unsig
 
 char * getRipperCDDBTrackArtist(const ripper_cddb_query_results_t * rp_cddb,unsigned int trackNum)
 {
-	if(rp_cddb != NULL && trackNum <= rp_cddb->numTracks) {
+	if(rp_cddb != NULL && trackNum >= 1 && trackNum <= rp_cddb->numTracks) {
 		return rp_cddb->tracks[trackNum - 1].artist;
 	} else
 		return NULL;
@@ -561,54 +1094,68 @@ char * getRipperCDDBTrackArtist(const ripper_cddb_query_results_t * rp_cddb,unsi
 //returns the length of the track in seconds
 int getRipperCDDBTrackLength(const ripper_cddb_query_results_t * rp_cddb,unsigned int trackNum)
 {
-	if(rp_cddb != NULL && trackNum <= rp_cddb->numTracks) {
+	if(rp_cddb != NULL && trackNum >= 1 && trackNum <= rp_cddb->numTracks) {
 		return rp_cddb->tracks[trackNum - 1].length;
 	} else
 		return -1;
 }
 
+//replaces a string of a result with a copy of value, results
+//held in an arena take an interned copy and leave the old
+//string to the arena
+static void ripperCDDBSetString(ripper_cddb_query_results_t * rp_cddb,char ** field,const char * value)
+{
+	char * copy;
+	
+	if(rp_cddb->arena != NULL) {
+		copy = ripperCDDBArenaIntern(rp_cddb->arena,value,strlen(value));
+	} else {
+		copy = calloc(sizeof(char),strlen(value)+1);
+		if(copy != NULL) {
+			strcpy(copy,value);
+			free(*field);
+		}
+	}
+	
+	if(copy == NULL) {
+		printf("Error: Unable to allocate memory for the cddb string.\n");
+		return;
+	}
+	*field = copy;
+}
+
 void setRipperCDDBCategory(ripper_cddb_query_results_t * rp_cddb,char * category)
 {
 	if(rp_cddb != NULL && category != NULL) {
-		free(rp_cddb->category);
-		rp_cddb->category = calloc(sizeof(char),strlen(category)+1);
-		strcpy(rp_cddb->category,category);
+		ripperCDDBSetString(rp_cddb,&rp_cddb->category,category);
 	}
 }
 
 void setRipperCDDBArtist(ripper_cddb_query_results_t * rp_cddb, char * artist)
 {
 	if(rp_cddb != NULL && artist != NULL) {
-		free(rp_cddb->artist);
-		rp_cddb->artist = calloc(sizeof(char),strlen(artist)+1);
-		strcpy(rp_cddb->artist,artist);
+		ripperCDDBSetString(rp_cddb,&rp_cddb->artist,artist);
 	}
 }
 
 void setRipperCDDBTitle(ripper_cddb_query_results_t * rp_cddb, char * title)
 {
 	if(rp_cddb != NULL && title != NULL) {
-		free(rp_cddb->title);
-		rp_cddb->title = calloc(sizeof(char),strlen(title)+1);
-		strcpy(rp_cddb->title,title);
+		ripperCDDBSetString(rp_cddb,&rp_cddb->title,title);
 	}
 }
 
 void setRipperCDDBGenre(ripper_cddb_query_results_t * rp_cddb,char * genre)
 {
 	if(rp_cddb != NULL && genre != NULL) {
-		free(rp_cddb->genre);
-		rp_cddb->genre = calloc(sizeof(char),strlen(genre)+1);
-		strcpy(rp_cddb->genre,genre);
+		ripperCDDBSetString(rp_cddb,&rp_cddb->genre,genre);
 	}
 }
 
 void setRipperCDDBExtData(ripper_cddb_query_results_t * rp_cddb,char * ext_data)
 {
 	if(rp_cddb != NULL && ext_data != NULL) {
-		free(rp_cddb->ext_data);
-		rp_cddb->ext_data = calloc(sizeof(char),strlen(ext_data)+1);
-		strcpy(rp_cddb->ext_data,ext_data);
+		ripperCDDBSetString(rp_cddb,&rp_cddb->ext_data,ext_data);
 	}
 }
 
@@ -621,142 +1168,2133 @@ void setRipperCDDBYear(ripper_cddb_query_results_t * rp_cddb, int year)
 
 void setRipperCDDBTrackTitle(ripper_cddb_query_results_t * rp_cddb,char * title,unsigned int trackNum)
 {
-	if(rp_cddb != NULL && title != NULL,trackNum <= rp_cddb->numTracks) {
-		free(rp_cddb->tracks[trackNum - 1].title);
-		rp_cddb->tracks[trackNum - 1].title = calloc(sizeof(char),strlen(title));
-		strcpy(rp_cddb->tracks[trackNum-1].title,title);
+	if(rp_cddb != NULL && title != NULL && trackNum >= 1 && trackNum <= rp_cddb->numTracks) {
+		ripperCDDBSetString(rp_cddb,&rp_cddb->tracks[trackNum - 1].title,title);
 	}
 }
 
 void setRipperCDDBTrackArtist(ripper_cddb_query_results_t * rp_cddb,char * artist,unsigned int trackNum)
 {
-	if(rp_cddb != NULL && artist != NULL && trackNum <= rp_cddb->numTracks) {
-		free(rp_cddb->tracks[trackNum - 1].artist);
-		rp_cddb->tracks[trackNum - 1].artist = calloc(sizeof(char),strlen(artist));
-		strcpy(rp_cddb->tracks[trackNum - 1].artist,artist);
+	if(rp_cddb != NULL && artist != NULL && trackNum >= 1 && trackNum <= rp_cddb->numTracks) {
+		ripperCDDBSetString(rp_cddb,&rp_cddb->tracks[trackNum - 1].artist,artist);
 	}
 }
 
 void setRipperCDDBTrackLength(ripper_cddb_query_results_t * rp_cddb,int length,unsigned int trackNum)
 {
-	if(rp_cddb != NULL && trackNum <= rp_cddb->numTracks) {
+	if(rp_cddb != NULL && trackNum >= 1 && trackNum <= rp_cddb->numTracks) {
 		rp_cddb->tracks[trackNum - 1].length = length;
 	}
 }
 
+//stores value little endian in the bytes bytes at out
+static void ripperPutLE(unsigned char * out,uint32_t value,int bytes)
+{
+	int i;
+	
+	for(i = 0;i < bytes;i++)
+		out[i] = (value >> (8 * i)) & 0xFF;
+}
+
+//fills header with the wav header of a file holding
+//data_size bytes of audio, header is WAV_HEADER_SIZE + 8
+//bytes long.  Fields are little endian whatever the host
+//returns 1 on success and -1 on error
+static int ripperGetWavHeader(unsigned char * header,int data_size)
+{
+	if(header == NULL || data_size < 0)
+		return -1;
+	
+	//riff chunk
+	memcpy(header,WAV_HDR_CHNK_ID,4);
+	ripperPutLE(header + 4,data_size + WAV_HEADER_SIZE,4);
+	memcpy(header + 8,RIFF_TYPE,4);
+	
+	//format chunk, currently no compression
+	memcpy(header + 12,FORMAT_ID,4);
+	ripperPutLE(header + 16,FMT_CHUNK_SIZE + (EXTRA_FORMAT_BYTES / 8),4);
+	ripperPutLE(header + 20,COMPRESSION_CODE,2);
+	ripperPutLE(header + 22,NUM_CHANNELS,2);
+	ripperPutLE(header + 24,SAMPLE_RATE,4);
+	ripperPutLE(header + 28,AVG_BYTES_PER_SEC,4);
+	ripperPutLE(header + 32,BLOCK_ALIGN,2);
+	ripperPutLE(header + 34,BITS_PER_SAMPLE,2);
+	
+	//data chunk
+	memcpy(header + 36,DATA_ID,4);
+	ripperPutLE(header + 40,data_size,4);
+	
+	return 1;
+}
+
 //writes the header information for the wav file
 //to the inputed file.  The file pointer must be open
 //for writing and be pointing at the beginning of the
-//file for the correct result 
+//file for the correct result.  The header is built in
+//memory and written in one call
 //returns 1 on success and returns -1 on error
 int ripperWriteWavHeader(FILE * fp, int data_size) 
 {
-	if(fp == NULL) {
+	unsigned char header[WAV_HEADER_SIZE + 8];
+	
+	if(fp == NULL || ripperGetWavHeader(header,data_size) == -1) {
 		return -1;
 	}
 	
-	int file_size = data_size + WAV_HEADER_SIZE;
-	
-	//write the riff type chunk
-	fwrite(WAV_HDR_CHNK_ID,sizeof(char),4,fp);
-	//write file size
-	fwrite(&file_size,sizeof(int),1,fp);
-	//write riff types
-	fwrite(&RIFF_TYPE,sizeof(char),4,fp);
+	return fwrite(header,sizeof(header),1,fp) == 1 ? 1 : -1;
+}
+
+//returns the batch buffer for the ripper allocating it
+//on first use.  The buffer is page aligned and holds
+//batch_sectors raw sectors, it is reused for every rip
+//returns NULL if the buffer can't be allocated
+static int16_t * ripperGetReadBuffer(ripper_cd_data_t * ripper)
+{
+	if(ripper->read_buffer == NULL) {
+		void * buffer = NULL;
+		size_t size = (size_t)CDIO_CD_FRAMESIZE_RAW * ripper->batch_sectors;
+		
+		if(posix_memalign(&buffer,RIPPER_BUFFER_ALIGNMENT,size) != 0) {
+			printf("Error: Unable to allocate memory for the read buffer.\n");
+			return NULL;
+		}
+		ripper->read_buffer = buffer;
+	}
 	
-	//write the format chunk
+	return ripper->read_buffer;
+}
+
+//returns non zero once ripperCancelRip has been called
+static int ripperRipCancelled(ripper_cd_data_t * ripper)
+{
+	return __atomic_load_n(&ripper->cancel,__ATOMIC_ACQUIRE);
+}
+
+void ripperCancelRip(ripper_cd_data_t * ripper)
+{
+	if(ripper != NULL)
+		__atomic_store_n(&ripper->cancel,1,__ATOMIC_RELEASE);
+}
+
+//monotonic time in nanoseconds for the rip statistics
+//and trace
+static uint64_t ripperNanoTime()
+{
+	struct timespec now;
 	
-	//write the format id
-	fwrite(FORMAT_ID,sizeof(char),4,fp);
-	//write the chunk size
-	int chunk_size = FMT_CHUNK_SIZE + (EXTRA_FORMAT_BYTES / 8);
-	fwrite(&chunk_size,sizeof(int),1,fp);
-	//write compession code - currently no compression
-	fwrite(&COMPRESSION_CODE,sizeof(short),1,fp);
-	//write the number of channels currently 2 (stereo)
-	fwrite(&NUM_CHANNELS,sizeof(short),1,fp);
-	//write the sample rate
-	fwrite(&SAMPLE_RATE,sizeof(int),1,fp);
-	//write the avg bytes per second
-	fwrite(&AVG_BYTES_PER_SEC,sizeof(int),1,fp);
-	//write the block align
-	fwrite(&BLOCK_ALIGN,sizeof(short),1,fp);
-	//write bits per sample
-	fwrite(&BITS_PER_SAMPLE,sizeof(short),1,fp);
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//moves paranoia to sector of the track unless it is
+//already there. consecutive reads never seek so the
+//drive's read ahead and the paranoia cache survive track
+//boundaries
+static void ripperSeekTo(ripper_cd_data_t * ripper,int track,lsn_t sector)
+{
+	if(ripper->next_sector != sector) {
+		uint64_t start = ripper->trace != NULL ? ripperNanoTime() : 0;
+		cdio_paranoia_seek(ripper->p_paranoia,sector,SEEK_SET);
+		if(ripper->trace != NULL)
+			ripperTraceEvent(ripper->trace,RIPPER_TRACE_SEEK,start,track,sector,0);
+		ripper->next_sector = sector;
+		ripper->read_position = -1;
+	}
+}
+
+//ripper and track of the rip reading on this thread with
+//the track's statistics. the paranoia callback has no
+//argument to carry them
+typedef struct ripper_paranoia_context_t {
+	ripper_cd_data_t * ripper;
+	ripper_rip_stats_t * stats;
+	int track;
+} ripper_paranoia_context_t;
+
+static __thread ripper_paranoia_context_t ripper_paranoia_context;
+
+//counts the event and hands it to the speed control.
+//position is the end of each read, a read ending short of
+//the furthest position since the last seek went back over
+//sectors already read
+static void ripperParanoiaCallback(long int position,paranoia_cb_mode_t event)
+{
+	ripper_cd_data_t * ripper = ripper_paranoia_context.ripper;
+	ripper_rip_stats_t * stats = ripper_paranoia_context.stats;
 	
-	//write the data chunk
+	if((int)event >= 0 && (int)event < RIPPER_STATS_EVENTS)
+		stats->events[event]++;
+	if(event == PARANOIA_CB_READ) {
+		stats->reads++;
+		if(position <= ripper->read_position)
+			stats->rereads++;
+		else
+			ripper->read_position = position;
+	}
 	
-	//write the data id
-	fwrite(DATA_ID,sizeof(char),4,fp);
-	//write the data sizeof
-	fwrite(&data_size,sizeof(int),1,fp);	
+	if(ripper->speed_control.max_speed > 0)
+		ripperSpeedEvent(&ripper->speed_control,event);
+	if(ripper->trace != NULL)
+		ripperTraceEvent(ripper->trace,RIPPER_TRACE_PARANOIA,0,ripper_paranoia_context.track,
+			position / (CDIO_CD_FRAMESIZE_RAW / sizeof(int16_t)),event);
+}
+
+//asks the drive for the speed the control settled on and
+//tells paranoia how much the drive caches
+static void ripperApplySpeed(ripper_cd_data_t * ripper)
+{
+	ripper_speed_control_t * control = &ripper->speed_control;
 	
-	return 1;
+	//images and drives that can't change speed carry on
+	//at the speed they have
+	if(cdio_cddap_speed_set(ripper->drive,control->speed) != 0)
+		printf("Warning: Unable to set the drive speed to %dx.\n",control->speed);
+	cdio_paranoia_cachemodel_size(ripper->p_paranoia,control->window);
 }
 
-int ripperRipTrack(ripper_cd_data_t * ripper,int trackNum, char * filename)
+//reads count sectors of the track starting at sector from
+//paranoia into buffer. the drive's error and message
+//strings are only collected once per batch rather than
+//once per sector. The events paranoia reports are counted
+//in the track's statistics and with adaptive speed the
+//speed is changed between batches
+//returns the number of sectors read or -1 on error
+static long ripperParanoiaReadBatch(ripper_cd_data_t * ripper,int track,lsn_t sector,int16_t * buffer,long count)
 {
-	if(filename == NULL) {
-		printf("Error: No filename was specified.\n");
-		return -1;
+	ripper_speed_control_t * control = &ripper->speed_control;
+	long window = control->window;
+	long i;
+	long read = 0;
+	
+	ripper_paranoia_context.ripper = ripper;
+	ripper_paranoia_context.stats = &ripper->track_stats[track - 1];
+	ripper_paranoia_context.track = track;
+	
+	ripperSeekTo(ripper,track,sector);
+	
+	for(i = 0;i < count;i++) {
+		uint64_t start = ripper->trace != NULL ? ripperNanoTime() : 0;
+		int16_t * p_buffer = cdio_paranoia_read(ripper->p_paranoia,ripperParanoiaCallback);
+		if(ripper->trace != NULL)
+			ripperTraceEvent(ripper->trace,RIPPER_TRACE_READ,start,track,sector + i,p_buffer != NULL);
+		if(!p_buffer)
+			break;
+		memcpy(buffer + (i * CDIO_CD_FRAMESIZE_RAW / sizeof(int16_t)),p_buffer,CDIO_CD_FRAMESIZE_RAW);
+		read++;
 	}
 	
-	//make sure that the track is an audio track
-	if(!cdio_cddap_track_audiop(ripper->drive,trackNum)) {
-		printf("Error: Track %d is not an audio track.\n",trackNum);
+	if(control->max_speed > 0 && (ripperSpeedUpdate(control,read) || control->window != window))
+		ripperApplySpeed(ripper);
+	
+	char * err_msg = cdio_cddap_errors(ripper->drive);
+	char * inf_msg = cdio_cddap_messages(ripper->drive);
+	
+	if(err_msg) {
+		free(err_msg);
+	}
+	if(inf_msg) {
+		free(inf_msg);
+	}
+	
+	if(read != count) {
+		//paranoia's position is unknown after a failed read
+		ripper->next_sector = CDIO_INVALID_LSN;
 		return -1;
 	}
+	ripper->next_sector = sector + count;
 	
-	//attempt to get the first and last sectors of the track
-	lsn_t f_sector = cdio_cddap_track_firstsector(ripper->drive,trackNum);
-	lsn_t l_sector = cdio_cddap_track_lastsector(ripper->drive,trackNum);
+	return read;
+}
+
+//reads count sectors starting at sector straight from the
+//drive at full speed without any paranoia checks
+//returns the number of sectors read or -1 on error
+static long ripperBurstReadBatch(ripper_cd_data_t * ripper,int track,lsn_t sector,int16_t * buffer,long count)
+{
+	long read = 0;
 	
-	//make sure we are able to get the first and last sectors
-	//of the track to be ripped.
-	if(f_sector == -1 || l_sector == -1) {
-		printf("Error: Unable to get track information.\n");
+	while(read < count) {
+		uint64_t start = ripper->trace != NULL ? ripperNanoTime() : 0;
+		long n = cdio_cddap_read(ripper->drive,buffer + (read * CDIO_CD_FRAMESIZE_RAW / sizeof(int16_t)),sector + read,count - read);
+		if(ripper->trace != NULL)
+			ripperTraceEvent(ripper->trace,RIPPER_TRACE_BURST_READ,start,track,sector + read,n);
+		ripper->track_stats[track - 1].reads++;
+		if(n <= 0)
+			return -1;
+		read += n;
+	}
+	
+	return read;
+}
+
+//first burst pass over a span. Every batch of the span is
+//read at full speed and only its checksum is kept, the
+//second pass in ripperReadBatch is compared against it
+//returns 1 on success and -1 on error
+static int ripperBurstScan(ripper_cd_data_t * ripper,const ripper_span_t * span)
+{
+	ripper->burst_count = 0;
+	
+	if(ripper->read_mode != RIPPER_READ_BURST)
+		return 1;
+	
+	int16_t * buffer = ripperGetReadBuffer(ripper);
+	if(buffer == NULL)
 		return -1;
+	
+	long batches = (span->last - span->start + ripper->batch_sectors) / ripper->batch_sectors;
+	if(batches > ripper->burst_size) {
+		ripper_burst_batch_t * burst = realloc(ripper->burst_batches,sizeof(ripper_burst_batch_t) * batches);
+		if(burst == NULL) {
+			printf("Error: Unable to allocate memory for the burst checksums.\n");
+			return -1;
+		}
+		ripper->burst_batches = burst;
+		ripper->burst_size = batches;
+	}
+	
+	ripper_rip_stats_t * stats = &ripper->track_stats[span->track - 1];
+	uint64_t start = ripperNanoTime();
+	long b;
+	lsn_t i = span->start;
+	for(b = 0;b < batches;b++) {
+		long count = span->last - i + 1;
+		if(count > ripper->batch_sectors)
+			count = ripper->batch_sectors;
+		
+		if(ripperRipCancelled(ripper))
+			return -1;
+		
+		//a batch the drive can't read is left for paranoia
+		ripper->burst_batches[b].valid = ripperBurstReadBatch(ripper,span->track,i,buffer,count) == count;
+		if(ripper->burst_batches[b].valid)
+			ripper->burst_batches[b].crc = ripperCRC32Update(0,buffer,(size_t)CDIO_CD_FRAMESIZE_RAW * count);
+		i += count;
 	}
 	
-	int data_size = CDIO_CD_FRAMESIZE_RAW * (l_sector - f_sector + 1);
+	ripper->burst_first = span->start;
+	ripper->burst_count = batches;
+	stats->read_ns += ripperNanoTime() - start;
 	
-	FILE * fp = fopen(filename,"w");
-	ripperWriteWavHeader(fp,data_size);
+	return 1;
+}
+
+//reads count sectors starting at sector into buffer.
+//In burst mode the batch is read at full speed and kept
+//if it matches the checksum from the first pass, otherwise
+//it is read again through paranoia.  The reads and the
+//time spent on them are counted in the track's statistics
+//returns the number of sectors read or -1 on error
+static long ripperReadBatch(ripper_cd_data_t * ripper,int track,lsn_t sector,int16_t * buffer,long count)
+{
+	ripper_rip_stats_t * stats = &ripper->track_stats[track - 1];
+	uint64_t start = ripperNanoTime();
+	long read = -1;
 	
-	if(fp == NULL) {
-		printf("Error: Unable to open file %s for writing.\n",filename);
+	if(ripper->burst_count > 0) {
+		long b = (sector - ripper->burst_first) / ripper->batch_sectors;
+		
+		if(b < ripper->burst_count && ripper->burst_batches[b].valid) {
+			if(ripperBurstReadBatch(ripper,track,sector,buffer,count) == count
+				&& ripperCRC32Update(0,buffer,(size_t)CDIO_CD_FRAMESIZE_RAW * count) == ripper->burst_batches[b].crc)
+				read = count;
+			else
+				stats->rereads++;
+		}
+	}
+	
+	if(read == -1)
+		read = ripperParanoiaReadBatch(ripper,track,sector,buffer,count);
+	if(read > 0)
+		stats->sectors_read += read;
+	stats->read_ns += ripperNanoTime() - start;
+	
+	return read;
+}
+
+//returns the buffer backing the pipeline ring allocating
+//it on first use. It holds pipeline_depth batches
+//returns NULL if the buffer can't be allocated
+static int16_t * ripperGetRingBuffer(ripper_cd_data_t * ripper)
+{
+	if(ripper->ring_buffer == NULL) {
+		void * buffer = NULL;
+		size_t size = (size_t)CDIO_CD_FRAMESIZE_RAW * ripper->batch_sectors * ripper->pipeline_depth;
+		
+		if(posix_memalign(&buffer,RIPPER_BUFFER_ALIGNMENT,size) != 0) {
+			printf("Error: Unable to allocate memory for the pipeline.\n");
+			return NULL;
+		}
+		ripper->ring_buffer = buffer;
+	}
+	
+	return ripper->ring_buffer;
+}
+
+//reads every span and hands it to the sink on the
+//calling thread
+//returns 1 on success and -1 on error
+static int ripperRipSerial(ripper_cd_data_t * ripper,const ripper_span_t * spans,int numSpans,ripper_sink_t * sink)
+{
+	int16_t * buffer = ripperGetReadBuffer(ripper);
+	if(buffer == NULL) {
 		return -1;
 	}
 	
-	cdio_paranoia_seek(ripper->p_paranoia,f_sector,SEEK_SET);
+	int result = 1;
+	int s;
+	
+	for(s = 0;s < numSpans && result == 1;s++) {
+		lsn_t i = spans[s].start;
+		
+		if(ripperBurstScan(ripper,&spans[s]) == -1) {
+			printf("A read error occured. Aborting..\n");
+			return -1;
+		}
+		if(sink->begin(sink,&spans[s]) == -1)
+			return -1;
+		
+		// 	read in the span one batch at a time, each batch
+		//	is written out with a single call
+		while(i <= spans[s].last) {
+			long count = spans[s].last - i + 1;
+			if(count > ripper->batch_sectors)
+				count = ripper->batch_sectors;
+			
+			if(ripperRipCancelled(ripper)) {
+				printf("Rip cancelled.\n");
+				result = -1;
+				break;
+			}
+			if(ripperReadBatch(ripper,spans[s].track,i,buffer,count) == -1) {
+				printf("A read error occured. Aborting..\n");
+				result = -1;
+				break;
+			}
+			if(sink->write(sink,buffer,count) == -1) {
+				printf("Error: Unable to write track %d.\n",spans[s].track);
+				result = -1;
+				break;
+			}
+			i += count;
+		}
+		
+		if(sink->end(sink,result) == -1)
+			result = -1;
+	}
 	
-	lsn_t i;
+	return result;
+}
+
+//slot flags marking the first and last batch of a span
+#define RIPPER_SLOT_BEGIN 1
+#define RIPPER_SLOT_END 2
+
+//one filled batch in the pipeline ring
+//a count of 0 tells the writer to stop
+typedef struct ripper_ring_slot_t {
+	long count;
+	int span;
+	int flags;
+} ripper_ring_slot_t;
+
+//bounded single producer single consumer ring of batches.
+//the reader only touches head and the writer only touches
+//tail so the indexes need no locking, the semaphores count
+//free and filled slots and provide the backpressure
+typedef struct ripper_ring_t {
+	int16_t * buffers;
+	ripper_ring_slot_t * slots;
+	unsigned int depth;
+	unsigned int head;
+	unsigned int tail;
+	size_t slot_samples;
+	sem_t free_slots;
+	sem_t full_slots;
+	//set by the writer when the sink fails
+	int failed;
+	const ripper_span_t * spans;
+	ripper_sink_t * sink;
+} ripper_ring_t;
+
+//writer thread for the pipelined rip.
+//drains filled slots to the sink until the reader
+//queues an empty batch. After a failure the remaining
+//batches are still drained so the reader never blocks
+//on a full ring
+static void * ripperRingWriter(void * arg)
+{
+	ripper_ring_t * ring = arg;
+	ripper_sink_t * sink = ring->sink;
+	int failed = 0;
+	int open = 0;
 	
-	// 	read in the track
-	for(i = f_sector;i <= l_sector; i++) {
-		int16_t * p_buffer = cdio_paranoia_read(ripper->p_paranoia,NULL);
-		char * err_msg = cdio_cddap_errors(ripper->drive);
-		char * inf_msg = cdio_cddap_messages(ripper->drive);
+	for(;;) {
+		sem_wait(&ring->full_slots);
+		ripper_ring_slot_t * slot = &ring->slots[ring->tail];
+		if(slot->count == 0)
+			break;
 		
-		if(err_msg) {
-			free(err_msg);
+		if(!failed && (slot->flags & RIPPER_SLOT_BEGIN)) {
+			if(sink->begin(sink,&ring->spans[slot->span]) == -1)
+				failed = 1;
+			else
+				open = 1;
 		}
-		if(inf_msg) {
-			free(inf_msg);
+		if(!failed && sink->write(sink,ring->buffers + ring->tail * ring->slot_samples,slot->count) == -1)
+			failed = 1;
+		if(open && (failed || (slot->flags & RIPPER_SLOT_END))) {
+			if(sink->end(sink,failed ? -1 : 1) == -1)
+				failed = 1;
+			open = 0;
 		}
+		if(failed)
+			__atomic_store_n(&ring->failed,1,__ATOMIC_RELEASE);
+		
+		ring->tail = (ring->tail + 1) % ring->depth;
+		sem_post(&ring->free_slots);
+	}
+	
+	//the reader stopped part way through a span
+	if(open)
+		sink->end(sink,-1);
+	
+	return NULL;
+}
+
+//reads every span on the calling thread into the pipeline
+//ring while a second thread hands the batches to the sink.
+//The drive only waits on the output when every slot in
+//the ring is full
+//returns 1 on success and -1 on error
+static int ripperRipPipelined(ripper_cd_data_t * ripper,const ripper_span_t * spans,int numSpans,ripper_sink_t * sink)
+{
+	ripper_ring_t ring;
+	pthread_t writer;
+	int result = 1;
+	//set while the reader has a free slot it hasn't queued
+	int holding = 0;
+	int s;
+	
+	ring.buffers = ripperGetRingBuffer(ripper);
+	if(ring.buffers == NULL) {
+		return -1;
+	}
+	ring.slots = calloc(sizeof(ripper_ring_slot_t),ripper->pipeline_depth);
+	if(ring.slots == NULL) {
+		printf("Error: Unable to allocate memory for the pipeline.\n");
+		return -1;
+	}
+	
+	ring.depth = ripper->pipeline_depth;
+	ring.head = 0;
+	ring.tail = 0;
+	ring.slot_samples = (size_t)ripper->batch_sectors * CDIO_CD_FRAMESIZE_RAW / sizeof(int16_t);
+	ring.failed = 0;
+	ring.spans = spans;
+	ring.sink = sink;
+	sem_init(&ring.free_slots,0,ring.depth);
+	sem_init(&ring.full_slots,0,0);
+	
+	if(pthread_create(&writer,NULL,ripperRingWriter,&ring) != 0) {
+		printf("Error: Unable to start the writer thread.\n");
+		sem_destroy(&ring.free_slots);
+		sem_destroy(&ring.full_slots);
+		free(ring.slots);
+		return -1;
+	}
+	
+	for(s = 0;s < numSpans && result == 1;s++) {
+		ripper_rip_stats_t * stats = &ripper->track_stats[spans[s].track - 1];
+		lsn_t i = spans[s].start;
 		
-		if(!p_buffer) {
+		if(ripperBurstScan(ripper,&spans[s]) == -1) {
 			printf("A read error occured. Aborting..\n");
-			fclose(fp);
-			return -1;	
-		} else {
-			fwrite(p_buffer,CDIO_CD_FRAMESIZE_RAW,1,fp);
+			result = -1;
+			break;
+		}
+		
+		while(i <= spans[s].last) {
+			long count = spans[s].last - i + 1;
+			if(count > ripper->batch_sectors)
+				count = ripper->batch_sectors;
+			
+			uint64_t waited = ripperNanoTime();
+			sem_wait(&ring.free_slots);
+			holding = 1;
+			stats->wait_ns += ripperNanoTime() - waited;
+			if(ripper->trace != NULL)
+				ripperTraceEvent(ripper->trace,RIPPER_TRACE_WAIT,waited,spans[s].track,i,count);
+			
+			if(ripperRipCancelled(ripper)) {
+				printf("Rip cancelled.\n");
+				result = -1;
+				break;
+			}
+			if(__atomic_load_n(&ring.failed,__ATOMIC_ACQUIRE)) {
+				printf("Error: Unable to write track %d.\n",spans[s].track);
+				result = -1;
+				break;
+			}
+			if(ripperReadBatch(ripper,spans[s].track,i,ring.buffers + ring.head * ring.slot_samples,count) == -1) {
+				printf("A read error occured. Aborting..\n");
+				result = -1;
+				break;
+			}
+			
+			ring.slots[ring.head].count = count;
+			ring.slots[ring.head].span = s;
+			ring.slots[ring.head].flags = 0;
+			if(i == spans[s].start)
+				ring.slots[ring.head].flags |= RIPPER_SLOT_BEGIN;
+			if(i + count > spans[s].last)
+				ring.slots[ring.head].flags |= RIPPER_SLOT_END;
+			ring.head = (ring.head + 1) % ring.depth;
+			holding = 0;
+			sem_post(&ring.full_slots);
+			i += count;
 		}
 	}
 	
-	fclose(fp);
-	//move the starting offset back to the start of the cd
-	cdio_paranoia_seek(ripper->p_paranoia,-l_sector,SEEK_SET);
+	//queue the empty batch that stops the writer.  The loop
+	//can exit with or without a free slot, a burst scan that
+	//fails stops it before one is taken
+	if(!holding)
+		sem_wait(&ring.free_slots);
+	ring.slots[ring.head].count = 0;
+	sem_post(&ring.full_slots);
+	
+	pthread_join(writer,NULL);
+	sem_destroy(&ring.free_slots);
+	sem_destroy(&ring.full_slots);
+	free(ring.slots);
+	
+	if(result == 1 && ring.failed) {
+		printf("Error: Unable to write the output.\n");
+		result = -1;
+	}
+	
+	return result;
+}
 
-	return 1;
+//file sinks can be synced to disk part way through a
+//track, see ripperFileSync below
+typedef struct ripper_file_sink_t ripper_file_sink_t;
+static int ripperFileSync(ripper_file_sink_t * file);
+static off_t ripperFileTell(ripper_file_sink_t * file);
+
+//output of a journaled rip. id names the output in the
+//journal and file is the file sink synced before each
+//checkpoint, NULL when the output can't be resumed part
+//way through a track.  path is the file, or the pattern
+//of the track files when pattern is set
+typedef struct ripper_journal_output_t {
+	uint64_t id;
+	ripper_file_sink_t * file;
+	const char * path;
+	int pattern;
+} ripper_journal_output_t;
+
+//sets filename to the output file of the track
+static void ripperJournalFilename(const ripper_journal_output_t * output,int track,char * filename,size_t size)
+{
+	if(output->pattern)
+		snprintf(filename,size,output->path,track);
+	else
+		snprintf(filename,size,"%s",output->path);
+}
+
+//sink computing the checksums of every track on the way
+//to the sink it wraps.  In a pipelined rip it runs on the
+//writer thread so the drive isn't kept waiting.
+//When output is set the rip is journaled, sector is the
+//next sector of the track to be written and unsynced the
+//number written since the last checkpoint.  Outputs that
+//finish their files later keep the records of completed
+//tracks in pending until the sink has been flushed
+typedef struct ripper_checksum_sink_t {
+	ripper_sink_t * sink;
+	ripper_cd_data_t * ripper;
+	const ripper_journal_output_t * output;
+	ripper_checksum_state_t state;
+	int track;
+	int firstAudioTrack;
+	int lastAudioTrack;
+	lsn_t sector;
+	long unsynced;
+	ripper_journal_record_t * pending;
+	int numPending;
+} ripper_checksum_sink_t;
+
+//fills in a journal record of the track ripped so far,
+//syncing the output first so the record never runs ahead
+//of the disk
+//returns 1 on success and -1 on error
+static int ripperChecksumCheckpoint(ripper_checksum_sink_t * checksum,ripper_journal_record_t * record)
+{
+	memset(record,0,sizeof(*record));
+	record->type = RIPPER_JOURNAL_PROGRESS;
+	record->track = checksum->track;
+	record->next_sector = checksum->sector;
+	record->output = checksum->output->id;
+	record->state = checksum->state;
+	checksum->unsynced = 0;
+	
+	if(checksum->output->file != NULL) {
+		uint64_t start = checksum->ripper->trace != NULL ? ripperNanoTime() : 0;
+		off_t offset;
+		int synced = ripperFileSync(checksum->output->file);
+		if(checksum->ripper->trace != NULL)
+			ripperTraceEvent(checksum->ripper->trace,RIPPER_TRACE_FLUSH,start,checksum->track,checksum->sector,0);
+		if(synced == -1 || (offset = ripperFileTell(checksum->output->file)) == -1)
+			return -1;
+		record->offset = offset;
+	}
+	
+	return 1;
+}
+
+static int ripperChecksumSinkBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	ripper_checksum_sink_t * checksum = sink->data;
+	
+	checksum->track = span->track;
+	checksum->sector = span->start;
+	checksum->unsynced = 0;
+	checksum->ripper->checksums[span->track - 1].valid = 0;
+	
+	//a resumed track carries on from the checksums of the
+	//sectors ripped before
+	if(span->start != span->first) {
+		const ripper_journal_record_t * record = NULL;
+		if(checksum->output != NULL)
+			record = ripperJournalFind(checksum->ripper->journal,span->track,checksum->output->id);
+		if(record == NULL || record->next_sector != span->start)
+			return -1;
+		checksum->state = record->state;
+	} else {
+		ripperChecksumInit(&checksum->state,span->last - span->first + 1,
+			span->track == checksum->firstAudioTrack,span->track == checksum->lastAudioTrack);
+	}
+	
+	uint64_t start = ripperNanoTime();
+	int result = checksum->sink->begin(checksum->sink,span);
+	checksum->ripper->track_stats[span->track - 1].write_ns += ripperNanoTime() - start;
+	
+	return result;
+}
+
+static int ripperChecksumSinkWrite(ripper_sink_t * sink,const int16_t * buffer,long count)
+{
+	ripper_checksum_sink_t * checksum = sink->data;
+	ripper_rip_stats_t * stats = &checksum->ripper->track_stats[checksum->track - 1];
+	uint64_t start = ripperNanoTime();
+	int result = checksum->sink->write(checksum->sink,buffer,count);
+	
+	stats->write_ns += ripperNanoTime() - start;
+	if(checksum->ripper->trace != NULL)
+		ripperTraceEvent(checksum->ripper->trace,RIPPER_TRACE_WRITE,start,checksum->track,checksum->sector,count);
+	//the sums only cover sectors the sink took so a
+	//journal record never counts sectors that are missing
+	if(result == -1)
+		return -1;
+	stats->bytes_written += (uint64_t)CDIO_CD_FRAMESIZE_RAW * count;
+	ripperChecksumUpdate(&checksum->state,buffer,count);
+	__atomic_add_fetch(&checksum->ripper->progress_done,count,__ATOMIC_RELAXED);
+	
+	checksum->sector += count;
+	checksum->unsynced += count;
+	if(checksum->output != NULL && checksum->output->file != NULL && checksum->unsynced >= RIPPER_JOURNAL_INTERVAL) {
+		ripper_journal_record_t record;
+		if(ripperChecksumCheckpoint(checksum,&record) == -1 || ripperJournalAppend(checksum->ripper->journal,&record) == -1)
+			printf("Warning: Unable to update the rip journal.\n");
+	}
+	
+	return 1;
+}
+
+static int ripperChecksumSinkEnd(ripper_sink_t * sink,int status)
+{
+	ripper_checksum_sink_t * checksum = sink->data;
+	ripper_journal_record_t record;
+	int checkpoint = -1;
+	
+	//the checkpoint is taken before the sink closes its
+	//file, a failed rip keeps what was written so far
+	if(checksum->output != NULL)
+		checkpoint = ripperChecksumCheckpoint(checksum,&record);
+	
+	uint64_t start = ripperNanoTime();
+	status = checksum->sink->end(checksum->sink,status);
+	checksum->ripper->track_stats[checksum->track - 1].write_ns += ripperNanoTime() - start;
+	if(status == 1)
+		ripperChecksumFinish(&checksum->state,&checksum->ripper->checksums[checksum->track - 1]);
+	
+	if(checkpoint == 1 && checksum->output->file == NULL) {
+		if(status == 1) {
+			record.type = RIPPER_JOURNAL_COMPLETE;
+			checksum->pending[checksum->numPending++] = record;
+		}
+	} else if(checkpoint == 1) {
+		if(status == 1)
+			record.type = RIPPER_JOURNAL_COMPLETE;
+		if(ripperJournalAppend(checksum->ripper->journal,&record) == -1)
+			printf("Warning: Unable to update the rip journal.\n");
+	}
+	
+	return status;
+}
+
+//sets the statistics of the rip to the sum of the tracks
+//of its spans
+static void ripperSumStats(ripper_cd_data_t * ripper,const ripper_span_t * spans,int numSpans)
+{
+	ripper_rip_stats_t * total = &ripper->rip_stats;
+	int s,e;
+	
+	memset(total,0,sizeof(*total));
+	for(s = 0;s < numSpans;s++) {
+		const ripper_rip_stats_t * stats = &ripper->track_stats[spans[s].track - 1];
+		
+		total->sectors_read += stats->sectors_read;
+		total->reads += stats->reads;
+		total->rereads += stats->rereads;
+		for(e = 0;e < RIPPER_STATS_EVENTS;e++)
+			total->events[e] += stats->events[e];
+		total->bytes_written += stats->bytes_written;
+		total->read_ns += stats->read_ns;
+		total->write_ns += stats->write_ns;
+		total->wait_ns += stats->wait_ns;
+	}
+}
+
+//rips every span into the sink using the pipelined
+//rip when a pipeline depth is set.  The checksums of
+//every span are computed on the way and the rip is
+//journaled to output when it isn't NULL
+//returns 1 on success and -1 on error
+static int ripperRipSpans(ripper_cd_data_t * ripper,const ripper_span_t * spans,int numSpans,ripper_sink_t * sink,const ripper_journal_output_t * output)
+{
+	int result;
+	int trackNum;
+	ripper_checksum_sink_t checksum = { sink, ripper, output };
+	ripper_sink_t checksumSink = { ripperChecksumSinkBegin, ripperChecksumSinkWrite, ripperChecksumSinkEnd, &checksum };
+	
+	//the drive and paranoia wait for the first rip
+	if(ripperOpenDrive(ripper) == -1)
+		return -1;
+	
+	if(output != NULL && output->file == NULL && numSpans > 0) {
+		checksum.pending = malloc(sizeof(ripper_journal_record_t) * numSpans);
+		if(checksum.pending == NULL) {
+			printf("Error: Unable to allocate memory for the rip journal.\n");
+			return -1;
+		}
+	}
+	
+	//the first and last audio tracks get the AccurateRip
+	//exclusions
+	checksum.firstAudioTrack = 0;
+	checksum.lastAudioTrack = 0;
+	for(trackNum = 1;trackNum <= ripper->totalTracks;trackNum++) {
+		if(ripper->toc[trackNum - 1].audio) {
+			if(checksum.firstAudioTrack == 0)
+				checksum.firstAudioTrack = trackNum;
+			checksum.lastAudioTrack = trackNum;
+		}
+	}
+	
+	long total = 0;
+	int s;
+	for(s = 0;s < numSpans;s++) {
+		total += spans[s].last - spans[s].start + 1;
+		memset(&ripper->track_stats[spans[s].track - 1],0,sizeof(ripper_rip_stats_t));
+	}
+	__atomic_store_n(&ripper->progress_done,0,__ATOMIC_RELAXED);
+	__atomic_store_n(&ripper->progress_total,total,__ATOMIC_RELAXED);
+	
+	uint64_t start = ripperNanoTime();
+	
+	//each rip starts at the speed the last one ended on
+	if(ripper->speed_control.max_speed > 0) {
+		ripperSpeedReset(&ripper->speed_control);
+		ripperApplySpeed(ripper);
+	}
+	
+	if(ripper->pipeline_depth > 0)
+		result = ripperRipPipelined(ripper,spans,numSpans,&checksumSink);
+	else
+		result = ripperRipSerial(ripper,spans,numSpans,&checksumSink);
+	
+	//wait for sinks finishing their output on other threads
+	uint64_t flushed = ripperNanoTime();
+	if(sink->flush != NULL && sink->flush(sink) == -1)
+		result = -1;
+	if(ripper->trace != NULL && sink->flush != NULL)
+		ripperTraceEvent(ripper->trace,RIPPER_TRACE_FLUSH,flushed,0,0,0);
+	flushed = ripperNanoTime() - flushed;
+	
+	//a sink removes the files it failed to finish so the
+	//next rip won't find the tracks recorded here.  The
+	//files are finished now, the records name the file by
+	//its identity as its pcm can't be checked
+	for(s = 0;s < checksum.numPending;s++) {
+		ripper_journal_record_t * record = &checksum.pending[s];
+		char filename[FILENAME_MAX];
+		struct stat st;
+		
+		ripperJournalFilename(output,record->track,filename,sizeof(filename));
+		if(stat(filename,&st) == -1)
+			continue;
+		record->inode = st.st_ino;
+		record->size = st.st_size;
+		record->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+		if(ripperJournalAppend(ripper->journal,record) == -1)
+			printf("Warning: Unable to update the rip journal.\n");
+	}
+	free(checksum.pending);
+	
+	ripperSumStats(ripper,spans,numSpans);
+	ripper->rip_stats.write_ns += flushed;
+	ripper->rip_stats.elapsed_ns = ripperNanoTime() - start;
+	
+	//the cancel request only applies to one rip
+	__atomic_store_n(&ripper->cancel,0,__ATOMIC_RELEASE);
+	ripper->burst_count = 0;
+	
+	return result;
+}
+
+//fills in the span for the inputed track
+//returns 1 on success and -1 if the track can't be ripped
+static int ripperGetTrackSpan(ripper_cd_data_t * ripper,int trackNum,ripper_span_t * span)
+{
+	if(trackNum < 1 || trackNum > (int)ripper->totalTracks) {
+		printf("Error: Invalid track number specified.\n");
+		return -1;
+	}
+	//make sure that the track is an audio track
+	if(!ripper->toc[trackNum - 1].audio) {
+		printf("Error: Track %d is not an audio track.\n",trackNum);
+		return -1;
+	}
+	
+	//attempt to get the first and last sectors of the track
+	span->track = trackNum;
+	span->first = ripper->toc[trackNum - 1].first;
+	span->last = ripper->toc[trackNum - 1].last;
+	span->start = span->first;
+	
+	//make sure we are able to get the first and last sectors
+	//of the track to be ripped.
+	if(span->first == -1 || span->last == -1) {
+		printf("Error: Unable to get track information.\n");
+		return -1;
+	}
+	
+	return 1;
+}
+
+//sink writing each span to its own wav file, or to a
+//headerless raw file when raw is set.
+//path is either a filename or, when pattern is set, a
+//printf style pattern taking the track number.
+//fp is used by RIPPER_OUTPUT_STDIO, the other modes write
+//to fd at offset through map or the staging buffer.
+//active is the mode the open file is written in, a file
+//kept from an earlier rip is never written with O_DIRECT.
+//layout is set for a bin image and holds every span in the
+//order they are laid out in the image
+struct ripper_file_sink_t {
+	const char * path;
+	int pattern;
+	FILE * fp;
+	RIPPER_OUTPUT_MODE mode;
+	int fd;
+	int raw;
+	size_t size;
+	size_t offset;
+	unsigned char * map;
+	unsigned char * staging;
+	size_t staged;
+	RIPPER_OUTPUT_MODE active;
+	const ripper_span_t * layout;
+	int numLayout;
+};
+
+//opens filename for a file of exactly size bytes. keep
+//opens the file left by an earlier rip without truncating
+//it so a resumed rip can write the rest
+//returns 1 on success and -1 on error
+static int ripperFileOpen(ripper_file_sink_t * file,const char * filename,size_t size,int keep)
+{
+	file->size = size;
+	file->offset = 0;
+	file->staged = 0;
+	file->active = file->mode;
+	if(keep && file->mode == RIPPER_OUTPUT_DIRECT)
+		file->active = RIPPER_OUTPUT_STDIO;
+	
+	if(file->active == RIPPER_OUTPUT_STDIO) {
+		file->fp = keep ? fopen(filename,"r+") : NULL;
+		if(file->fp == NULL)
+			file->fp = fopen(filename,"w");
+		if(file->fp == NULL) {
+			printf("Error: Unable to open file %s for writing.\n",filename);
+			return -1;
+		}
+		return 1;
+	}
+	
+	int flags = O_RDWR | O_CREAT | O_CLOEXEC | (keep ? 0 : O_TRUNC);
+	file->fd = -1;
+	if(file->active == RIPPER_OUTPUT_DIRECT) {
+		file->fd = open(filename,flags | O_DIRECT,0644);
+		//tmpfs and some network filesystems refuse O_DIRECT,
+		//the aligned writes still work without it
+		if(file->fd == -1 && errno == EINVAL)
+			file->fd = open(filename,flags,0644);
+	} else {
+		file->fd = open(filename,flags,0644);
+	}
+	if(file->fd == -1) {
+		printf("Error: Unable to open file %s for writing.\n",filename);
+		return -1;
+	}
+	
+	//reserve the whole file in one extent up front
+	int sparse = 0;
+	int error = posix_fallocate(file->fd,0,size);
+	if(error == EOPNOTSUPP || error == EINVAL) {
+		sparse = 1;
+		error = ftruncate(file->fd,size) == -1 ? errno : 0;
+	}
+	if(error != 0) {
+		printf("Error: Unable to allocate %lu bytes for %s.\n",(unsigned long)size,filename);
+		close(file->fd);
+		file->fd = -1;
+		return -1;
+	}
+	
+	//a sparse file has no blocks reserved, a store into its
+	//mapping on a full filesystem raises SIGBUS, so the
+	//file is written through a FILE instead
+	if(sparse && file->active == RIPPER_OUTPUT_MMAP) {
+		file->fp = fdopen(file->fd,"r+");
+		if(file->fp == NULL) {
+			printf("Error: Unable to open file %s for writing.\n",filename);
+			close(file->fd);
+			file->fd = -1;
+			return -1;
+		}
+		file->fd = -1;
+		file->active = RIPPER_OUTPUT_STDIO;
+		return 1;
+	}
+	
+	if(file->active == RIPPER_OUTPUT_MMAP) {
+		file->map = mmap(NULL,size,PROT_READ | PROT_WRITE,MAP_SHARED,file->fd,0);
+		if(file->map == MAP_FAILED) {
+			printf("Error: Unable to map file %s.\n",filename);
+			file->map = NULL;
+			close(file->fd);
+			file->fd = -1;
+			return -1;
+		}
+		madvise(file->map,size,MADV_SEQUENTIAL);
+	} else if(file->staging == NULL) {
+		void * buffer = NULL;
+		if(posix_memalign(&buffer,RIPPER_BUFFER_ALIGNMENT,RIPPER_DIRECT_WRITE_BYTES) != 0) {
+			printf("Error: Unable to allocate memory for the write buffer.\n");
+			close(file->fd);
+			file->fd = -1;
+			return -1;
+		}
+		file->staging = buffer;
+	}
+	
+	return 1;
+}
+
+//writes the staged bytes at the current offset, length is
+//rounded up to whole blocks as O_DIRECT needs.  Unless
+//consume is set the bytes stay staged and are written
+//again in full once more is staged after them
+//returns 1 on success and -1 on error
+static int ripperFileWriteStaged(ripper_file_sink_t * file,int consume)
+{
+	size_t length = (file->staged + RIPPER_BUFFER_ALIGNMENT - 1) & ~(RIPPER_BUFFER_ALIGNMENT - 1);
+	size_t done = 0;
+	
+	memset(file->staging + file->staged,0,length - file->staged);
+	while(done < length) {
+		ssize_t written = pwrite(file->fd,file->staging + done,length - done,file->offset + done);
+		if(written == -1 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			return -1;
+		done += written;
+	}
+	if(consume) {
+		file->offset += file->staged;
+		file->staged = 0;
+	}
+	
+	return 1;
+}
+
+//appends length bytes to the file
+//returns 1 on success and -1 on error
+static int ripperFilePut(ripper_file_sink_t * file,const void * data,size_t length)
+{
+	const unsigned char * bytes = data;
+	
+	switch(file->active) {
+		case RIPPER_OUTPUT_MMAP:
+			if(file->offset + length > file->size)
+				return -1;
+			memcpy(file->map + file->offset,bytes,length);
+			file->offset += length;
+			return 1;
+		case RIPPER_OUTPUT_DIRECT:
+			while(length > 0) {
+				size_t count = RIPPER_DIRECT_WRITE_BYTES - file->staged;
+				if(count > length)
+					count = length;
+				memcpy(file->staging + file->staged,bytes,count);
+				file->staged += count;
+				bytes += count;
+				length -= count;
+				if(file->staged == RIPPER_DIRECT_WRITE_BYTES && ripperFileWriteStaged(file,1) == -1)
+					return -1;
+			}
+			return 1;
+		default:
+			return fwrite(bytes,1,length,file->fp) == length ? 1 : -1;
+	}
+}
+
+//finishes the file, the partial block written last in
+//RIPPER_OUTPUT_DIRECT is cut back to the real size
+//returns 1 on success and -1 on error
+static int ripperFileClose(ripper_file_sink_t * file)
+{
+	int result = 1;
+	
+	if(file->active == RIPPER_OUTPUT_STDIO) {
+		if(file->fp != NULL && fclose(file->fp) != 0)
+			result = -1;
+		file->fp = NULL;
+		return result;
+	}
+	if(file->fd == -1) {
+		return result;
+	}
+	
+	if(file->active == RIPPER_OUTPUT_MMAP) {
+		if(munmap(file->map,file->size) != 0)
+			result = -1;
+		file->map = NULL;
+	} else {
+		if(file->staged > 0 && ripperFileWriteStaged(file,1) == -1)
+			result = -1;
+		if(ftruncate(file->fd,file->size) == -1)
+			result = -1;
+	}
+	if(close(file->fd) != 0)
+		result = -1;
+	file->fd = -1;
+	
+	return result;
+}
+
+//moves the write position of the file to offset, in
+//RIPPER_OUTPUT_DIRECT only to the end of what was written
+//returns 1 on success and -1 on error
+static int ripperFileSeek(ripper_file_sink_t * file,off_t offset)
+{
+	switch(file->active) {
+		case RIPPER_OUTPUT_MMAP:
+			if(offset < 0 || (size_t)offset > file->size)
+				return -1;
+			file->offset = offset;
+			return 1;
+		case RIPPER_OUTPUT_DIRECT:
+			return (size_t)offset == file->offset + file->staged ? 1 : -1;
+		default:
+			return fseeko(file->fp,offset,SEEK_SET) == 0 ? 1 : -1;
+	}
+}
+
+//returns the offset the next write goes to or -1 on error
+static off_t ripperFileTell(ripper_file_sink_t * file)
+{
+	switch(file->active) {
+		case RIPPER_OUTPUT_MMAP:
+			return file->offset;
+		case RIPPER_OUTPUT_DIRECT:
+			return file->offset + file->staged;
+		default:
+			return ftello(file->fp);
+	}
+}
+
+//makes sure every byte written so far is on the disk
+//returns 1 on success and -1 on error
+static int ripperFileSync(ripper_file_sink_t * file)
+{
+	switch(file->active) {
+		case RIPPER_OUTPUT_MMAP:
+			return msync(file->map,file->size,MS_SYNC) == 0 ? 1 : -1;
+		case RIPPER_OUTPUT_DIRECT:
+			if(file->staged > 0 && ripperFileWriteStaged(file,0) == -1)
+				return -1;
+			return fdatasync(file->fd) == 0 ? 1 : -1;
+		default:
+			if(fflush(file->fp) != 0)
+				return -1;
+			return fdatasync(fileno(file->fp)) == 0 ? 1 : -1;
+	}
+}
+
+//writes the wav header of a file holding data_size bytes
+//of audio
+//returns 1 on success and -1 on error
+static int ripperFilePutWavHeader(ripper_file_sink_t * file,int data_size)
+{
+	if(file->active == RIPPER_OUTPUT_STDIO)
+		return ripperWriteWavHeader(file->fp,data_size);
+	
+	//the other modes copy the header from memory
+	unsigned char header[WAV_HEADER_SIZE + 8];
+	if(ripperGetWavHeader(header,data_size) == -1)
+		return -1;
+	
+	return ripperFilePut(file,header,sizeof(header));
+}
+
+static int ripperFileSinkBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	ripper_file_sink_t * file = sink->data;
+	char filename[FILENAME_MAX];
+	int data_size = CDIO_CD_FRAMESIZE_RAW * (span->last - span->first + 1);
+	
+	if(file->pattern)
+		snprintf(filename,sizeof(filename),file->path,span->track);
+	else
+		snprintf(filename,sizeof(filename),"%s",file->path);
+	
+	int header_size = file->raw ? 0 : WAV_HEADER_SIZE + 8;
+	int keep = span->start != span->first;
+	if(ripperFileOpen(file,filename,data_size + header_size,keep) == -1) {
+		return -1;
+	}
+	
+	//a resumed track carries on after the sectors already
+	//in the file
+	if(keep) {
+		if(ripperFileSeek(file,header_size + (off_t)CDIO_CD_FRAMESIZE_RAW * (span->start - span->first)) == -1) {
+			printf("Error: Unable to resume file %s.\n",filename);
+			ripperFileClose(file);
+			return -1;
+		}
+	} else if(!file->raw && ripperFilePutWavHeader(file,data_size) == -1) {
+		printf("Error: Unable to write to file %s.\n",filename);
+		ripperFileClose(file);
+		return -1;
+	}
+	
+	return 1;
+}
+
+static int ripperFileSinkWrite(ripper_sink_t * sink,const int16_t * buffer,long count)
+{
+	ripper_file_sink_t * file = sink->data;
+	
+	return ripperFilePut(file,buffer,(size_t)CDIO_CD_FRAMESIZE_RAW * count);
+}
+
+static int ripperFileSinkEnd(ripper_sink_t * sink,int status)
+{
+	ripper_file_sink_t * file = sink->data;
+	
+	if(ripperFileClose(file) == -1)
+		status = -1;
+	
+	return status;
+}
+
+//kinds of journaled output, combined with the format
+#define RIPPER_JOURNAL_PATTERN 0x100
+#define RIPPER_JOURNAL_BIN 0x200
+
+//checks the output file still holds what record says was
+//written to it.  The pcm of the track before next_sector
+//ends at offset and must have the crc32 in the record, so
+//a file rewritten or replaced since, or preallocated and
+//never filled, isn't taken for the rip.  A flac file must
+//still be the file that was finished
+//returns 1 when the record holds and -1 otherwise
+static int ripperJournalVerify(const ripper_journal_record_t * record,const ripper_span_t * span,const ripper_journal_output_t * output)
+{
+	char filename[FILENAME_MAX];
+	struct stat st;
+	
+	ripperJournalFilename(output,span->track,filename,sizeof(filename));
+	if(stat(filename,&st) == -1)
+		return -1;
+	if(output->file == NULL) {
+		return record->inode == (uint64_t)st.st_ino && record->size == (uint64_t)st.st_size
+			&& record->mtime_ns == (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec ? 1 : -1;
+	}
+	
+	if(record->next_sector < span->first)
+		return -1;
+	uint64_t length = (uint64_t)CDIO_CD_FRAMESIZE_RAW * (record->next_sector - span->first);
+	if(record->offset < length || (uint64_t)st.st_size < record->offset)
+		return -1;
+	
+	int fd = open(filename,O_RDONLY | O_CLOEXEC);
+	if(fd == -1)
+		return -1;
+	unsigned char * buffer = malloc(RIPPER_DIRECT_WRITE_BYTES);
+	if(buffer == NULL) {
+		close(fd);
+		return -1;
+	}
+	
+	off_t position = record->offset - length;
+	uint32_t crc = 0;
+	while(length > 0) {
+		size_t count = length < RIPPER_DIRECT_WRITE_BYTES ? length : RIPPER_DIRECT_WRITE_BYTES;
+		ssize_t got = pread(fd,buffer,count,position);
+		if(got == -1 && errno == EINTR)
+			continue;
+		if(got <= 0)
+			break;
+		crc = ripperCRC32Update(crc,buffer,got);
+		position += got;
+		length -= got;
+	}
+	free(buffer);
+	close(fd);
+	
+	return length == 0 && crc == record->state.crc32 ? 1 : -1;
+}
+
+//checks the spans against the journal before a rip to the
+//output. Tracks recorded as complete are dropped from
+//spans and get their checksums from the journal, tracks
+//ripped part way start at the first sector missing when
+//the output can be resumed.  A record only counts while
+//the file still holds what it was written with, see
+//ripperJournalVerify.  numSpans is set to the spans left
+//to rip
+//returns the number of tracks with output kept from an
+//earlier rip
+static int ripperJournalPlan(ripper_cd_data_t * ripper,ripper_span_t * spans,int * numSpans,const ripper_journal_output_t * output)
+{
+	int kept = 0;
+	int count = 0;
+	int s;
+	
+	for(s = 0;s < *numSpans;s++) {
+		ripper_span_t span = spans[s];
+		const ripper_journal_record_t * record = ripperJournalFind(ripper->journal,span.track,output->id);
+		
+		if(record != NULL && ripperJournalVerify(record,&span,output) == 1) {
+			if(record->type == RIPPER_JOURNAL_COMPLETE && record->next_sector == span.last + 1) {
+				ripperChecksumFinish(&record->state,&ripper->checksums[span.track - 1]);
+				kept++;
+				continue;
+			}
+			if(record->type == RIPPER_JOURNAL_PROGRESS && output->file != NULL
+				&& record->next_sector > span.first && record->next_sector <= span.last) {
+				span.start = record->next_sector;
+				kept++;
+			}
+		}
+		spans[count++] = span;
+	}
+	*numSpans = count;
+	
+	return kept;
+}
+
+//rips the spans to the track files written by sink, file
+//is the file sink behind it or NULL for flac. When the
+//ripper has a journal the rip is journaled and picks up
+//where the last rip to path stopped
+//returns 1 on success and -1 on error
+static int ripperRipTrackFiles(ripper_cd_data_t * ripper,ripper_span_t * spans,int numSpans,ripper_sink_t * sink,ripper_file_sink_t * file,const char * path,int pattern)
+{
+	if(ripper->journal == NULL) {
+		return ripperRipSpans(ripper,spans,numSpans,sink,NULL);
+	}
+	
+	ripper_journal_output_t output;
+	output.id = ripperJournalOutputId(path,ripper->format | (pattern ? RIPPER_JOURNAL_PATTERN : 0));
+	output.file = file;
+	output.path = path;
+	output.pattern = pattern;
+	ripperJournalPlan(ripper,spans,&numSpans,&output);
+	
+	return ripperRipSpans(ripper,spans,numSpans,sink,&output);
+}
+
+int ripperRipTrackSink(ripper_cd_data_t * ripper,int trackNum,ripper_sink_t * sink)
+{
+	if(ripper == NULL || sink == NULL) {
+		return -1;
+	}
+	
+	ripper_span_t span;
+	if(ripperGetTrackSpan(ripper,trackNum,&span) == -1) {
+		return -1;
+	}
+	
+	return ripperRipSpans(ripper,&span,1,sink,NULL);
+}
+
+int ripperRipTrack(ripper_cd_data_t * ripper,int trackNum, char * filename)
+{
+	if(ripper == NULL) {
+		return -1;
+	}
+	if(filename == NULL) {
+		printf("Error: No filename was specified.\n");
+		return -1;
+	}
+	
+	ripper_span_t span;
+	if(ripperGetTrackSpan(ripper,trackNum,&span) == -1) {
+		return -1;
+	}
+	
+	if(ripper->format == FLAC_AUDIO) {
+		ripper_sink_t * sink = ripperFLACSinkInit(filename,0,RIPPER_DEFAULT_FLAC_COMPRESSION,0);
+		if(sink == NULL)
+			return -1;
+		int result = ripperRipTrackFiles(ripper,&span,1,sink,NULL,filename,0);
+		ripperSinkDestroy(sink);
+		return result;
+	}
+	
+	ripper_file_sink_t file = { filename, 0, NULL, ripper->output_mode, -1, ripper->format == RAW_CD_DATA };
+	ripper_sink_t sink = { ripperFileSinkBegin, ripperFileSinkWrite, ripperFileSinkEnd, &file };
+	
+	int result = ripperRipTrackFiles(ripper,&span,1,&sink,&file,filename,0);
+	free(file.staging);
+	
+	return result;
+}
+
+//sink returned by ripperWavSinkInit and ripperRawSinkInit
+typedef struct ripper_wav_sink_t {
+	ripper_sink_t sink;
+	ripper_file_sink_t file;
+} ripper_wav_sink_t;
+
+static void ripperWavSinkDestroy(ripper_sink_t * sink)
+{
+	ripper_wav_sink_t * wav = (ripper_wav_sink_t *)sink;
+	
+	ripperFileClose(&wav->file);
+	free(wav->file.staging);
+	free((char *)wav->file.path);
+	free(wav);
+}
+
+static ripper_sink_t * ripperFileSinkInit(const char * filename,int pattern,RIPPER_OUTPUT_MODE mode,int raw)
+{
+	if(filename == NULL) {
+		printf("Error: No filename was specified.\n");
+		return NULL;
+	}
+	
+	ripper_wav_sink_t * wav = calloc(1,sizeof(ripper_wav_sink_t));
+	if(wav == NULL || (wav->file.path = strdup(filename)) == NULL) {
+		printf("Error: Unable to allocate memory for the file sink.\n");
+		free(wav);
+		return NULL;
+	}
+	wav->file.pattern = pattern;
+	wav->file.mode = mode;
+	wav->file.fd = -1;
+	wav->file.raw = raw;
+	wav->sink.begin = ripperFileSinkBegin;
+	wav->sink.write = ripperFileSinkWrite;
+	wav->sink.end = ripperFileSinkEnd;
+	wav->sink.data = &wav->file;
+	wav->sink.destroy = ripperWavSinkDestroy;
+	
+	return &wav->sink;
+}
+
+ripper_sink_t * ripperWavSinkInit(const char * filename,int pattern,RIPPER_OUTPUT_MODE mode)
+{
+	return ripperFileSinkInit(filename,pattern,mode,0);
+}
+
+ripper_sink_t * ripperRawSinkInit(const char * filename,int pattern,RIPPER_OUTPUT_MODE mode)
+{
+	return ripperFileSinkInit(filename,pattern,mode,1);
+}
+
+//sink writing every span to a file descriptor the caller
+//opened
+typedef struct ripper_fd_sink_t {
+	ripper_sink_t sink;
+	int fd;
+	int raw;
+	int socket;
+} ripper_fd_sink_t;
+
+//writes all of length bytes to the sink's descriptor.
+//SIGPIPE is blocked on this thread while writing so a pipe
+//whose reader went away fails the rip with EPIPE instead of
+//killing the process, a SIGPIPE raised here is taken off
+//the thread before it is unblocked
+//returns 1 on success and -1 on error
+static int ripperFdWrite(ripper_fd_sink_t * out,const void * data,size_t length)
+{
+	const unsigned char * bytes = data;
+	sigset_t pipe_signal,saved,pending;
+	int pipe_pending = 0;
+	int result = 1;
+	int error = 0;
+	
+	if(!out->socket) {
+		sigemptyset(&pipe_signal);
+		sigaddset(&pipe_signal,SIGPIPE);
+		//a SIGPIPE already pending isn't ours to take
+		if(sigpending(&pending) == 0)
+			pipe_pending = sigismember(&pending,SIGPIPE);
+		pthread_sigmask(SIG_BLOCK,&pipe_signal,&saved);
+	}
+	
+	while(length > 0) {
+		ssize_t written;
+		if(out->socket)
+			written = send(out->fd,bytes,length,MSG_NOSIGNAL);
+		else
+			written = write(out->fd,bytes,length);
+		if(written == -1 && errno == EINTR)
+			continue;
+		if(written <= 0) {
+			error = written == -1 ? errno : 0;
+			result = -1;
+			break;
+		}
+		bytes += written;
+		length -= written;
+	}
+	
+	if(!out->socket) {
+		if(error == EPIPE && !pipe_pending) {
+			struct timespec now = { 0, 0 };
+			while(sigtimedwait(&pipe_signal,NULL,&now) == -1 && errno == EINTR)
+				;
+		}
+		pthread_sigmask(SIG_SETMASK,&saved,NULL);
+	}
+	
+	return result;
+}
+
+static int ripperFdSinkBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	ripper_fd_sink_t * out = sink->data;
+	unsigned char header[WAV_HEADER_SIZE + 8];
+	
+	if(out->raw)
+		return 1;
+	if(ripperGetWavHeader(header,CDIO_CD_FRAMESIZE_RAW * (span->last - span->first + 1)) == -1)
+		return -1;
+	
+	return ripperFdWrite(out,header,sizeof(header));
+}
+
+static int ripperFdSinkWrite(ripper_sink_t * sink,const int16_t * buffer,long count)
+{
+	ripper_fd_sink_t * out = sink->data;
+	
+	return ripperFdWrite(out,buffer,(size_t)CDIO_CD_FRAMESIZE_RAW * count);
+}
+
+static int ripperFdSinkEnd(ripper_sink_t * sink,int status)
+{
+	return status;
+}
+
+static void ripperFdSinkDestroy(ripper_sink_t * sink)
+{
+	free(sink);
+}
+
+ripper_sink_t * ripperFdSinkInit(int fd,int raw)
+{
+	struct stat info;
+	
+	if(fstat(fd,&info) == -1) {
+		printf("Error: Invalid file descriptor %d.\n",fd);
+		return NULL;
+	}
+	
+	ripper_fd_sink_t * out = calloc(1,sizeof(ripper_fd_sink_t));
+	if(out == NULL) {
+		printf("Error: Unable to allocate memory for the fd sink.\n");
+		return NULL;
+	}
+	out->fd = fd;
+	out->raw = raw;
+	out->socket = S_ISSOCK(info.st_mode);
+	out->sink.begin = ripperFdSinkBegin;
+	out->sink.write = ripperFdSinkWrite;
+	out->sink.end = ripperFdSinkEnd;
+	out->sink.data = out;
+	out->sink.destroy = ripperFdSinkDestroy;
+	
+	return &out->sink;
+}
+
+int ripperRipTrackFd(ripper_cd_data_t * ripper,int trackNum,int fd)
+{
+	if(ripper == NULL) {
+		return -1;
+	}
+	//the flac encoder needs to seek back to finish its
+	//header, which pipes and sockets can't
+	if(ripper->format == FLAC_AUDIO) {
+		printf("Error: FLAC_AUDIO can't be written to a file descriptor.\n");
+		return -1;
+	}
+	
+	ripper_sink_t * sink = ripperFdSinkInit(fd,ripper->format == RAW_CD_DATA);
+	if(sink == NULL) {
+		return -1;
+	}
+	
+	int result = ripperRipTrackSink(ripper,trackNum,sink);
+	ripperSinkDestroy(sink);
+	
+	return result;
+}
+
+ripper_sink_t * ripperSinkDestroy(ripper_sink_t * sink)
+{
+	if(sink != NULL && sink->destroy != NULL)
+		sink->destroy(sink);
+	
+	return NULL;
+}
+
+//sink handing every batch to a ripper_stream_callback_t
+typedef struct ripper_callback_sink_t {
+	ripper_stream_callback_t callback;
+	void * arg;
+	int track;
+} ripper_callback_sink_t;
+
+static int ripperCallbackSinkBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	ripper_callback_sink_t * callback = sink->data;
+	
+	callback->track = span->track;
+	
+	return 1;
+}
+
+static int ripperCallbackSinkWrite(ripper_sink_t * sink,const int16_t * buffer,long count)
+{
+	ripper_callback_sink_t * callback = sink->data;
+	
+	return callback->callback(buffer,count,callback->track,callback->arg) == -1 ? -1 : 1;
+}
+
+static int ripperCallbackSinkEnd(ripper_sink_t * sink,int status)
+{
+	return status;
+}
+
+int ripperRipTrackStream(ripper_cd_data_t * ripper,int trackNum,ripper_stream_callback_t callback,void * arg)
+{
+	if(callback == NULL) {
+		return -1;
+	}
+	
+	ripper_callback_sink_t data = { callback, arg };
+	ripper_sink_t sink = { ripperCallbackSinkBegin, ripperCallbackSinkWrite, ripperCallbackSinkEnd, &data };
+	
+	if(trackNum == 0)
+		return ripperRipDiscSink(ripper,&sink);
+	else
+		return ripperRipTrackSink(ripper,trackNum,&sink);
+}
+
+//the stream's rip thread passes each batch to
+//ripperStreamNext and waits until the caller asks for the
+//next one before the buffer is read into again
+static int ripperStreamHandOff(const int16_t * pcm,long sectors,int trackNum,void * arg)
+{
+	ripper_stream_t * stream = arg;
+	
+	pthread_mutex_lock(&stream->lock);
+	stream->pcm = pcm;
+	stream->sectors = sectors;
+	stream->track = trackNum;
+	stream->ready = 1;
+	pthread_cond_broadcast(&stream->changed);
+	while(stream->ready && !stream->closing)
+		pthread_cond_wait(&stream->changed,&stream->lock);
+	int closing = stream->closing;
+	pthread_mutex_unlock(&stream->lock);
+	
+	return closing ? -1 : 1;
+}
+
+static void * ripperStreamRun(void * arg)
+{
+	ripper_stream_t * stream = arg;
+	
+	int result = ripperRipTrackStream(stream->ripper,stream->trackNum,ripperStreamHandOff,stream);
+	
+	pthread_mutex_lock(&stream->lock);
+	stream->result = result;
+	stream->done = 1;
+	pthread_cond_broadcast(&stream->changed);
+	pthread_mutex_unlock(&stream->lock);
+	
+	return NULL;
+}
+
+ripper_stream_t * ripperStreamOpen(ripper_cd_data_t * ripper,int trackNum)
+{
+	if(ripper == NULL) {
+		return NULL;
+	}
+	
+	ripper_stream_t * stream = calloc(1,sizeof(ripper_stream_t));
+	if(stream == NULL) {
+		printf("Error: Unable to allocate memory for the stream.\n");
+		return NULL;
+	}
+	stream->ripper = ripper;
+	stream->trackNum = trackNum;
+	pthread_mutex_init(&stream->lock,NULL);
+	pthread_cond_init(&stream->changed,NULL);
+	
+	if(pthread_create(&stream->thread,NULL,ripperStreamRun,stream) != 0) {
+		printf("Error: Unable to start the stream.\n");
+		pthread_cond_destroy(&stream->changed);
+		pthread_mutex_destroy(&stream->lock);
+		free(stream);
+		return NULL;
+	}
+	
+	return stream;
+}
+
+long ripperStreamNext(ripper_stream_t * stream,const int16_t ** pcm,int * trackNum)
+{
+	if(stream == NULL) {
+		return -1;
+	}
+	
+	pthread_mutex_lock(&stream->lock);
+	//the caller is done with the batch it took last time.  A
+	//batch handed off before it was asked for is kept
+	if(stream->taken) {
+		stream->taken = 0;
+		stream->ready = 0;
+		pthread_cond_broadcast(&stream->changed);
+	}
+	while(!stream->ready && !stream->done)
+		pthread_cond_wait(&stream->changed,&stream->lock);
+	
+	long sectors;
+	if(stream->ready) {
+		stream->taken = 1;
+		*pcm = stream->pcm;
+		if(trackNum != NULL)
+			*trackNum = stream->track;
+		sectors = stream->sectors;
+	} else {
+		*pcm = NULL;
+		sectors = stream->result == 1 ? 0 : -1;
+	}
+	pthread_mutex_unlock(&stream->lock);
+	
+	return sectors;
+}
+
+ripper_stream_t * ripperStreamClose(ripper_stream_t * stream)
+{
+	if(stream != NULL) {
+		//a rip still running stops at its next batch
+		pthread_mutex_lock(&stream->lock);
+		stream->closing = 1;
+		pthread_cond_broadcast(&stream->changed);
+		pthread_mutex_unlock(&stream->lock);
+		
+		pthread_join(stream->thread,NULL);
+		pthread_cond_destroy(&stream->changed);
+		pthread_mutex_destroy(&stream->lock);
+		free(stream);
+	}
+	
+	return NULL;
+}
+
+//sink writing every span back to back into one bin image.
+//Each span is written at its place in the layout so the
+//spans skipped or resumed by a journaled rip stay in place
+static int ripperBinSinkBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	ripper_file_sink_t * file = sink->data;
+	off_t offset = (off_t)CDIO_CD_FRAMESIZE_RAW * (span->start - span->first);
+	int s;
+	
+	for(s = 0;s < file->numLayout && file->layout[s].track != span->track;s++)
+		offset += (off_t)CDIO_CD_FRAMESIZE_RAW * (file->layout[s].last - file->layout[s].first + 1);
+	
+	return ripperFileSeek(file,offset);
+}
+
+static int ripperBinSinkEnd(ripper_sink_t * sink,int status)
+{
+	return status;
+}
+
+//prints a cue sheet index at offset sectors into the image
+static void ripperWriteCueIndex(FILE * fp,int index,long offset)
+{
+	fprintf(fp,"    INDEX %02d %02ld:%02ld:%02ld\n",index,
+		offset / (60 * CDIO_CD_FRAMES_PER_SEC),
+		(offset / CDIO_CD_FRAMES_PER_SEC) % 60,
+		offset % CDIO_CD_FRAMES_PER_SEC);
+}
+
+//writes a cue sheet describing the spans as they were
+//laid out in the bin image binFilename.  A pregap is ripped
+//with the track before it, its INDEX 00 is only written
+//when that track is in the image
+//returns 1 on success and -1 on error
+static int ripperWriteCueSheet(ripper_cd_data_t * ripper,const char * cueFilename,const char * binFilename,const ripper_span_t * spans,int numSpans)
+{
+	FILE * fp = fopen(cueFilename,"w");
+	if(fp == NULL) {
+		printf("Error: Unable to open file %s for writing.\n",cueFilename);
+		return -1;
+	}
+	
+	//the cue sheet refers to the image by its name only
+	const char * binName = strrchr(binFilename,'/');
+	binName = binName != NULL ? binName + 1 : binFilename;
+	
+	fprintf(fp,"FILE \"%s\" BINARY\n",binName);
+	
+	long offset = 0;
+	int s;
+	for(s = 0;s < numSpans;s++) {
+		lsn_t pregap = ripper->toc[spans[s].track - 1].pregap;
+		
+		fprintf(fp,"  TRACK %02d AUDIO\n",spans[s].track);
+		if(s > 0 && spans[s - 1].last + 1 == spans[s].first && pregap > spans[s - 1].first && pregap < spans[s].first)
+			ripperWriteCueIndex(fp,0,offset - (spans[s].first - pregap));
+		ripperWriteCueIndex(fp,1,offset);
+		offset += spans[s].last - spans[s].first + 1;
+	}
+	
+	if(fclose(fp) != 0) {
+		printf("Error: Unable to write to file %s.\n",cueFilename);
+		return -1;
+	}
+	
+	return 1;
+}
+
+//returns the spans of every audio track in disc order and
+//sets numSpans to their number
+//returns NULL on error or if there are no audio tracks
+static ripper_span_t * ripperGetDiscSpans(ripper_cd_data_t * ripper,int * numSpans)
+{
+	ripper_span_t * spans = calloc(sizeof(ripper_span_t),ripper->totalTracks);
+	if(spans == NULL) {
+		printf("Error: Unable to allocate memory for the track list.\n");
+		return NULL;
+	}
+	
+	//collect the audio tracks in disc order, data tracks are
+	//skipped and any gap they leave is the only seek made
+	int trackNum;
+	*numSpans = 0;
+	for(trackNum = 1;trackNum <= ripper->totalTracks;trackNum++) {
+		if(!ripper->toc[trackNum - 1].audio)
+			continue;
+		if(ripperGetTrackSpan(ripper,trackNum,&spans[*numSpans]) == -1) {
+			free(spans);
+			return NULL;
+		}
+		(*numSpans)++;
+	}
+	
+	if(*numSpans == 0) {
+		printf("Error: No audio tracks to rip.\n");
+		free(spans);
+		return NULL;
+	}
+	
+	return spans;
+}
+
+int ripperRipDiscSink(ripper_cd_data_t * ripper,ripper_sink_t * sink)
+{
+	if(ripper == NULL || sink == NULL) {
+		return -1;
+	}
+	
+	int numSpans;
+	ripper_span_t * spans = ripperGetDiscSpans(ripper,&numSpans);
+	if(spans == NULL) {
+		return -1;
+	}
+	
+	int result = ripperRipSpans(ripper,spans,numSpans,sink,NULL);
+	free(spans);
+	
+	return result;
+}
+
+int ripperRipDisc(ripper_cd_data_t * ripper,RIPPER_DISC_OUTPUT_TYPE output,const char * filename)
+{
+	if(ripper == NULL) {
+		return -1;
+	}
+	if(filename == NULL) {
+		printf("Error: No filename was specified.\n");
+		return -1;
+	}
+	
+	if(output == RIPPER_DISC_TRACK_FILES) {
+		ripper_sink_t * sink;
+		if(ripper->format == FLAC_AUDIO)
+			sink = ripperFLACSinkInit(filename,1,RIPPER_DEFAULT_FLAC_COMPRESSION,0);
+		else if(ripper->format == RAW_CD_DATA)
+			sink = ripperRawSinkInit(filename,1,ripper->output_mode);
+		else
+			sink = ripperWavSinkInit(filename,1,ripper->output_mode);
+		if(sink == NULL)
+			return -1;
+		
+		int numSpans;
+		ripper_span_t * spans = ripperGetDiscSpans(ripper,&numSpans);
+		if(spans == NULL) {
+			ripperSinkDestroy(sink);
+			return -1;
+		}
+		
+		ripper_file_sink_t * file = NULL;
+		if(ripper->format != FLAC_AUDIO)
+			file = &((ripper_wav_sink_t *)sink)->file;
+		int result = ripperRipTrackFiles(ripper,spans,numSpans,sink,file,filename,1);
+		free(spans);
+		ripperSinkDestroy(sink);
+		return result;
+	}
+	
+	int numSpans;
+	ripper_span_t * spans = ripperGetDiscSpans(ripper,&numSpans);
+	if(spans == NULL) {
+		return -1;
+	}
+	
+	//the bin image gets every track back to back
+	ripper_file_sink_t file = { filename, 0, NULL, ripper->output_mode, -1 };
+	ripper_sink_t sink = { ripperBinSinkBegin, ripperFileSinkWrite, ripperBinSinkEnd, &file };
+	size_t size = 0;
+	int i;
+	for(i = 0;i < numSpans;i++)
+		size += (size_t)CDIO_CD_FRAMESIZE_RAW * (spans[i].last - spans[i].first + 1);
+	file.layout = spans;
+	file.numLayout = numSpans;
+	
+	//a journaled rip only reads the parts of the image that
+	//the last rip didn't finish
+	ripper_span_t * todo = spans;
+	int numTodo = numSpans;
+	ripper_journal_output_t journaled;
+	int kept = 0;
+	if(ripper->journal != NULL) {
+		todo = malloc(sizeof(ripper_span_t) * numSpans);
+		if(todo == NULL) {
+			printf("Error: Unable to allocate memory for the track list.\n");
+			free(spans);
+			return -1;
+		}
+		memcpy(todo,spans,sizeof(ripper_span_t) * numSpans);
+		journaled.id = ripperJournalOutputId(filename,RAW_CD_DATA | RIPPER_JOURNAL_BIN);
+		journaled.file = &file;
+		journaled.path = filename;
+		journaled.pattern = 0;
+		kept = ripperJournalPlan(ripper,todo,&numTodo,&journaled);
+	}
+	
+	int result = -1;
+	if(ripperFileOpen(&file,filename,size,kept > 0) == 1) {
+		result = ripperRipSpans(ripper,todo,numTodo,&sink,ripper->journal != NULL ? &journaled : NULL);
+	
+		if(ripperFileClose(&file) == -1 && result == 1) {
+			printf("Error: Unable to write to file %s.\n",filename);
+			result = -1;
+		}
+	}
+	free(file.staging);
+	if(todo != spans)
+		free(todo);
+	
+	//the cue sheet sits next to the image with the
+	//extension replaced.  An image already named .cue gets
+	//.cue appended so the sheet doesn't overwrite it
+	if(result == 1) {
+		size_t length = strlen(filename);
+		char * cueFilename = malloc(length + 5);
+		if(cueFilename == NULL) {
+			printf("Error: Unable to allocate memory for the cue sheet name.\n");
+			result = -1;
+		} else {
+			strcpy(cueFilename,filename);
+			char * extension = strrchr(cueFilename,'.');
+			if(extension == NULL || strchr(extension,'/') != NULL || strcasecmp(extension,".cue") == 0)
+				extension = cueFilename + length;
+			strcpy(extension,".cue");
+			
+			//the pregaps are only known after a scan of the
+			//subchannel, without one the tracks start at
+			//INDEX 01 alone
+			if(ripperScanIndexes(ripper) == -1)
+				printf("Warning: The cue sheet of %s has no pregaps.\n",filename);
+			result = ripperWriteCueSheet(ripper,cueFilename,filename,spans,numSpans);
+			free(cueFilename);
+		}
+	}
+	
+	free(spans);
+	
+	return result;
+}
+
+//returns the cd drives found on the system
+char ** ripperGetDrives(int * numDrives)
+{
+	char ** drives = cdio_get_devices(DRIVER_DEVICE);
+	int count = 0;
+	
+	if(drives != NULL) {
+		while(drives[count] != NULL)
+			count++;
+	}
+	if(numDrives != NULL)
+		*numDrives = count;
+	
+	return drives;
+}
+
+//frees the list returned by ripperGetDrives
+//always returns NULL
+char ** ripperFreeDrives(char ** drives)
+{
+	if(drives != NULL)
+		cdio_free_device_list(drives);
+	
+	return NULL;
+}
+
+//state shared by the workers of ripperRunJobs. next is
+//the only value written by more than one worker
+typedef struct ripper_job_queue_t {
+	ripper_job_t * jobs;
+	int numJobs;
+	int next;
+	int failed;
+} ripper_job_queue_t;
+
+//one worker of ripperRunJobs and the drive it owns
+typedef struct ripper_job_worker_t {
+	ripper_job_queue_t * queue;
+	const char * drive;
+	pthread_t thread;
+} ripper_job_worker_t;
+
+//pulls jobs off the queue until it is empty.  every job
+//gets its own ripper so nothing is shared between drives
+static void * ripperJobWorker(void * arg)
+{
+	ripper_job_worker_t * worker = arg;
+	ripper_job_queue_t * queue = worker->queue;
+	
+	for(;;) {
+		int j = __atomic_fetch_add(&queue->next,1,__ATOMIC_RELAXED);
+		if(j >= queue->numJobs)
+			break;
+		
+		ripper_job_t * job = &queue->jobs[j];
+		ripper_cd_data_t * ripper = NULL;
+		
+		if(job->source != NULL)
+			ripper = ripperInitSource(job->source,job->driver);
+		else if(worker->drive != NULL)
+			ripper = ripperInitSource(worker->drive,DRIVER_DEVICE);
+		
+		if(ripper == NULL) {
+			printf("Error: Unable to open the source for job %d.\n",j);
+			job->status = -1;
+		} else {
+			job->status = job->run(ripper,job->arg);
+			ripperCDDataDestroy(ripper);
+		}
+		
+		if(job->status != 1)
+			__atomic_fetch_add(&queue->failed,1,__ATOMIC_RELAXED);
+	}
+	
+	return NULL;
+}
+
+int ripperRunJobs(char ** drives,int numDrives,ripper_job_t * jobs,int numJobs)
+{
+	if(numDrives <= 0 || jobs == NULL) {
+		return -1;
+	}
+	
+	ripper_job_queue_t queue = { jobs, numJobs, 0, 0 };
+	ripper_job_worker_t * workers = calloc(sizeof(ripper_job_worker_t),numDrives);
+	if(workers == NULL) {
+		printf("Error: Unable to allocate memory for the workers.\n");
+		return -1;
+	}
+	
+	int started = 0;
+	int i;
+	for(i = 0;i < numDrives;i++) {
+		workers[i].queue = &queue;
+		workers[i].drive = drives != NULL ? drives[i] : NULL;
+		if(pthread_create(&workers[i].thread,NULL,ripperJobWorker,&workers[i]) != 0) {
+			printf("Error: Unable to start a worker for drive %d.\n",i);
+			break;
+		}
+		started++;
+	}
+	
+	//with no workers running nothing would ever take the jobs
+	if(started == 0) {
+		free(workers);
+		return -1;
+	}
+	
+	for(i = 0;i < started;i++)
+		pthread_join(workers[i].thread,NULL);
+	free(workers);
+	
+	return queue.failed;
 }
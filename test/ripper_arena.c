@@ -0,0 +1,208 @@
+/**
+  libripper
+
+  Arenas holding cddb results.
+
+  Every set of results lives in one arena, the results, their
+  tracks and strings are carved out of blocks of memory and
+  the arena is freed in one go.  The arena starts out as a
+  single allocation holding its own header and first block,
+  further blocks are only added when a result set outgrows
+  it.  Strings are interned so the artist, genre and
+  category repeated across tracks and matches are stored
+  once.  An arena that is reset keeps its blocks, so reading
+  match after match into it stops allocating once the
+  blocks are big enough.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "ripper.h"
+
+//every allocation is aligned for any type it may hold
+#define RIPPER_ARENA_ALIGNMENT 16
+#define RIPPER_ARENA_MIN_BLOCK 4096
+//slots of the first string table, always a power of two
+#define RIPPER_ARENA_MIN_STRINGS 64
+
+static size_t ripperArenaAlign(size_t size)
+{
+	return (size + RIPPER_ARENA_ALIGNMENT - 1) & ~(size_t)(RIPPER_ARENA_ALIGNMENT - 1);
+}
+
+//the data of a block starts after its aligned header
+static unsigned char * ripperArenaData(ripper_arena_block_t * block)
+{
+	return (unsigned char *)block + ripperArenaAlign(sizeof(ripper_arena_block_t));
+}
+
+ripper_cddb_arena_t * ripperCDDBArenaCreate(size_t size)
+{
+	if(size < RIPPER_ARENA_MIN_BLOCK)
+		size = RIPPER_ARENA_MIN_BLOCK;
+	size = ripperArenaAlign(size);
+
+	//the first block is the tail of the arena's own
+	//allocation
+	ripper_cddb_arena_t * arena = malloc(ripperArenaAlign(sizeof(ripper_cddb_arena_t)) + ripperArenaAlign(sizeof(ripper_arena_block_t)) + size);
+	if(arena == NULL)
+		return NULL;
+
+	memset(arena,0,sizeof(*arena));
+	arena->first = (ripper_arena_block_t *)((unsigned char *)arena + ripperArenaAlign(sizeof(ripper_cddb_arena_t)));
+	arena->first->next = NULL;
+	arena->first->size = size;
+	arena->first->used = 0;
+	arena->current = arena->first;
+
+	return arena;
+}
+
+void ripperCDDBArenaDestroy(ripper_cddb_arena_t * arena)
+{
+	if(arena != NULL) {
+		ripper_arena_block_t * block = arena->first->next;
+		while(block != NULL) {
+			ripper_arena_block_t * next = block->next;
+			free(block);
+			block = next;
+		}
+		free(arena);
+	}
+}
+
+void ripperCDDBArenaReset(ripper_cddb_arena_t * arena)
+{
+	ripper_arena_block_t * block;
+
+	for(block = arena->first;block != NULL;block = block->next)
+		block->used = 0;
+	arena->current = arena->first;
+	arena->strings = NULL;
+	arena->numStrings = 0;
+	arena->sizeStrings = 0;
+	arena->numMatches = 0;
+	arena->results = NULL;
+}
+
+void * ripperCDDBArenaAlloc(ripper_cddb_arena_t * arena,size_t size)
+{
+	ripper_arena_block_t * block = arena->current;
+
+	size = ripperArenaAlign(size);
+
+	//blocks kept by a reset are used again in order before
+	//a new one is added
+	while(block->size - block->used < size && block->next != NULL)
+		block = block->next;
+
+	if(block->size - block->used < size) {
+		size_t blockSize = block->size * 2;
+		if(blockSize < size)
+			blockSize = ripperArenaAlign(size);
+
+		ripper_arena_block_t * added = malloc(ripperArenaAlign(sizeof(ripper_arena_block_t)) + blockSize);
+		if(added == NULL)
+			return NULL;
+		added->next = NULL;
+		added->size = blockSize;
+		added->used = 0;
+		block->next = added;
+		block = added;
+	}
+
+	void * memory = ripperArenaData(block) + block->used;
+	block->used += size;
+	arena->current = block;
+	memset(memory,0,size);
+
+	return memory;
+}
+
+static uint32_t ripperArenaHash(const char * string,size_t length)
+{
+	uint32_t hash = 2166136261u;
+	size_t i;
+
+	for(i = 0;i < length;i++)
+		hash = (hash ^ (unsigned char)string[i]) * 16777619u;
+
+	return hash;
+}
+
+//doubles the string table, the old table stays behind in
+//the arena
+//returns 1 on success and -1 on error
+static int ripperArenaGrowStrings(ripper_cddb_arena_t * arena)
+{
+	size_t size = arena->sizeStrings ? arena->sizeStrings * 2 : RIPPER_ARENA_MIN_STRINGS;
+	char ** strings = ripperCDDBArenaAlloc(arena,sizeof(char *) * size);
+	size_t i;
+
+	if(strings == NULL)
+		return -1;
+
+	for(i = 0;i < arena->sizeStrings;i++) {
+		char * string = arena->strings[i];
+		if(string != NULL) {
+			size_t slot = ripperArenaHash(string,strlen(string)) & (size - 1);
+			while(strings[slot] != NULL)
+				slot = (slot + 1) & (size - 1);
+			strings[slot] = string;
+		}
+	}
+	arena->strings = strings;
+	arena->sizeStrings = size;
+
+	return 1;
+}
+
+char * ripperCDDBArenaIntern(ripper_cddb_arena_t * arena,const char * string,size_t length)
+{
+	size_t slot;
+
+	//a string read from a file may hold a nul, it ends there
+	length = strnlen(string,length);
+	//the table is kept at most half full
+	if((arena->numStrings + 1) * 2 > arena->sizeStrings && ripperArenaGrowStrings(arena) == -1)
+		return NULL;
+
+	slot = ripperArenaHash(string,length) & (arena->sizeStrings - 1);
+	while(arena->strings[slot] != NULL) {
+		if(strncmp(arena->strings[slot],string,length) == 0 && arena->strings[slot][length] == '\0')
+			return arena->strings[slot];
+		slot = (slot + 1) & (arena->sizeStrings - 1);
+	}
+
+	char * copy = ripperCDDBArenaAlloc(arena,length + 1);
+	if(copy == NULL)
+		return NULL;
+	memcpy(copy,string,length);
+	copy[length] = '\0';
+	arena->strings[slot] = copy;
+	arena->numStrings++;
+
+	return copy;
+}
+
+ripper_cddb_query_results_t * ripperCDDBResultsCreate(int matches,size_t size)
+{
+	ripper_cddb_arena_t * arena = ripperCDDBArenaCreate(size + sizeof(ripper_cddb_query_results_t) * (matches + 1));
+	int i;
+
+	if(arena == NULL)
+		return NULL;
+
+	arena->results = ripperCDDBArenaAlloc(arena,sizeof(ripper_cddb_query_results_t) * (matches + 1));
+	if(arena->results == NULL) {
+		ripperCDDBArenaDestroy(arena);
+		return NULL;
+	}
+	arena->numMatches = matches;
+	for(i = 0;i <= matches;i++)
+		arena->results[i].arena = arena;
+
+	return arena->results;
+}
@@ -0,0 +1,738 @@
+/**
+  libripper
+
+  Persistent cache of cddb query results.
+
+  The cache is a directory holding two files.  index is a
+  fixed size open addressed hash table that is memory
+  mapped, so a lookup is a few probes in memory followed
+  by one read of the record.  data holds the records, one
+  per disc, appended as discs are added.  Each record
+  starts with the disc's table of contents which is
+  compared on every hit so a hash collision is never
+  returned as a match.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/file.h>
+#include "ripper.h"
+
+//"RPCC" in a little endian file
+#define RIPPER_CACHE_MAGIC 0x43435052
+#define RIPPER_CACHE_VERSION 1
+
+//states of an index slot
+#define RIPPER_CACHE_EMPTY 0
+#define RIPPER_CACHE_LIVE 1
+#define RIPPER_CACHE_DELETED 2
+
+//marks a NULL string in a record
+#define RIPPER_CACHE_NULL_STRING 0xFFFFFFFF
+
+//start of the index file
+//generation changes whenever the data file is rewritten
+//so other handles know to reopen it
+typedef struct ripper_cache_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t capacity;
+	uint32_t count;
+	uint32_t deleted;
+	uint32_t clock;
+	uint32_t generation;
+	uint32_t reserved;
+	uint64_t data_size;
+} ripper_cache_header_t;
+
+//one slot of the index. used is the clock value of the
+//last hit and picks the entries dropped when the cache
+//is over its limits
+typedef struct ripper_cache_entry_t {
+	uint32_t discid;
+	uint32_t state;
+	uint64_t toc_hash;
+	uint64_t offset;
+	uint32_t length;
+	uint32_t used;
+} ripper_cache_entry_t;
+
+//growing buffer a record is serialized into
+typedef struct ripper_cache_buffer_t {
+	unsigned char * data;
+	size_t length;
+	size_t size;
+	int failed;
+} ripper_cache_buffer_t;
+
+//cursor over a record being read back
+typedef struct ripper_cache_reader_t {
+	const unsigned char * data;
+	size_t length;
+	size_t pos;
+	int failed;
+} ripper_cache_reader_t;
+
+static ripper_cache_header_t * ripperCacheHeader(ripper_cddb_cache_t * cache)
+{
+	return cache->index;
+}
+
+static ripper_cache_entry_t * ripperCacheEntries(ripper_cddb_cache_t * cache)
+{
+	return (ripper_cache_entry_t *)((char *)cache->index + sizeof(ripper_cache_header_t));
+}
+
+//hash of the table of contents, together with the disc
+//id it is the key of an entry
+static uint64_t ripperCacheTocHash(const ripper_cd_data_t * rp)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	unsigned int i;
+
+	hash = (hash ^ rp->totalTracks) * 0x100000001b3ULL;
+	hash = (hash ^ rp->cd_length) * 0x100000001b3ULL;
+	for(i = 0;i < rp->totalTracks;i++)
+		hash = (hash ^ (uint32_t)rp->frame_offsets[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+static char * ripperCachePath(const char * dir,const char * name)
+{
+	char * path = malloc(strlen(dir) + strlen(name) + 2);
+
+	if(path != NULL)
+		sprintf(path,"%s/%s",dir,name);
+
+	return path;
+}
+
+//opens the data file of the cache
+//returns the descriptor or -1 on error
+static int ripperCacheOpenData(ripper_cddb_cache_t * cache)
+{
+	char * path = ripperCachePath(cache->dir,"data");
+	int fd = -1;
+
+	if(path != NULL) {
+		fd = open(path,O_RDWR | O_CREAT | O_CLOEXEC,0644);
+		free(path);
+	}
+
+	return fd;
+}
+
+//reopens the data file if another handle rewrote it
+static int ripperCacheCheckGeneration(ripper_cddb_cache_t * cache)
+{
+	ripper_cache_header_t * header = ripperCacheHeader(cache);
+
+	if(header->generation != cache->generation) {
+		int fd = ripperCacheOpenData(cache);
+		if(fd == -1)
+			return -1;
+		close(cache->data_fd);
+		cache->data_fd = fd;
+		cache->generation = header->generation;
+	}
+
+	return 1;
+}
+
+//takes the cache for this thread and process
+static void ripperCacheLock(ripper_cddb_cache_t * cache)
+{
+	pthread_mutex_lock(&cache->lock);
+	flock(cache->index_fd,LOCK_EX);
+}
+
+static void ripperCacheUnlock(ripper_cddb_cache_t * cache)
+{
+	flock(cache->index_fd,LOCK_UN);
+	pthread_mutex_unlock(&cache->lock);
+}
+
+ripper_cddb_cache_t * ripperCDDBCacheOpen(const char * dir,unsigned int maxEntries,long maxDataBytes)
+{
+	if(dir == NULL || maxEntries == 0) {
+		return NULL;
+	}
+
+	ripper_cddb_cache_t * cache = calloc(sizeof(ripper_cddb_cache_t),1);
+	if(cache == NULL) {
+		printf("Error: Unable to allocate memory for the cddb cache.\n");
+		return NULL;
+	}
+
+	cache->index_fd = -1;
+	cache->data_fd = -1;
+	cache->max_entries = maxEntries;
+	cache->max_data_bytes = maxDataBytes;
+	pthread_mutex_init(&cache->lock,NULL);
+
+	cache->dir = malloc(strlen(dir) + 1);
+	if(cache->dir == NULL) {
+		printf("Error: Unable to allocate memory for the cddb cache.\n");
+		return ripperCDDBCacheClose(cache);
+	}
+	strcpy(cache->dir,dir);
+
+	if(mkdir(dir,0755) == -1 && errno != EEXIST) {
+		printf("Error: Unable to create the cddb cache %s.\n",dir);
+		return ripperCDDBCacheClose(cache);
+	}
+
+	char * path = ripperCachePath(dir,"index");
+	if(path == NULL) {
+		printf("Error: Unable to allocate memory for the cddb cache.\n");
+		return ripperCDDBCacheClose(cache);
+	}
+	cache->index_fd = open(path,O_RDWR | O_CREAT | O_CLOEXEC,0644);
+	free(path);
+	cache->data_fd = ripperCacheOpenData(cache);
+	if(cache->index_fd == -1 || cache->data_fd == -1) {
+		printf("Error: Unable to open the cddb cache %s.\n",dir);
+		return ripperCDDBCacheClose(cache);
+	}
+
+	//a slot for every two entries keeps the probes short
+	uint32_t capacity = 16;
+	while(capacity < maxEntries * 2)
+		capacity *= 2;
+
+	flock(cache->index_fd,LOCK_EX);
+
+	struct stat st;
+	ripper_cache_header_t existing;
+	int valid = fstat(cache->index_fd,&st) == 0
+		&& pread(cache->index_fd,&existing,sizeof(existing),0) == sizeof(existing)
+		&& existing.magic == RIPPER_CACHE_MAGIC && existing.version == RIPPER_CACHE_VERSION
+		&& st.st_size == sizeof(existing) + (off_t)existing.capacity * sizeof(ripper_cache_entry_t);
+
+	//an existing index keeps its size, anything else
+	//found in the file is replaced with an empty index
+	if(valid) {
+		capacity = existing.capacity;
+	} else {
+		ripper_cache_header_t header;
+		memset(&header,0,sizeof(header));
+		header.magic = RIPPER_CACHE_MAGIC;
+		header.version = RIPPER_CACHE_VERSION;
+		header.capacity = capacity;
+
+		if(ftruncate(cache->index_fd,0) == -1
+			|| ftruncate(cache->index_fd,sizeof(header) + (off_t)capacity * sizeof(ripper_cache_entry_t)) == -1
+			|| pwrite(cache->index_fd,&header,sizeof(header),0) != sizeof(header)
+			|| ftruncate(cache->data_fd,0) == -1) {
+			flock(cache->index_fd,LOCK_UN);
+			printf("Error: Unable to create the cddb cache index.\n");
+			return ripperCDDBCacheClose(cache);
+		}
+	}
+
+	cache->index_size = sizeof(ripper_cache_header_t) + (size_t)capacity * sizeof(ripper_cache_entry_t);
+	cache->index = mmap(NULL,cache->index_size,PROT_READ | PROT_WRITE,MAP_SHARED,cache->index_fd,0);
+	flock(cache->index_fd,LOCK_UN);
+
+	if(cache->index == MAP_FAILED) {
+		cache->index = NULL;
+		printf("Error: Unable to map the cddb cache index.\n");
+		return ripperCDDBCacheClose(cache);
+	}
+	cache->generation = ripperCacheHeader(cache)->generation;
+
+	return cache;
+}
+
+ripper_cddb_cache_t * ripperCDDBCacheClose(ripper_cddb_cache_t * cache)
+{
+	if(cache != NULL) {
+		if(cache->index != NULL)
+			munmap(cache->index,cache->index_size);
+		if(cache->index_fd != -1)
+			close(cache->index_fd);
+		if(cache->data_fd != -1)
+			close(cache->data_fd);
+		pthread_mutex_destroy(&cache->lock);
+		free(cache->dir);
+		free(cache);
+	}
+
+	return NULL;
+}
+
+//returns the slot holding the key or NULL when it isn't
+//cached. freeSlot is set to the first slot the key could
+//be added in when it isn't NULL
+static ripper_cache_entry_t * ripperCacheFind(ripper_cddb_cache_t * cache,uint32_t discid,uint64_t tocHash,ripper_cache_entry_t ** freeSlot)
+{
+	ripper_cache_header_t * header = ripperCacheHeader(cache);
+	ripper_cache_entry_t * entries = ripperCacheEntries(cache);
+	uint32_t mask = header->capacity - 1;
+	uint32_t slot = (uint32_t)(tocHash ^ discid) & mask;
+	uint32_t probes;
+
+	if(freeSlot != NULL)
+		*freeSlot = NULL;
+
+	for(probes = 0;probes < header->capacity;probes++,slot = (slot + 1) & mask) {
+		ripper_cache_entry_t * entry = &entries[slot];
+
+		if(entry->state == RIPPER_CACHE_EMPTY) {
+			if(freeSlot != NULL && *freeSlot == NULL)
+				*freeSlot = entry;
+			return NULL;
+		}
+		if(entry->state == RIPPER_CACHE_DELETED) {
+			if(freeSlot != NULL && *freeSlot == NULL)
+				*freeSlot = entry;
+			continue;
+		}
+		if(entry->discid == discid && entry->toc_hash == tocHash)
+			return entry;
+	}
+
+	return NULL;
+}
+
+static void ripperCacheRemove(ripper_cddb_cache_t * cache,ripper_cache_entry_t * entry)
+{
+	ripper_cache_header_t * header = ripperCacheHeader(cache);
+
+	entry->state = RIPPER_CACHE_DELETED;
+	header->count--;
+	header->deleted++;
+}
+
+static void ripperCachePut(ripper_cache_buffer_t * buffer,const void * data,size_t length)
+{
+	if(buffer->failed)
+		return;
+
+	if(buffer->length + length > buffer->size) {
+		size_t size = buffer->size ? buffer->size : 1024;
+		while(size < buffer->length + length)
+			size *= 2;
+		unsigned char * grown = realloc(buffer->data,size);
+		if(grown == NULL) {
+			buffer->failed = 1;
+			return;
+		}
+		buffer->data = grown;
+		buffer->size = size;
+	}
+
+	memcpy(buffer->data + buffer->length,data,length);
+	buffer->length += length;
+}
+
+static void ripperCachePutInt(ripper_cache_buffer_t * buffer,uint32_t value)
+{
+	ripperCachePut(buffer,&value,sizeof(value));
+}
+
+static void ripperCachePutString(ripper_cache_buffer_t * buffer,const char * string)
+{
+	if(string == NULL) {
+		ripperCachePutInt(buffer,RIPPER_CACHE_NULL_STRING);
+	} else {
+		uint32_t length = strlen(string);
+		ripperCachePutInt(buffer,length);
+		ripperCachePut(buffer,string,length);
+	}
+}
+
+static uint32_t ripperCacheGetInt(ripper_cache_reader_t * reader)
+{
+	uint32_t value = 0;
+
+	if(reader->failed || reader->length - reader->pos < sizeof(value)) {
+		reader->failed = 1;
+		return 0;
+	}
+	memcpy(&value,reader->data + reader->pos,sizeof(value));
+	reader->pos += sizeof(value);
+
+	return value;
+}
+
+//returns the next string interned in arena
+static char * ripperCacheGetString(ripper_cache_reader_t * reader,ripper_cddb_arena_t * arena)
+{
+	uint32_t length = ripperCacheGetInt(reader);
+
+	if(reader->failed || length == RIPPER_CACHE_NULL_STRING)
+		return NULL;
+	if(reader->length - reader->pos < length) {
+		reader->failed = 1;
+		return NULL;
+	}
+
+	char * string = ripperCDDBArenaIntern(arena,(const char *)reader->data + reader->pos,length);
+	if(string == NULL) {
+		reader->failed = 1;
+		return NULL;
+	}
+	reader->pos += length;
+
+	return string;
+}
+
+//serializes the table of contents of the disc and its
+//query results into buffer
+static void ripperCacheWriteRecord(ripper_cache_buffer_t * buffer,const ripper_cd_data_t * rp,const ripper_cddb_query_results_t * results,int numMatches)
+{
+	unsigned int i;
+	int m,t;
+
+	ripperCachePutInt(buffer,rp->totalTracks);
+	ripperCachePutInt(buffer,rp->cd_length);
+	for(i = 0;i < rp->totalTracks;i++)
+		ripperCachePutInt(buffer,rp->frame_offsets[i]);
+
+	ripperCachePutInt(buffer,numMatches);
+	for(m = 0;m < numMatches;m++) {
+		ripperCachePutString(buffer,results[m].category);
+		ripperCachePutString(buffer,results[m].artist);
+		ripperCachePutString(buffer,results[m].title);
+		ripperCachePutString(buffer,results[m].genre);
+		ripperCachePutString(buffer,results[m].ext_data);
+		ripperCachePutInt(buffer,results[m].year);
+		ripperCachePutInt(buffer,results[m].numTracks);
+		for(t = 0;t < results[m].numTracks;t++) {
+			ripperCachePutString(buffer,results[m].tracks[t].title);
+			ripperCachePutString(buffer,results[m].tracks[t].artist);
+			ripperCachePutInt(buffer,results[m].tracks[t].length);
+		}
+	}
+}
+
+//reads back a record written by ripperCacheWriteRecord.
+//returns the results laid out like ripperCDDBQuery's and
+//sets numMatches, numMatches is -1 if the record doesn't
+//belong to the disc or can't be read
+static ripper_cddb_query_results_t * ripperCacheReadRecord(ripper_cache_reader_t * reader,const ripper_cd_data_t * rp,int * numMatches)
+{
+	unsigned int i;
+	int m,t;
+
+	*numMatches = -1;
+
+	if(ripperCacheGetInt(reader) != rp->totalTracks || ripperCacheGetInt(reader) != rp->cd_length)
+		return NULL;
+	for(i = 0;i < rp->totalTracks;i++) {
+		if((int)ripperCacheGetInt(reader) != rp->frame_offsets[i])
+			return NULL;
+	}
+
+	int matches = ripperCacheGetInt(reader);
+	if(reader->failed || matches < 0)
+		return NULL;
+	if(matches == 0) {
+		*numMatches = 0;
+		return NULL;
+	}
+
+	//every match takes at least its header, a larger count
+	//comes from a damaged record
+	if((size_t)matches > reader->length)
+		return NULL;
+
+	//the record holds about as many bytes as the results
+	//take once read
+	ripper_cddb_query_results_t * results = ripperCDDBResultsCreate(matches,reader->length * 2);
+	if(results == NULL)
+		return NULL;
+	ripper_cddb_arena_t * arena = results->arena;
+
+	for(m = 0;m < matches && !reader->failed;m++) {
+		results[m].category = ripperCacheGetString(reader,arena);
+		results[m].artist = ripperCacheGetString(reader,arena);
+		results[m].title = ripperCacheGetString(reader,arena);
+		results[m].genre = ripperCacheGetString(reader,arena);
+		results[m].ext_data = ripperCacheGetString(reader,arena);
+		results[m].year = ripperCacheGetInt(reader);
+		int numTracks = ripperCacheGetInt(reader);
+		if(reader->failed || numTracks < 0 || (size_t)numTracks > reader->length) {
+			reader->failed = 1;
+			break;
+		}
+		results[m].numTracks = numTracks;
+		results[m].tracks = ripperCDDBArenaAlloc(arena,sizeof(ripper_cddb_track_t) * (numTracks + 1));
+		if(results[m].tracks == NULL) {
+			reader->failed = 1;
+			break;
+		}
+		for(t = 0;t < numTracks;t++) {
+			results[m].tracks[t].title = ripperCacheGetString(reader,arena);
+			results[m].tracks[t].artist = ripperCacheGetString(reader,arena);
+			results[m].tracks[t].length = ripperCacheGetInt(reader);
+		}
+	}
+
+	//whatever was read so far goes with the arena
+	if(reader->failed)
+		return ripperCDDBQueryDestroy(results);
+
+	*numMatches = matches;
+	return results;
+}
+
+//returns the cached results for the disc and sets
+//numMatches. numMatches is -1 when the disc isn't cached
+static ripper_cddb_query_results_t * ripperCacheLookup(ripper_cddb_cache_t * cache,const ripper_cd_data_t * rp,uint32_t discid,int * numMatches)
+{
+	*numMatches = -1;
+
+	ripper_cache_entry_t * entry = ripperCacheFind(cache,discid,ripperCacheTocHash(rp),NULL);
+	if(entry == NULL || ripperCacheCheckGeneration(cache) == -1)
+		return NULL;
+
+	unsigned char * record = malloc(entry->length);
+	if(record == NULL)
+		return NULL;
+
+	ripper_cddb_query_results_t * results = NULL;
+	if(pread(cache->data_fd,record,entry->length,entry->offset) == entry->length) {
+		ripper_cache_reader_t reader = { record, entry->length, 0, 0 };
+		results = ripperCacheReadRecord(&reader,rp,numMatches);
+	}
+	free(record);
+
+	if(*numMatches != -1)
+		entry->used = ++ripperCacheHeader(cache)->clock;
+
+	return results;
+}
+
+//orders entries from the most to the least recently used
+static int ripperCacheCompareUsed(const void * a,const void * b)
+{
+	const ripper_cache_entry_t * x = a;
+	const ripper_cache_entry_t * y = b;
+
+	return x->used < y->used ? 1 : x->used > y->used ? -1 : 0;
+}
+
+//rewrites the cache keeping the most recently used
+//entries that fit in maxEntries and maxBytes.  The data
+//file is copied so the space of removed records is freed
+//and the index is rebuilt without deleted slots
+//returns 1 on success and -1 on error
+static int ripperCacheCompact(ripper_cddb_cache_t * cache,uint32_t maxEntries,uint64_t maxBytes)
+{
+	ripper_cache_header_t * header = ripperCacheHeader(cache);
+	ripper_cache_entry_t * entries = ripperCacheEntries(cache);
+	uint32_t i,live = 0;
+
+	ripper_cache_entry_t * keep = malloc(sizeof(ripper_cache_entry_t) * (header->count + 1));
+	if(keep == NULL)
+		return -1;
+
+	for(i = 0;i < header->capacity;i++) {
+		if(entries[i].state == RIPPER_CACHE_LIVE)
+			keep[live++] = entries[i];
+	}
+	qsort(keep,live,sizeof(ripper_cache_entry_t),ripperCacheCompareUsed);
+
+	char * dataPath = ripperCachePath(cache->dir,"data");
+	char * tmpPath = ripperCachePath(cache->dir,"data.tmp");
+	int fd = -1;
+	if(dataPath != NULL && tmpPath != NULL)
+		fd = open(tmpPath,O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,0644);
+	if(fd == -1) {
+		free(dataPath);
+		free(tmpPath);
+		free(keep);
+		return -1;
+	}
+
+	//copy the records that fit, newest first
+	uint64_t size = 0;
+	uint32_t kept = 0;
+	unsigned char * record = NULL;
+	int result = 1;
+	for(i = 0;i < live && kept < maxEntries;i++) {
+		if(size + keep[i].length > maxBytes)
+			continue;
+		unsigned char * grown = realloc(record,keep[i].length);
+		if(grown == NULL) {
+			result = -1;
+			break;
+		}
+		record = grown;
+		if(pread(cache->data_fd,record,keep[i].length,keep[i].offset) != keep[i].length
+			|| pwrite(fd,record,keep[i].length,size) != keep[i].length) {
+			result = -1;
+			break;
+		}
+		keep[kept] = keep[i];
+		keep[kept].offset = size;
+		size += keep[i].length;
+		kept++;
+	}
+	free(record);
+
+	if(result == 1 && rename(tmpPath,dataPath) == -1)
+		result = -1;
+	free(dataPath);
+	free(tmpPath);
+
+	if(result == -1) {
+		close(fd);
+		free(keep);
+		return -1;
+	}
+
+	//rebuild the index around the surviving records
+	close(cache->data_fd);
+	cache->data_fd = fd;
+	memset(entries,0,sizeof(ripper_cache_entry_t) * header->capacity);
+	header->count = 0;
+	header->deleted = 0;
+	header->data_size = size;
+	header->generation++;
+	cache->generation = header->generation;
+	for(i = 0;i < kept;i++) {
+		ripper_cache_entry_t * slot;
+		ripperCacheFind(cache,keep[i].discid,keep[i].toc_hash,&slot);
+		*slot = keep[i];
+		header->count++;
+	}
+	free(keep);
+
+	return 1;
+}
+
+//adds the results for the disc to the cache replacing
+//any older entry
+//returns 1 on success and -1 on error
+static int ripperCacheStore(ripper_cddb_cache_t * cache,const ripper_cd_data_t * rp,uint32_t discid,const ripper_cddb_query_results_t * results,int numMatches)
+{
+	ripper_cache_header_t * header = ripperCacheHeader(cache);
+	ripper_cache_buffer_t buffer = { NULL, 0, 0, 0 };
+	uint64_t tocHash = ripperCacheTocHash(rp);
+
+	if(ripperCacheCheckGeneration(cache) == -1)
+		return -1;
+
+	ripperCacheWriteRecord(&buffer,rp,results,numMatches);
+	if(buffer.failed || (cache->max_data_bytes > 0 && buffer.length > (uint64_t)cache->max_data_bytes)) {
+		free(buffer.data);
+		return -1;
+	}
+
+	ripper_cache_entry_t * entry = ripperCacheFind(cache,discid,tocHash,NULL);
+	if(entry != NULL)
+		ripperCacheRemove(cache,entry);
+
+	//make room by dropping the least recently used entries
+	//down to three quarters of the limits
+	int full = header->count >= cache->max_entries
+		|| header->count + header->deleted >= header->capacity * 3 / 4
+		|| (cache->max_data_bytes > 0 && header->data_size + buffer.length > (uint64_t)cache->max_data_bytes);
+	if(full) {
+		uint64_t maxBytes = cache->max_data_bytes > 0 ? (uint64_t)cache->max_data_bytes * 3 / 4 : header->data_size;
+		if(ripperCacheCompact(cache,cache->max_entries * 3 / 4,maxBytes) == -1) {
+			free(buffer.data);
+			return -1;
+		}
+	}
+
+	ripper_cache_entry_t * slot;
+	ripperCacheFind(cache,discid,tocHash,&slot);
+	if(slot == NULL || pwrite(cache->data_fd,buffer.data,buffer.length,header->data_size) != buffer.length) {
+		free(buffer.data);
+		return -1;
+	}
+
+	//the record is on disk before the index points at it
+	if(slot->state == RIPPER_CACHE_DELETED)
+		header->deleted--;
+	slot->discid = discid;
+	slot->toc_hash = tocHash;
+	slot->offset = header->data_size;
+	slot->length = buffer.length;
+	slot->used = ++header->clock;
+	slot->state = RIPPER_CACHE_LIVE;
+	header->count++;
+	header->data_size += buffer.length;
+	free(buffer.data);
+
+	return 1;
+}
+
+ripper_cddb_query_results_t * ripperCDDBQueryCached(ripper_cddb_cache_t * cache,ripper_cd_data_t * rp,int * numMatches)
+{
+	if(cache == NULL) {
+		return ripperCDDBQuery(rp,numMatches);
+	}
+	if(rp == NULL) {
+		*numMatches = -1;
+		return NULL;
+	}
+
+	uint32_t discid = ripperGetCDDBDiscId(rp);
+
+	ripperCacheLock(cache);
+	ripper_cddb_query_results_t * results = ripperCacheLookup(cache,rp,discid,numMatches);
+	ripperCacheUnlock(cache);
+	if(*numMatches != -1)
+		return results;
+
+	//the server is asked without holding the cache so other
+	//discs can still be looked up
+	results = ripperCDDBQuery(rp,numMatches);
+	if(*numMatches >= 0) {
+		ripperCacheLock(cache);
+		if(ripperCacheStore(cache,rp,discid,results,*numMatches) == -1)
+			printf("Error: Unable to add disc %08x to the cddb cache.\n",discid);
+		ripperCacheUnlock(cache);
+	}
+
+	return results;
+}
+
+int ripperCDDBCacheInvalidate(ripper_cddb_cache_t * cache,ripper_cd_data_t * rp)
+{
+	if(cache == NULL || rp == NULL) {
+		return -1;
+	}
+
+	ripperCacheLock(cache);
+	ripper_cache_entry_t * entry = ripperCacheFind(cache,ripperGetCDDBDiscId(rp),ripperCacheTocHash(rp),NULL);
+	if(entry != NULL)
+		ripperCacheRemove(cache,entry);
+	ripperCacheUnlock(cache);
+
+	return entry != NULL ? 1 : 0;
+}
+
+int ripperCDDBCacheClear(ripper_cddb_cache_t * cache)
+{
+	if(cache == NULL) {
+		return -1;
+	}
+
+	ripperCacheLock(cache);
+	int result = ripperCacheCompact(cache,0,0);
+	ripperCacheUnlock(cache);
+
+	return result;
+}
+
+int getRipperCDDBCacheCount(ripper_cddb_cache_t * cache)
+{
+	if(cache != NULL)
+		return ripperCacheHeader(cache)->count;
+	else
+		return -1;
+}
@@ -0,0 +1,300 @@
+/**
+  libripper
+
+  CRC32 and AccurateRip checksums computed on the pcm
+  stream as it is ripped.  Each kernel has a portable
+  version and x86 versions that are picked at run time
+  from the features of the cpu.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "ripper.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RIPPER_X86_KERNELS 1
+#include <immintrin.h>
+#endif
+
+//number of samples left out at the start of the first
+//track and the end of the last track by AccurateRip
+#define RIPPER_AR_SKIP_SAMPLES (5 * 588)
+
+//samples in one raw cd sector, 2 channels of 16 bits
+#define RIPPER_SAMPLES_PER_SECTOR (CDIO_CD_FRAMESIZE_RAW / 4)
+
+//slice by 8 tables for the portable crc32
+static uint32_t ripper_crc32_table[8][256];
+
+//kernels picked by ripperChecksumSelect
+static uint32_t (*ripper_crc32_kernel)(uint32_t,const unsigned char *,size_t);
+static void (*ripper_ar_kernel)(const uint32_t *,size_t,uint32_t,uint32_t *,uint32_t *);
+static pthread_once_t ripper_checksum_once = PTHREAD_ONCE_INIT;
+
+//portable crc32, eight bytes per step
+//crc is the running value without the final inversion
+static uint32_t ripperCRC32Scalar(uint32_t crc,const unsigned char * p,size_t length)
+{
+	while(length >= 8) {
+		uint32_t lo = crc ^ ((uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24);
+		uint32_t hi = (uint32_t)p[4] | (uint32_t)p[5] << 8 | (uint32_t)p[6] << 16 | (uint32_t)p[7] << 24;
+
+		crc = ripper_crc32_table[7][lo & 0xFF] ^ ripper_crc32_table[6][(lo >> 8) & 0xFF]
+			^ ripper_crc32_table[5][(lo >> 16) & 0xFF] ^ ripper_crc32_table[4][lo >> 24]
+			^ ripper_crc32_table[3][hi & 0xFF] ^ ripper_crc32_table[2][(hi >> 8) & 0xFF]
+			^ ripper_crc32_table[1][(hi >> 16) & 0xFF] ^ ripper_crc32_table[0][hi >> 24];
+		p += 8;
+		length -= 8;
+	}
+	while(length--)
+		crc = ripper_crc32_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+	return crc;
+}
+
+//portable AccurateRip sums. samples are numbered from
+//position, lo collects the low and hi the high 32 bits
+//of every sample * position product
+static void ripperAccurateRipScalar(const uint32_t * samples,size_t count,uint32_t position,uint32_t * lo,uint32_t * hi)
+{
+	uint32_t sum_lo = 0;
+	uint32_t sum_hi = 0;
+	size_t i;
+
+	for(i = 0;i < count;i++) {
+		uint64_t product = (uint64_t)samples[i] * (position + i);
+		sum_lo += (uint32_t)product;
+		sum_hi += (uint32_t)(product >> 32);
+	}
+
+	*lo += sum_lo;
+	*hi += sum_hi;
+}
+
+#ifdef RIPPER_X86_KERNELS
+
+//crc32 by folding 64 bytes at a time with carry-less
+//multiplies.  The crc32 instruction added in SSE4.2 uses
+//the Castagnoli polynomial so it can't produce the zlib
+//crc32 that EAC and AccurateRip tools report.
+//length must be a multiple of 16 and at least 64
+__attribute__((target("sse4.1,pclmul")))
+static uint32_t ripperCRC32Fold(uint32_t crc,const unsigned char * p,size_t length)
+{
+	const __m128i k1k2 = _mm_set_epi64x(0x01c6e41596,0x0154442bd4);
+	const __m128i k3k4 = _mm_set_epi64x(0x00ccaa009e,0x01751997d0);
+	const __m128i k5 = _mm_set_epi64x(0,0x0163cd6124);
+	const __m128i poly = _mm_set_epi64x(0x01f7011641,0x01db710641);
+	const __m128i mask = _mm_setr_epi32(~0,0,~0,0);
+	__m128i x1,x2,x3,x4,x5;
+
+	x1 = _mm_xor_si128(_mm_loadu_si128((const __m128i *)p),_mm_cvtsi32_si128(crc));
+	x2 = _mm_loadu_si128((const __m128i *)(p + 16));
+	x3 = _mm_loadu_si128((const __m128i *)(p + 32));
+	x4 = _mm_loadu_si128((const __m128i *)(p + 48));
+	p += 64;
+	length -= 64;
+
+	//fold four lanes of 128 bits
+	while(length >= 64) {
+		__m128i y1 = _mm_clmulepi64_si128(x1,k1k2,0x00);
+		__m128i y2 = _mm_clmulepi64_si128(x2,k1k2,0x00);
+		__m128i y3 = _mm_clmulepi64_si128(x3,k1k2,0x00);
+		__m128i y4 = _mm_clmulepi64_si128(x4,k1k2,0x00);
+
+		x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1,k1k2,0x11),y1);
+		x2 = _mm_xor_si128(_mm_clmulepi64_si128(x2,k1k2,0x11),y2);
+		x3 = _mm_xor_si128(_mm_clmulepi64_si128(x3,k1k2,0x11),y3);
+		x4 = _mm_xor_si128(_mm_clmulepi64_si128(x4,k1k2,0x11),y4);
+		x1 = _mm_xor_si128(x1,_mm_loadu_si128((const __m128i *)p));
+		x2 = _mm_xor_si128(x2,_mm_loadu_si128((const __m128i *)(p + 16)));
+		x3 = _mm_xor_si128(x3,_mm_loadu_si128((const __m128i *)(p + 32)));
+		x4 = _mm_xor_si128(x4,_mm_loadu_si128((const __m128i *)(p + 48)));
+		p += 64;
+		length -= 64;
+	}
+
+	//fold the four lanes into one
+	x5 = _mm_clmulepi64_si128(x1,k3k4,0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x2),x5);
+	x5 = _mm_clmulepi64_si128(x1,k3k4,0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x3),x5);
+	x5 = _mm_clmulepi64_si128(x1,k3k4,0x00);
+	x1 = _mm_xor_si128(_mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),x4),x5);
+
+	while(length >= 16) {
+		x5 = _mm_clmulepi64_si128(x1,k3k4,0x00);
+		x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1,k3k4,0x11),_mm_loadu_si128((const __m128i *)p));
+		x1 = _mm_xor_si128(x1,x5);
+		p += 16;
+		length -= 16;
+	}
+
+	//fold 128 bits to 64 then barrett reduce to 32
+	x2 = _mm_clmulepi64_si128(x1,k3k4,0x10);
+	x1 = _mm_xor_si128(_mm_srli_si128(x1,8),x2);
+	x2 = _mm_srli_si128(x1,4);
+	x1 = _mm_and_si128(x1,mask);
+	x1 = _mm_xor_si128(_mm_clmulepi64_si128(x1,k5,0x00),x2);
+
+	x2 = _mm_and_si128(x1,mask);
+	x2 = _mm_clmulepi64_si128(x2,poly,0x10);
+	x2 = _mm_and_si128(x2,mask);
+	x2 = _mm_clmulepi64_si128(x2,poly,0x00);
+	x1 = _mm_xor_si128(x1,x2);
+
+	return (uint32_t)_mm_extract_epi32(x1,1);
+}
+
+__attribute__((target("sse4.1,pclmul")))
+static uint32_t ripperCRC32PCLMUL(uint32_t crc,const unsigned char * p,size_t length)
+{
+	if(length >= 64) {
+		size_t folded = length & ~(size_t)15;
+		crc = ripperCRC32Fold(crc,p,folded);
+		p += folded;
+		length -= folded;
+	}
+
+	return ripperCRC32Scalar(crc,p,length);
+}
+
+//AccurateRip sums four samples at a time.  Each 32x32
+//multiply leaves a 64 bit product whose halves are summed
+//in separate 32 bit lanes, even and odd samples are
+//multiplied separately since the multiply only uses the
+//even lanes
+__attribute__((target("sse2")))
+static void ripperAccurateRipSSE2(const uint32_t * samples,size_t count,uint32_t position,uint32_t * lo,uint32_t * hi)
+{
+	__m128i positions = _mm_setr_epi32(position,position + 1,position + 2,position + 3);
+	const __m128i step = _mm_set1_epi32(4);
+	__m128i even = _mm_setzero_si128();
+	__m128i odd = _mm_setzero_si128();
+	size_t i = 0;
+
+	for(;i + 4 <= count;i += 4) {
+		__m128i s = _mm_loadu_si128((const __m128i *)(samples + i));
+
+		even = _mm_add_epi32(even,_mm_mul_epu32(s,positions));
+		odd = _mm_add_epi32(odd,_mm_mul_epu32(_mm_srli_epi64(s,32),_mm_srli_epi64(positions,32)));
+		positions = _mm_add_epi32(positions,step);
+	}
+
+	uint32_t lanes[4];
+	_mm_storeu_si128((__m128i *)lanes,_mm_add_epi32(even,odd));
+	*lo += lanes[0] + lanes[2];
+	*hi += lanes[1] + lanes[3];
+
+	ripperAccurateRipScalar(samples + i,count - i,position + i,lo,hi);
+}
+
+//AccurateRip sums eight samples at a time, see the SSE2 version
+__attribute__((target("avx2")))
+static void ripperAccurateRipAVX2(const uint32_t * samples,size_t count,uint32_t position,uint32_t * lo,uint32_t * hi)
+{
+	__m256i positions = _mm256_add_epi32(_mm256_set1_epi32(position),_mm256_setr_epi32(0,1,2,3,4,5,6,7));
+	const __m256i step = _mm256_set1_epi32(8);
+	__m256i even = _mm256_setzero_si256();
+	__m256i odd = _mm256_setzero_si256();
+	size_t i = 0;
+
+	for(;i + 8 <= count;i += 8) {
+		__m256i s = _mm256_loadu_si256((const __m256i *)(samples + i));
+
+		even = _mm256_add_epi32(even,_mm256_mul_epu32(s,positions));
+		odd = _mm256_add_epi32(odd,_mm256_mul_epu32(_mm256_srli_epi64(s,32),_mm256_srli_epi64(positions,32)));
+		positions = _mm256_add_epi32(positions,step);
+	}
+
+	uint32_t lanes[8];
+	_mm256_storeu_si256((__m256i *)lanes,_mm256_add_epi32(even,odd));
+	*lo += lanes[0] + lanes[2] + lanes[4] + lanes[6];
+	*hi += lanes[1] + lanes[3] + lanes[5] + lanes[7];
+
+	ripperAccurateRipScalar(samples + i,count - i,position + i,lo,hi);
+}
+
+#endif
+
+//builds the crc tables and picks the fastest kernels
+//the cpu supports
+static void ripperChecksumSelect(void)
+{
+	uint32_t i,j;
+
+	for(i = 0;i < 256;i++) {
+		uint32_t crc = i;
+		for(j = 0;j < 8;j++)
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+		ripper_crc32_table[0][i] = crc;
+	}
+	for(i = 0;i < 256;i++)
+		for(j = 1;j < 8;j++)
+			ripper_crc32_table[j][i] = (ripper_crc32_table[j - 1][i] >> 8) ^ ripper_crc32_table[0][ripper_crc32_table[j - 1][i] & 0xFF];
+
+	ripper_crc32_kernel = ripperCRC32Scalar;
+	ripper_ar_kernel = ripperAccurateRipScalar;
+
+#ifdef RIPPER_X86_KERNELS
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse4.1") && __builtin_cpu_supports("pclmul"))
+		ripper_crc32_kernel = ripperCRC32PCLMUL;
+	if(__builtin_cpu_supports("avx2"))
+		ripper_ar_kernel = ripperAccurateRipAVX2;
+	else if(__builtin_cpu_supports("sse2"))
+		ripper_ar_kernel = ripperAccurateRipSSE2;
+#endif
+}
+
+uint32_t ripperCRC32Update(uint32_t crc,const void * data,size_t length)
+{
+	pthread_once(&ripper_checksum_once,ripperChecksumSelect);
+
+	return ~ripper_crc32_kernel(~crc,data,length);
+}
+
+void ripperChecksumInit(ripper_checksum_state_t * state,long sectors,int firstTrack,int lastTrack)
+{
+	uint32_t samples = (uint32_t)sectors * RIPPER_SAMPLES_PER_SECTOR;
+
+	state->crc32 = 0;
+	state->ar_lo = 0;
+	state->ar_hi = 0;
+	state->position = 1;
+	state->check_start = firstTrack ? RIPPER_AR_SKIP_SAMPLES : 1;
+	state->check_end = lastTrack ? samples - RIPPER_AR_SKIP_SAMPLES : samples;
+}
+
+void ripperChecksumUpdate(ripper_checksum_state_t * state,const int16_t * pcm,long sectors)
+{
+	size_t bytes = (size_t)sectors * CDIO_CD_FRAMESIZE_RAW;
+	uint32_t count = (uint32_t)sectors * RIPPER_SAMPLES_PER_SECTOR;
+	uint32_t first = state->position;
+	uint32_t last = state->position + count - 1;
+
+	state->crc32 = ripperCRC32Update(state->crc32,pcm,bytes);
+
+	//only the part of the batch inside the AccurateRip
+	//window is summed
+	if(first < state->check_start)
+		first = state->check_start;
+	if(last > state->check_end)
+		last = state->check_end;
+	if(first <= last) {
+		const uint32_t * samples = (const uint32_t *)pcm + (first - state->position);
+		ripper_ar_kernel(samples,last - first + 1,first,&state->ar_lo,&state->ar_hi);
+	}
+
+	state->position += count;
+}
+
+void ripperChecksumFinish(const ripper_checksum_state_t * state,ripper_track_checksums_t * checksums)
+{
+	checksums->crc32 = state->crc32;
+	checksums->accuraterip_v1 = state->ar_lo;
+	checksums->accuraterip_v2 = state->ar_lo + state->ar_hi;
+	checksums->valid = 1;
+}
@@ -0,0 +1,377 @@
+/**
+  libripper
+
+  Sink encoding the ripped audio to flac.
+
+  The read loop only copies each batch into a queue, the
+  encoding happens on the sink's own threads.  Every track
+  is its own flac stream so while one thread is still
+  compressing the end of a track the next one can start on
+  the following track, and the drive never waits on the
+  encoder unless the queue is full.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <FLAC/stream_encoder.h>
+#include "ripper.h"
+
+//samples in one raw cd sector, 2 channels of 16 bits
+#define RIPPER_SAMPLES_PER_SECTOR (CDIO_CD_FRAMESIZE_RAW / 4)
+
+//one batch of pcm waiting to be encoded
+typedef struct ripper_flac_chunk_t {
+	struct ripper_flac_chunk_t * next;
+	long sectors;
+	long capacity;
+	int16_t pcm[];
+} ripper_flac_chunk_t;
+
+//one track being encoded
+typedef struct ripper_flac_stream_t {
+	struct ripper_flac_stream_t * next;
+	FLAC__StreamEncoder * encoder;
+	char * filename;
+	ripper_flac_chunk_t * head;
+	ripper_flac_chunk_t * tail;
+	//set by end, status is the rip's status for the track
+	//until the encoder has finished with it
+	int closed;
+	int status;
+} ripper_flac_stream_t;
+
+typedef struct ripper_flac_sink_t {
+	ripper_sink_t sink;
+	char * filename;
+	int pattern;
+	unsigned int compression;
+	//workers encoding streams and the threads libFLAC gives
+	//each stream, the two multiply to the sink's threads
+	unsigned int numThreads;
+	unsigned int encoderThreads;
+	pthread_t * threads;
+	pthread_mutex_t lock;
+	pthread_cond_t changed;
+	//streams waiting for a thread, the stream receiving
+	//batches and the number not finished yet
+	ripper_flac_stream_t * pending;
+	ripper_flac_stream_t * current;
+	int active;
+	//chunks ready for reuse and the bytes queued
+	ripper_flac_chunk_t * spare;
+	size_t queued;
+	size_t max_queued;
+	int stopping;
+	int failed;
+} ripper_flac_sink_t;
+
+//encodes one chunk, samples are converted to the 32 bit
+//samples libFLAC takes in place of a second buffer
+//returns 1 on success and -1 on error
+static int ripperFLACEncodeChunk(ripper_flac_stream_t * stream,FLAC__int32 ** samples,long * size,const ripper_flac_chunk_t * chunk)
+{
+	long count = chunk->sectors * RIPPER_SAMPLES_PER_SECTOR * 2;
+	long i;
+
+	if(*size < count) {
+		FLAC__int32 * grown = realloc(*samples,sizeof(FLAC__int32) * count);
+		if(grown == NULL)
+			return -1;
+		*samples = grown;
+		*size = count;
+	}
+
+	for(i = 0;i < count;i++)
+		(*samples)[i] = chunk->pcm[i];
+
+	if(!FLAC__stream_encoder_process_interleaved(stream->encoder,*samples,count / 2))
+		return -1;
+
+	return 1;
+}
+
+static void ripperFLACFreeStream(ripper_flac_stream_t * stream)
+{
+	if(stream->encoder != NULL)
+		FLAC__stream_encoder_delete(stream->encoder);
+	free(stream->filename);
+	free(stream);
+}
+
+static void * ripperFLACWorker(void * arg)
+{
+	ripper_flac_sink_t * flac = arg;
+	FLAC__int32 * samples = NULL;
+	long size = 0;
+
+	pthread_mutex_lock(&flac->lock);
+	for(;;) {
+		while(flac->pending == NULL && !flac->stopping)
+			pthread_cond_wait(&flac->changed,&flac->lock);
+		if(flac->pending == NULL)
+			break;
+
+		ripper_flac_stream_t * stream = flac->pending;
+		flac->pending = stream->next;
+		int status = 1;
+
+		//encode the chunks as they arrive until the track
+		//has been closed and drained
+		for(;;) {
+			while(stream->head == NULL && !stream->closed)
+				pthread_cond_wait(&flac->changed,&flac->lock);
+
+			ripper_flac_chunk_t * chunk = stream->head;
+			if(chunk == NULL)
+				break;
+			stream->head = chunk->next;
+			if(stream->head == NULL)
+				stream->tail = NULL;
+			//a failed rip only needs its queue emptied
+			int skip = status == -1 || stream->status == -1;
+			pthread_mutex_unlock(&flac->lock);
+
+			if(!skip && ripperFLACEncodeChunk(stream,&samples,&size,chunk) == -1)
+				status = -1;
+
+			pthread_mutex_lock(&flac->lock);
+			flac->queued -= CDIO_CD_FRAMESIZE_RAW * chunk->capacity;
+			chunk->next = flac->spare;
+			flac->spare = chunk;
+			pthread_cond_broadcast(&flac->changed);
+		}
+		if(stream->status == -1)
+			status = -1;
+		pthread_mutex_unlock(&flac->lock);
+
+		if(!FLAC__stream_encoder_finish(stream->encoder))
+			status = -1;
+		//don't leave a partial track behind
+		if(status == -1)
+			unlink(stream->filename);
+
+		pthread_mutex_lock(&flac->lock);
+		if(status == -1 && stream->status != -1) {
+			printf("Error: Unable to encode %s.\n",stream->filename);
+			flac->failed = 1;
+		}
+		ripperFLACFreeStream(stream);
+		flac->active--;
+		pthread_cond_broadcast(&flac->changed);
+	}
+	pthread_mutex_unlock(&flac->lock);
+
+	free(samples);
+
+	return NULL;
+}
+
+static int ripperFLACSinkBegin(ripper_sink_t * sink,const ripper_span_t * span)
+{
+	ripper_flac_sink_t * flac = sink->data;
+	char filename[FILENAME_MAX];
+
+	if(flac->pattern)
+		snprintf(filename,sizeof(filename),flac->filename,span->track);
+	else
+		snprintf(filename,sizeof(filename),"%s",flac->filename);
+
+	ripper_flac_stream_t * stream = calloc(1,sizeof(ripper_flac_stream_t));
+	if(stream == NULL || (stream->filename = strdup(filename)) == NULL) {
+		printf("Error: Unable to allocate memory for the flac stream.\n");
+		free(stream);
+		return -1;
+	}
+
+	stream->encoder = FLAC__stream_encoder_new();
+	if(stream->encoder == NULL) {
+		printf("Error: Unable to allocate memory for the flac encoder.\n");
+		ripperFLACFreeStream(stream);
+		return -1;
+	}
+	FLAC__stream_encoder_set_channels(stream->encoder,NUM_CHANNELS);
+	FLAC__stream_encoder_set_bits_per_sample(stream->encoder,BITS_PER_SAMPLE);
+	FLAC__stream_encoder_set_sample_rate(stream->encoder,SAMPLE_RATE);
+	FLAC__stream_encoder_set_compression_level(stream->encoder,flac->compression);
+#if defined(FLAC_API_VERSION_CURRENT) && FLAC_API_VERSION_CURRENT >= 14
+	//libFLAC 1.5 can also split one stream over threads,
+	//which keeps every thread busy on a single track rip
+	FLAC__stream_encoder_set_num_threads(stream->encoder,flac->encoderThreads);
+#endif
+	FLAC__stream_encoder_set_total_samples_estimate(stream->encoder,
+		(FLAC__uint64)(span->last - span->first + 1) * RIPPER_SAMPLES_PER_SECTOR);
+
+	if(FLAC__stream_encoder_init_file(stream->encoder,filename,NULL,NULL) != FLAC__STREAM_ENCODER_INIT_STATUS_OK) {
+		printf("Error: Unable to open file %s for writing.\n",filename);
+		ripperFLACFreeStream(stream);
+		return -1;
+	}
+
+	pthread_mutex_lock(&flac->lock);
+	ripper_flac_stream_t ** last = &flac->pending;
+	while(*last != NULL)
+		last = &(*last)->next;
+	*last = stream;
+	flac->current = stream;
+	flac->active++;
+	pthread_cond_broadcast(&flac->changed);
+	pthread_mutex_unlock(&flac->lock);
+
+	return 1;
+}
+
+static int ripperFLACSinkWrite(ripper_sink_t * sink,const int16_t * buffer,long count)
+{
+	ripper_flac_sink_t * flac = sink->data;
+
+	pthread_mutex_lock(&flac->lock);
+	//keep the drive from running too far ahead of the encoders
+	while(flac->queued > 0 && flac->queued + CDIO_CD_FRAMESIZE_RAW * count > flac->max_queued)
+		pthread_cond_wait(&flac->changed,&flac->lock);
+
+	ripper_flac_chunk_t * chunk = flac->spare;
+	if(chunk != NULL && chunk->capacity >= count) {
+		flac->spare = chunk->next;
+	} else {
+		chunk = malloc(sizeof(ripper_flac_chunk_t) + (size_t)CDIO_CD_FRAMESIZE_RAW * count);
+		if(chunk == NULL) {
+			pthread_mutex_unlock(&flac->lock);
+			printf("Error: Unable to allocate memory for the flac queue.\n");
+			return -1;
+		}
+		chunk->capacity = count;
+	}
+	flac->queued += CDIO_CD_FRAMESIZE_RAW * chunk->capacity;
+	pthread_mutex_unlock(&flac->lock);
+
+	memcpy(chunk->pcm,buffer,(size_t)CDIO_CD_FRAMESIZE_RAW * count);
+	chunk->sectors = count;
+	chunk->next = NULL;
+
+	pthread_mutex_lock(&flac->lock);
+	ripper_flac_stream_t * stream = flac->current;
+	if(stream->tail != NULL)
+		stream->tail->next = chunk;
+	else
+		stream->head = chunk;
+	stream->tail = chunk;
+	pthread_cond_broadcast(&flac->changed);
+	pthread_mutex_unlock(&flac->lock);
+
+	return 1;
+}
+
+//the track is finished in the background, errors from
+//the encoder are returned by flush
+static int ripperFLACSinkEnd(ripper_sink_t * sink,int status)
+{
+	ripper_flac_sink_t * flac = sink->data;
+
+	pthread_mutex_lock(&flac->lock);
+	flac->current->closed = 1;
+	flac->current->status = status;
+	flac->current = NULL;
+	pthread_cond_broadcast(&flac->changed);
+	pthread_mutex_unlock(&flac->lock);
+
+	return status;
+}
+
+static int ripperFLACSinkFlush(ripper_sink_t * sink)
+{
+	ripper_flac_sink_t * flac = sink->data;
+
+	pthread_mutex_lock(&flac->lock);
+	while(flac->active > 0)
+		pthread_cond_wait(&flac->changed,&flac->lock);
+	int failed = flac->failed;
+	flac->failed = 0;
+	pthread_mutex_unlock(&flac->lock);
+
+	return failed ? -1 : 1;
+}
+
+static void ripperFLACSinkDestroy(ripper_sink_t * sink)
+{
+	ripper_flac_sink_t * flac = sink->data;
+	unsigned int i;
+
+	ripperFLACSinkFlush(sink);
+
+	pthread_mutex_lock(&flac->lock);
+	flac->stopping = 1;
+	pthread_cond_broadcast(&flac->changed);
+	pthread_mutex_unlock(&flac->lock);
+	for(i = 0;i < flac->numThreads;i++)
+		pthread_join(flac->threads[i],NULL);
+
+	while(flac->spare != NULL) {
+		ripper_flac_chunk_t * chunk = flac->spare;
+		flac->spare = chunk->next;
+		free(chunk);
+	}
+	pthread_cond_destroy(&flac->changed);
+	pthread_mutex_destroy(&flac->lock);
+	free(flac->threads);
+	free(flac->filename);
+	free(flac);
+}
+
+ripper_sink_t * ripperFLACSinkInit(const char * filename,int pattern,unsigned int compression,unsigned int threads)
+{
+	if(filename == NULL) {
+		printf("Error: No filename was specified.\n");
+		return NULL;
+	}
+
+	if(threads == 0) {
+		long processors = sysconf(_SC_NPROCESSORS_ONLN);
+		threads = processors > 0 ? processors : 1;
+	}
+	if(compression > 8)
+		compression = 8;
+
+	ripper_flac_sink_t * flac = calloc(1,sizeof(ripper_flac_sink_t));
+	if(flac == NULL) {
+		printf("Error: Unable to allocate memory for the flac sink.\n");
+		return NULL;
+	}
+	//a single file is one stream, its threads go to libFLAC.
+	//separate tracks are spread over the workers instead
+	unsigned int workers = pattern ? threads : 1;
+	flac->encoderThreads = pattern ? 1 : threads;
+	flac->filename = strdup(filename);
+	flac->threads = calloc(sizeof(pthread_t),workers);
+	if(flac->filename == NULL || flac->threads == NULL) {
+		printf("Error: Unable to allocate memory for the flac sink.\n");
+		free(flac->filename);
+		free(flac->threads);
+		free(flac);
+		return NULL;
+	}
+	flac->pattern = pattern;
+	flac->compression = compression;
+	flac->max_queued = RIPPER_FLAC_QUEUE_BYTES * threads;
+	pthread_mutex_init(&flac->lock,NULL);
+	pthread_cond_init(&flac->changed,NULL);
+
+	flac->sink.begin = ripperFLACSinkBegin;
+	flac->sink.write = ripperFLACSinkWrite;
+	flac->sink.end = ripperFLACSinkEnd;
+	flac->sink.data = flac;
+	flac->sink.flush = ripperFLACSinkFlush;
+	flac->sink.destroy = ripperFLACSinkDestroy;
+
+	for(flac->numThreads = 0;flac->numThreads < workers;flac->numThreads++) {
+		if(pthread_create(&flac->threads[flac->numThreads],NULL,ripperFLACWorker,flac) != 0) {
+			printf("Error: Unable to start the flac encoder.\n");
+			ripperFLACSinkDestroy(&flac->sink);
+			return NULL;
+		}
+	}
+
+	return &flac->sink;
+}
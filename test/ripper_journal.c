@@ -0,0 +1,243 @@
+/**
+  libripper
+
+  Journal of interrupted rips.
+
+  The journal is one file per disc.  It starts with a
+  header naming the disc by a hash of its track layout and
+  is followed by fixed size records appended as a rip goes.
+  Every record is synced before the rip moves on, so after
+  a crash the journal holds at most one torn record at its
+  end.  Reading stops at the first record that fails its
+  checks and the rest of the file is cut off, the record
+  before it is the last checkpoint that reached the disk.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "ripper.h"
+
+//"RPJL" in a little endian file
+#define RIPPER_JOURNAL_MAGIC 0x4C4A5052
+//2 added the identity of flac files to the records
+#define RIPPER_JOURNAL_VERSION 2
+//marks every record, "RPJR"
+#define RIPPER_JOURNAL_RECORD_MAGIC 0x524A5052
+
+//start of the journal file
+typedef struct ripper_journal_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t tracks;
+	uint32_t reserved;
+	uint64_t toc_hash;
+} ripper_journal_header_t;
+
+//hash of the first and last sector of every track, a
+//journal is only used for the disc it was written for
+static uint64_t ripperJournalTocHash(ripper_cd_data_t * ripper)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	unsigned int i;
+
+	hash = (hash ^ ripper->totalTracks) * 0x100000001b3ULL;
+	for(i = 1;i <= ripper->totalTracks;i++) {
+		hash = (hash ^ (uint32_t)ripper->toc[i - 1].first) * 0x100000001b3ULL;
+		hash = (hash ^ (uint32_t)ripper->toc[i - 1].last) * 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+uint64_t ripperJournalOutputId(const char * path,uint32_t kind)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for(;*path != '\0';path++)
+		hash = (hash ^ (unsigned char)*path) * 0x100000001b3ULL;
+	hash = (hash ^ kind) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+static uint32_t ripperJournalRecordCRC(const ripper_journal_record_t * record)
+{
+	return ripperCRC32Update(0,record,offsetof(ripper_journal_record_t,crc));
+}
+
+//replaces the in memory record of the track and output
+//returns 1 on success and -1 on error
+static int ripperJournalKeep(ripper_journal_t * journal,const ripper_journal_record_t * record)
+{
+	ripper_journal_record_t * found = (ripper_journal_record_t *)ripperJournalFind(journal,record->track,record->output);
+
+	if(found == NULL) {
+		if(journal->numRecords == journal->sizeRecords) {
+			int size = journal->sizeRecords == 0 ? 16 : journal->sizeRecords * 2;
+			ripper_journal_record_t * records = realloc(journal->records,size * sizeof(ripper_journal_record_t));
+			if(records == NULL)
+				return -1;
+			journal->records = records;
+			journal->sizeRecords = size;
+		}
+		found = &journal->records[journal->numRecords++];
+	}
+	*found = *record;
+
+	return 1;
+}
+
+//reads the records that made it to disk and cuts off
+//anything after the last good one
+//returns 1 on success and -1 on error
+static int ripperJournalLoad(ripper_journal_t * journal,unsigned int tracks)
+{
+	off_t end = sizeof(ripper_journal_header_t);
+	ripper_journal_record_t record;
+
+	while(pread(journal->fd,&record,sizeof(record),end) == sizeof(record)) {
+		if(record.magic != RIPPER_JOURNAL_RECORD_MAGIC
+			|| record.crc != ripperJournalRecordCRC(&record)
+			|| record.track < 1 || record.track > tracks
+			|| (record.type != RIPPER_JOURNAL_PROGRESS && record.type != RIPPER_JOURNAL_COMPLETE))
+			break;
+		if(ripperJournalKeep(journal,&record) == -1)
+			return -1;
+		end += sizeof(record);
+	}
+
+	if(ftruncate(journal->fd,end) == -1 || lseek(journal->fd,end,SEEK_SET) == -1)
+		return -1;
+
+	return 1;
+}
+
+int setRipperJournal(ripper_cd_data_t * ripper, const char * path)
+{
+	if(ripper == NULL) {
+		return -1;
+	}
+
+	ripperJournalClose(ripper->journal);
+	ripper->journal = NULL;
+	if(path == NULL) {
+		return 1;
+	}
+
+	ripper_journal_t * journal = calloc(sizeof(ripper_journal_t),1);
+	if(journal == NULL) {
+		printf("Error: Unable to allocate memory for the rip journal.\n");
+		return -1;
+	}
+	journal->fd = -1;
+	journal->toc_hash = ripperJournalTocHash(ripper);
+
+	journal->path = malloc(strlen(path) + 1);
+	if(journal->path == NULL) {
+		printf("Error: Unable to allocate memory for the rip journal.\n");
+		ripperJournalClose(journal);
+		return -1;
+	}
+	strcpy(journal->path,path);
+
+	journal->fd = open(path,O_RDWR | O_CREAT | O_CLOEXEC,0644);
+	if(journal->fd == -1) {
+		printf("Error: Unable to open the rip journal %s.\n",path);
+		ripperJournalClose(journal);
+		return -1;
+	}
+
+	ripper_journal_header_t existing;
+	int valid = pread(journal->fd,&existing,sizeof(existing),0) == sizeof(existing)
+		&& existing.magic == RIPPER_JOURNAL_MAGIC && existing.version == RIPPER_JOURNAL_VERSION
+		&& existing.tracks == ripper->totalTracks && existing.toc_hash == journal->toc_hash;
+
+	//a journal of another disc, or anything else found in
+	//the file, is replaced with an empty journal
+	if(valid) {
+		valid = ripperJournalLoad(journal,ripper->totalTracks);
+	} else {
+		ripper_journal_header_t header;
+		memset(&header,0,sizeof(header));
+		header.magic = RIPPER_JOURNAL_MAGIC;
+		header.version = RIPPER_JOURNAL_VERSION;
+		header.tracks = ripper->totalTracks;
+		header.toc_hash = journal->toc_hash;
+
+		valid = ftruncate(journal->fd,0) == 0
+			&& pwrite(journal->fd,&header,sizeof(header),0) == sizeof(header)
+			&& lseek(journal->fd,sizeof(header),SEEK_SET) != -1
+			&& fdatasync(journal->fd) == 0 ? 1 : -1;
+	}
+	if(valid == -1) {
+		printf("Error: Unable to read the rip journal %s.\n",path);
+		ripperJournalClose(journal);
+		return -1;
+	}
+
+	ripper->journal = journal;
+
+	return 1;
+}
+
+void ripperJournalClose(ripper_journal_t * journal)
+{
+	if(journal != NULL) {
+		if(journal->fd != -1)
+			close(journal->fd);
+		free(journal->records);
+		free(journal->path);
+		free(journal);
+	}
+}
+
+const ripper_journal_record_t * ripperJournalFind(const ripper_journal_t * journal,int track,uint64_t output)
+{
+	int i;
+
+	for(i = 0;i < journal->numRecords;i++) {
+		if(journal->records[i].track == (uint32_t)track && journal->records[i].output == output)
+			return &journal->records[i];
+	}
+
+	return NULL;
+}
+
+int ripperJournalAppend(ripper_journal_t * journal,ripper_journal_record_t * record)
+{
+	const unsigned char * bytes = (const unsigned char *)record;
+	off_t end = lseek(journal->fd,0,SEEK_CUR);
+	size_t done = 0;
+
+	if(end == -1)
+		return -1;
+
+	record->magic = RIPPER_JOURNAL_RECORD_MAGIC;
+	record->reserved = 0;
+	record->crc = ripperJournalRecordCRC(record);
+
+	while(done < sizeof(*record)) {
+		ssize_t written = write(journal->fd,bytes + done,sizeof(*record) - done);
+		if(written == -1 && errno == EINTR)
+			continue;
+		if(written <= 0)
+			break;
+		done += written;
+	}
+	//a record only partly written would hide the ones
+	//appended after it
+	if(done < sizeof(*record) || fdatasync(journal->fd) == -1) {
+		if(ftruncate(journal->fd,end) == 0)
+			lseek(journal->fd,end,SEEK_SET);
+		return -1;
+	}
+
+	return ripperJournalKeep(journal,record);
+}
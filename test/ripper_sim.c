@@ -0,0 +1,646 @@
+/**
+  libripper
+
+  Simulated cd drive.
+
+  The simulator is a cdrom_drive_t whose read_audio and
+  set_speed hooks are answered from memory, so paranoia and
+  the rest of the ripper run on it unchanged through
+  ripperInitDrive.  Every sample on the disc is a hash of
+  its position and the seed, so a rip can be checked
+  against ripperSimFillSector without keeping a reference
+  copy.  Faults are scheduled on sector ranges and can wear
+  off after a number of reads, the way a marginal sector
+  reads back correctly on a retry.  Time is kept on a
+  virtual clock, the simulator only sleeps when asked to,
+  so throughput is reproducible on any machine.
+
+  A trace records every read a real drive was asked for
+  with its result, time taken and a checksum of the data.
+  A replayed trace gives the same results and times back
+  for the same reads and corrupts the data wherever the
+  real drive returned different data for a reread.
+
+  The q subchannel gives the track and index of every
+  sector from the pregaps set on the disc.  Like on a real
+  disc one frame in a hundred carries the catalog number
+  in place of the position.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include "ripper.h"
+
+//"RPST" in a little endian file
+#define RIPPER_SIM_TRACE_MAGIC 0x54535052
+#define RIPPER_SIM_TRACE_VERSION 1
+
+//records looked through to match a replayed read, rereads
+//by paranoia stay well within this
+#define RIPPER_SIM_TRACE_WINDOW 64
+
+//samples of one raw cd sector, 2 channels of 16 bits
+#define RIPPER_SIM_SAMPLES_PER_SECTOR (CDIO_CD_FRAMESIZE_RAW / 4)
+
+//fastest speed of a new simulator and the sectors it
+//reads per command, as a common drive would
+#define RIPPER_SIM_DEFAULT_MAX_SPEED 48
+#define RIPPER_SIM_SECTORS_PER_READ 26
+
+//every this many sectors a q frame holds no position
+#define RIPPER_SIM_Q_CATALOG 100
+
+//start of a trace file
+typedef struct ripper_sim_trace_header_t {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t reserved;
+} ripper_sim_trace_header_t;
+
+//drive handed to libcdio, the simulator is found from the
+//drive in the hooks
+typedef struct ripper_sim_drive_t {
+	cdrom_drive_t drive;
+	ripper_sim_t * sim;
+} ripper_sim_drive_t;
+
+//read_audio of a real drive being recorded
+struct ripper_sim_recorder_t {
+	cdrom_drive_t * drive;
+	long (*read_audio)(cdrom_drive_t *,void *,lsn_t,long);
+	FILE * fp;
+	pthread_mutex_t lock;
+	struct ripper_sim_recorder_t * next;
+};
+
+//recorders are found from the drive in the read hook
+static ripper_sim_recorder_t * ripper_sim_recorders;
+static pthread_mutex_t ripper_sim_recorders_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t ripperSimNow(void)
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+//sample n of the disc counting from the start of the
+//program area
+static uint32_t ripperSimSample(uint32_t seed,int64_t n)
+{
+	uint64_t x = (uint64_t)n * 0x9E3779B97F4A7C15ULL + seed;
+
+	x ^= x >> 31;
+	x *= 0xBF58476D1CE4E5B9ULL;
+	x ^= x >> 29;
+
+	return (uint32_t)x;
+}
+
+//fills count samples starting at sample n
+static void ripperSimFill(const ripper_sim_t * sim,int64_t n,uint32_t * samples,long count)
+{
+	long i;
+
+	for(i = 0;i < count;i++)
+		samples[i] = ripperSimSample(sim->seed,n + i);
+}
+
+void ripperSimFillSector(const ripper_sim_t * sim,lsn_t sector,int16_t * pcm)
+{
+	ripperSimFill(sim,(int64_t)sector * RIPPER_SIM_SAMPLES_PER_SECTOR,(uint32_t *)pcm,RIPPER_SIM_SAMPLES_PER_SECTOR);
+}
+
+//flips bits of the sector the way a scratch garbles it,
+//hit makes every read of the sector come back different
+static void ripperSimCorrupt(unsigned char * sector,lsn_t lsn,int hit)
+{
+	uint32_t x = ripperSimSample((uint32_t)hit,lsn);
+	int i;
+
+	for(i = 0;i < 16;i++) {
+		sector[(x >> 5) % CDIO_CD_FRAMESIZE_RAW] ^= 1 << (x & 7);
+		x = x * 1664525 + 1013904223;
+	}
+}
+
+//sleeps for ns when the simulator runs in real time
+static void ripperSimWait(ripper_sim_t * sim,uint64_t ns)
+{
+	if(sim->realtime && ns > 0) {
+		struct timespec wait = { ns / 1000000000ULL, ns % 1000000000ULL };
+		while(nanosleep(&wait,&wait) == -1 && errno == EINTR)
+			;
+	}
+}
+
+//result of a replayed read. the record matching the read
+//is searched for from the current position, the data is
+//garbled when the drive returned something else the last
+//time the same read returned as many sectors
+//returns the sectors read, -1 for an error or -2 when the
+//trace has no such read
+static long ripperSimReplay(ripper_sim_t * sim,lsn_t begin,long sectors,int * unstable,uint64_t * ns)
+{
+	long i;
+	long end = sim->trace_pos + RIPPER_SIM_TRACE_WINDOW;
+
+	if(end > sim->numTrace)
+		end = sim->numTrace;
+	for(i = sim->trace_pos;i < end;i++) {
+		const ripper_sim_trace_read_t * read = &sim->trace[i];
+		if(read->begin != begin || read->sectors != sectors)
+			continue;
+
+		long j;
+		*unstable = 0;
+		for(j = i > RIPPER_SIM_TRACE_WINDOW ? i - RIPPER_SIM_TRACE_WINDOW : 0;j < i;j++) {
+			if(sim->trace[j].begin == begin && sim->trace[j].sectors == sectors
+				&& sim->trace[j].result == read->result)
+				*unstable = sim->trace[j].crc != read->crc;
+		}
+		*ns = read->ns;
+		sim->trace_pos = i + 1;
+		return read->result;
+	}
+
+	sim->trace_misses++;
+	return -2;
+}
+
+static long ripperSimReadAudio(cdrom_drive_t * d,void * p,lsn_t begin,long sectors)
+{
+	ripper_sim_t * sim = ((ripper_sim_drive_t *)d)->sim;
+	unsigned char * buffer = p;
+	long result = sectors;
+	int64_t shift = 0;
+	uint64_t latency = 0;
+	int replayed = 0;
+	int unstable = 0;
+	long i;
+	int f;
+
+	pthread_mutex_lock(&sim->lock);
+	sim->reads++;
+
+	//a replayed read keeps the result and time of the
+	//recorded one, the schedule still applies on top
+	if(sim->trace != NULL) {
+		uint64_t ns = 0;
+		long traced = ripperSimReplay(sim,begin,sectors,&unstable,&ns);
+		if(traced != -2) {
+			result = traced < sectors ? traced : sectors;
+			latency = ns;
+			replayed = 1;
+		}
+	}
+
+	//a fault wears off once it has spoilt as many reads as
+	//its reads count, 0 keeps it for good
+	for(f = 0;f < sim->numFaults;f++) {
+		ripper_sim_fault_t * fault = &sim->faults[f];
+		fault->active = fault->last >= begin && fault->first < begin + sectors
+			&& (fault->reads == 0 || fault->hits < fault->reads);
+		if(!fault->active)
+			continue;
+		fault->hits++;
+
+		switch(fault->type) {
+			case RIPPER_SIM_READ_ERROR:
+				if(result > 0 && fault->first - begin < result)
+					result = fault->first > begin ? fault->first - begin : -1;
+				break;
+			case RIPPER_SIM_JITTER:
+				shift += fault->amount;
+				break;
+			case RIPPER_SIM_LATENCY:
+				latency += (uint64_t)fault->amount * 1000;
+				break;
+			default:
+				break;
+		}
+	}
+
+	//the data the drive returns, jitter moves the whole
+	//read and every dropped sector moves the rest of it
+	for(i = 0;i < result;i++) {
+		lsn_t lsn = begin + i;
+		int corrupt = 0;
+
+		for(f = 0;f < sim->numFaults;f++) {
+			const ripper_sim_fault_t * fault = &sim->faults[f];
+			if(!fault->active || lsn < fault->first || lsn > fault->last)
+				continue;
+			if(fault->type == RIPPER_SIM_DROP)
+				shift += RIPPER_SIM_SAMPLES_PER_SECTOR;
+			else if(fault->type == RIPPER_SIM_CORRUPT)
+				corrupt = fault->hits;
+		}
+
+		ripperSimFill(sim,(int64_t)lsn * RIPPER_SIM_SAMPLES_PER_SECTOR + shift,
+			(uint32_t *)(buffer + i * CDIO_CD_FRAMESIZE_RAW),RIPPER_SIM_SAMPLES_PER_SECTOR);
+		if(corrupt)
+			ripperSimCorrupt(buffer + i * CDIO_CD_FRAMESIZE_RAW,lsn,corrupt);
+		if(unstable)
+			ripperSimCorrupt(buffer + i * CDIO_CD_FRAMESIZE_RAW,lsn,(int)sim->reads);
+	}
+
+	if(result < 0)
+		sim->failed_reads++;
+	else
+		sim->sectors_read += result;
+
+	//a drive at speed x reads x sectors in the time one
+	//takes at single speed
+	if(!replayed && result > 0)
+		latency += (uint64_t)sim->sector_ns * result / (sim->speed > 0 ? sim->speed : 1);
+	sim->elapsed_ns += latency;
+	pthread_mutex_unlock(&sim->lock);
+
+	ripperSimWait(sim,latency);
+
+	return result;
+}
+
+static int ripperSimSetSpeed(cdrom_drive_t * d,int speed)
+{
+	ripper_sim_t * sim = ((ripper_sim_drive_t *)d)->sim;
+
+	pthread_mutex_lock(&sim->lock);
+	if(speed <= 0 || speed > sim->max_speed)
+		speed = sim->max_speed;
+	sim->speed = speed;
+	sim->speed_changes++;
+	pthread_mutex_unlock(&sim->lock);
+
+	return 0;
+}
+
+static int ripperSimEnableCDDA(cdrom_drive_t * d,int onoff)
+{
+	return 0;
+}
+
+static int ripperSimReadTOC(cdrom_drive_t * d)
+{
+	return d->tracks;
+}
+
+ripper_sim_t * ripperSimCreate(const lsn_t * trackStarts,int numTracks,lsn_t leadout,uint32_t seed)
+{
+	int i;
+
+	if(trackStarts == NULL || numTracks < 1 || numTracks > CDIO_CD_MAX_TRACKS) {
+		return NULL;
+	}
+	for(i = 0;i < numTracks;i++) {
+		if(trackStarts[i] < 0 || trackStarts[i] >= (i + 1 < numTracks ? trackStarts[i + 1] : leadout)) {
+			printf("Error: Track %d of the simulated disc is out of order.\n",i + 1);
+			return NULL;
+		}
+	}
+
+	ripper_sim_t * sim = calloc(sizeof(ripper_sim_t),1);
+	ripper_sim_drive_t * simDrive = calloc(sizeof(ripper_sim_drive_t),1);
+	lsn_t * pregaps = malloc(sizeof(lsn_t) * numTracks);
+	if(sim == NULL || simDrive == NULL || pregaps == NULL) {
+		printf("Error: Unable to allocate memory for the simulated drive.\n");
+		free(sim);
+		free(simDrive);
+		free(pregaps);
+		return NULL;
+	}
+	//tracks start without a pregap, the one of the first
+	//track runs from the start of the disc
+	memcpy(pregaps,trackStarts,sizeof(lsn_t) * numTracks);
+	pregaps[0] = 0;
+	sim->pregaps = pregaps;
+	pthread_mutex_init(&sim->lock,NULL);
+	sim->seed = seed;
+	sim->max_speed = RIPPER_SIM_DEFAULT_MAX_SPEED;
+	sim->speed = sim->max_speed;
+
+	//the drive looks like an opened mmc drive holding an
+	//audio cd with the inputed layout
+	cdrom_drive_t * drive = &simDrive->drive;
+	simDrive->sim = sim;
+	drive->opened = 1;
+	drive->is_mmc = 1;
+	drive->nsectors = RIPPER_SIM_SECTORS_PER_READ;
+	drive->tracks = numTracks;
+	for(i = 0;i < numTracks;i++) {
+		drive->disc_toc[i].bTrack = i + 1;
+		drive->disc_toc[i].dwStartSector = trackStarts[i];
+	}
+	drive->disc_toc[numTracks].bTrack = CDIO_CDROM_LEADOUT_TRACK;
+	drive->disc_toc[numTracks].dwStartSector = leadout;
+	drive->audio_first_sector = trackStarts[0];
+	drive->audio_last_sector = leadout - 1;
+	drive->errordest = CDDA_MESSAGE_FORGETIT;
+	drive->messagedest = CDDA_MESSAGE_FORGETIT;
+	//samples are generated in the host's byte order
+	uint16_t order = 1;
+	drive->bigendianp = *(unsigned char *)&order == 0;
+	drive->enable_cdda = ripperSimEnableCDDA;
+	drive->read_toc = ripperSimReadTOC;
+	drive->read_audio = ripperSimReadAudio;
+	drive->set_speed = ripperSimSetSpeed;
+	sim->drive = drive;
+
+	return sim;
+}
+
+ripper_sim_t * ripperSimDestroy(ripper_sim_t * sim)
+{
+	if(sim != NULL) {
+		free(sim->faults);
+		free(sim->trace);
+		free(sim->pregaps);
+		pthread_mutex_destroy(&sim->lock);
+		free((ripper_sim_drive_t *)sim->drive);
+		free(sim);
+	}
+
+	return NULL;
+}
+
+//answers the q subchannel of the sector from the layout of
+//the disc
+static int ripperSimReadQ(void * arg,lsn_t sector,ripper_subchannel_q_t * q)
+{
+	ripper_sim_t * sim = arg;
+	cdrom_drive_t * drive = sim->drive;
+	int track = 0;
+
+	if(sector < 0 || sector >= drive->disc_toc[drive->tracks].dwStartSector)
+		return -1;
+
+	pthread_mutex_lock(&sim->lock);
+	sim->q_reads++;
+	pthread_mutex_unlock(&sim->lock);
+
+	if(sector % RIPPER_SIM_Q_CATALOG == RIPPER_SIM_Q_CATALOG - 1)
+		return 0;
+	while(track + 1 < drive->tracks && sim->pregaps[track + 1] <= sector)
+		track++;
+	q->track = track + 1;
+	q->index = sector < drive->disc_toc[track].dwStartSector ? 0 : 1;
+
+	return 1;
+}
+
+ripper_cd_data_t * ripperInitSim(ripper_sim_t * sim)
+{
+	if(sim == NULL) {
+		return NULL;
+	}
+
+	ripper_cd_data_t * ripper = ripperInitDrive(sim->drive);
+	if(ripper != NULL) {
+		ripper->read_q = ripperSimReadQ;
+		ripper->read_q_arg = sim;
+	}
+
+	return ripper;
+}
+
+int ripperSimSetPregap(ripper_sim_t * sim,int trackNum,lsn_t sectors)
+{
+	if(sim == NULL || trackNum < 2 || trackNum > sim->drive->tracks || sectors < 0) {
+		return -1;
+	}
+
+	lsn_t start = sim->drive->disc_toc[trackNum - 1].dwStartSector;
+	if(start - sectors <= sim->drive->disc_toc[trackNum - 2].dwStartSector) {
+		return -1;
+	}
+	sim->pregaps[trackNum - 1] = start - sectors;
+
+	return 1;
+}
+
+int ripperSimSetDataTrack(ripper_sim_t * sim,int trackNum)
+{
+	if(sim == NULL || trackNum < 1 || trackNum > sim->drive->tracks) {
+		return -1;
+	}
+
+	//the control field of a data track, as read from the toc
+	sim->drive->disc_toc[trackNum - 1].bFlags |= 0x04;
+
+	return 1;
+}
+
+void ripperSimSetTiming(ripper_sim_t * sim,long sectorNs,int maxSpeed,int realtime)
+{
+	if(sim != NULL) {
+		pthread_mutex_lock(&sim->lock);
+		sim->sector_ns = sectorNs > 0 ? sectorNs : 0;
+		sim->max_speed = maxSpeed > 0 ? maxSpeed : RIPPER_SIM_DEFAULT_MAX_SPEED;
+		sim->speed = sim->max_speed;
+		sim->realtime = realtime;
+		pthread_mutex_unlock(&sim->lock);
+	}
+}
+
+int ripperSimAddFault(ripper_sim_t * sim,RIPPER_SIM_FAULT_TYPE type,lsn_t first,lsn_t last,int reads,long amount)
+{
+	if(sim == NULL || last < first) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&sim->lock);
+	if(sim->numFaults == sim->sizeFaults) {
+		int size = sim->sizeFaults == 0 ? 8 : sim->sizeFaults * 2;
+		ripper_sim_fault_t * faults = realloc(sim->faults,size * sizeof(ripper_sim_fault_t));
+		if(faults == NULL) {
+			pthread_mutex_unlock(&sim->lock);
+			printf("Error: Unable to allocate memory for the fault schedule.\n");
+			return -1;
+		}
+		sim->faults = faults;
+		sim->sizeFaults = size;
+	}
+
+	ripper_sim_fault_t * fault = &sim->faults[sim->numFaults++];
+	fault->type = type;
+	fault->first = first;
+	fault->last = last;
+	fault->reads = reads;
+	fault->amount = amount;
+	fault->hits = 0;
+	fault->active = 0;
+	pthread_mutex_unlock(&sim->lock);
+
+	return 1;
+}
+
+void ripperSimReset(ripper_sim_t * sim)
+{
+	int f;
+
+	if(sim != NULL) {
+		pthread_mutex_lock(&sim->lock);
+		for(f = 0;f < sim->numFaults;f++)
+			sim->faults[f].hits = 0;
+		sim->trace_pos = 0;
+		sim->trace_misses = 0;
+		sim->reads = 0;
+		sim->failed_reads = 0;
+		sim->sectors_read = 0;
+		sim->speed_changes = 0;
+		sim->q_reads = 0;
+		sim->elapsed_ns = 0;
+		sim->speed = sim->max_speed;
+		pthread_mutex_unlock(&sim->lock);
+	}
+}
+
+int ripperSimLoadTrace(ripper_sim_t * sim,const char * path)
+{
+	if(sim == NULL || path == NULL) {
+		return -1;
+	}
+
+	FILE * fp = fopen(path,"rb");
+	if(fp == NULL) {
+		printf("Error: Unable to open the trace %s.\n",path);
+		return -1;
+	}
+
+	ripper_sim_trace_header_t header;
+	if(fread(&header,sizeof(header),1,fp) != 1
+		|| header.magic != RIPPER_SIM_TRACE_MAGIC || header.version != RIPPER_SIM_TRACE_VERSION) {
+		printf("Error: %s is not a drive trace.\n",path);
+		fclose(fp);
+		return -1;
+	}
+
+	ripper_sim_trace_read_t * trace = NULL;
+	long numTrace = 0;
+	long size = 0;
+	ripper_sim_trace_read_t read;
+	while(fread(&read,sizeof(read),1,fp) == 1) {
+		if(numTrace == size) {
+			size = size == 0 ? 1024 : size * 2;
+			ripper_sim_trace_read_t * grown = realloc(trace,size * sizeof(ripper_sim_trace_read_t));
+			if(grown == NULL) {
+				printf("Error: Unable to allocate memory for the trace.\n");
+				free(trace);
+				fclose(fp);
+				return -1;
+			}
+			trace = grown;
+		}
+		trace[numTrace++] = read;
+	}
+	fclose(fp);
+
+	pthread_mutex_lock(&sim->lock);
+	free(sim->trace);
+	sim->trace = trace;
+	sim->numTrace = numTrace;
+	sim->trace_pos = 0;
+	sim->trace_misses = 0;
+	pthread_mutex_unlock(&sim->lock);
+
+	return 1;
+}
+
+//read_audio of a drive being recorded
+static long ripperSimRecordRead(cdrom_drive_t * d,void * p,lsn_t begin,long sectors)
+{
+	ripper_sim_recorder_t * recorder;
+
+	pthread_mutex_lock(&ripper_sim_recorders_lock);
+	for(recorder = ripper_sim_recorders;recorder != NULL && recorder->drive != d;recorder = recorder->next)
+		;
+	pthread_mutex_unlock(&ripper_sim_recorders_lock);
+
+	uint64_t start = ripperSimNow();
+	long result = recorder->read_audio(d,p,begin,sectors);
+
+	ripper_sim_trace_read_t read;
+	memset(&read,0,sizeof(read));
+	read.begin = begin;
+	read.sectors = sectors;
+	read.result = result;
+	read.ns = ripperSimNow() - start;
+	if(result > 0)
+		read.crc = ripperCRC32Update(0,p,(size_t)CDIO_CD_FRAMESIZE_RAW * result);
+
+	pthread_mutex_lock(&recorder->lock);
+	fwrite(&read,sizeof(read),1,recorder->fp);
+	pthread_mutex_unlock(&recorder->lock);
+
+	return result;
+}
+
+ripper_sim_recorder_t * ripperSimRecordStart(ripper_cd_data_t * ripper,const char * path)
+{
+	if(ripper == NULL || path == NULL || ripperOpenDrive(ripper) == -1) {
+		return NULL;
+	}
+
+	ripper_sim_recorder_t * recorder = calloc(sizeof(ripper_sim_recorder_t),1);
+	if(recorder == NULL) {
+		printf("Error: Unable to allocate memory for the trace.\n");
+		return NULL;
+	}
+	recorder->fp = fopen(path,"wb");
+	if(recorder->fp == NULL) {
+		printf("Error: Unable to open the trace %s for writing.\n",path);
+		free(recorder);
+		return NULL;
+	}
+
+	ripper_sim_trace_header_t header;
+	memset(&header,0,sizeof(header));
+	header.magic = RIPPER_SIM_TRACE_MAGIC;
+	header.version = RIPPER_SIM_TRACE_VERSION;
+	fwrite(&header,sizeof(header),1,recorder->fp);
+
+	pthread_mutex_init(&recorder->lock,NULL);
+	recorder->drive = ripper->drive;
+	recorder->read_audio = ripper->drive->read_audio;
+
+	pthread_mutex_lock(&ripper_sim_recorders_lock);
+	recorder->next = ripper_sim_recorders;
+	ripper_sim_recorders = recorder;
+	pthread_mutex_unlock(&ripper_sim_recorders_lock);
+	ripper->drive->read_audio = ripperSimRecordRead;
+
+	return recorder;
+}
+
+int ripperSimRecordStop(ripper_sim_recorder_t * recorder)
+{
+	ripper_sim_recorder_t ** link;
+	int result = 1;
+
+	if(recorder == NULL) {
+		return -1;
+	}
+
+	recorder->drive->read_audio = recorder->read_audio;
+	pthread_mutex_lock(&ripper_sim_recorders_lock);
+	for(link = &ripper_sim_recorders;*link != NULL;link = &(*link)->next) {
+		if(*link == recorder) {
+			*link = recorder->next;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&ripper_sim_recorders_lock);
+
+	if(fclose(recorder->fp) != 0)
+		result = -1;
+	pthread_mutex_destroy(&recorder->lock);
+	free(recorder);
+
+	return result;
+}
@@ -0,0 +1,100 @@
+/**
+  libripper
+
+  Adaptive drive speed.
+
+  The controller only sees the events paranoia reports and
+  the number of sectors read, so it can be driven by a real
+  rip or by a recorded error pattern alike.  Reads are
+  split into regions and each region is judged once it is
+  complete.  A region with damage halves the speed straight
+  away, the speed is only doubled again after a run of
+  clean regions so a scratch doesn't make the drive hunt.
+  Paranoia reporting that the drive cached more than it
+  expected grows the window it busts on rereads.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ripper.h"
+
+void ripperSpeedInit(ripper_speed_control_t * control,int minSpeed,int maxSpeed)
+{
+	memset(control,0,sizeof(*control));
+	if(minSpeed < 1)
+		minSpeed = 1;
+	if(maxSpeed > 0 && maxSpeed < minSpeed)
+		maxSpeed = minSpeed;
+	control->min_speed = minSpeed;
+	control->max_speed = maxSpeed;
+	control->speed = maxSpeed;
+	control->window = RIPPER_SPEED_MIN_WINDOW;
+}
+
+void ripperSpeedReset(ripper_speed_control_t * control)
+{
+	control->region_sectors = 0;
+	control->errors = 0;
+	control->rereads = 0;
+	control->clean_regions = 0;
+}
+
+void ripperSpeedEvent(ripper_speed_control_t * control,paranoia_cb_mode_t event)
+{
+	switch(event) {
+		//sectors paranoia couldn't read or had to patch up
+		case PARANOIA_CB_READERR:
+		case PARANOIA_CB_SCRATCH:
+		case PARANOIA_CB_REPAIR:
+		case PARANOIA_CB_SKIP:
+			control->errors++;
+			break;
+		//jitter and drift that a reread corrected
+		case PARANOIA_CB_FIXUP_EDGE:
+		case PARANOIA_CB_FIXUP_ATOM:
+		case PARANOIA_CB_FIXUP_DROPPED:
+		case PARANOIA_CB_FIXUP_DUPED:
+		case PARANOIA_CB_DRIFT:
+			control->rereads++;
+			break;
+		case PARANOIA_CB_CACHEERR:
+			if(control->window < RIPPER_SPEED_MAX_WINDOW)
+				control->window *= 2;
+			if(control->window > RIPPER_SPEED_MAX_WINDOW)
+				control->window = RIPPER_SPEED_MAX_WINDOW;
+			break;
+		default:
+			break;
+	}
+}
+
+int ripperSpeedUpdate(ripper_speed_control_t * control,long sectors)
+{
+	int speed = control->speed;
+
+	if(control->max_speed == 0)
+		return 0;
+
+	control->region_sectors += sectors;
+	if(control->region_sectors < RIPPER_SPEED_REGION_SECTORS)
+		return 0;
+
+	if(control->errors > 0 || control->rereads * RIPPER_SPEED_REREAD_RATIO > control->region_sectors) {
+		control->clean_regions = 0;
+		control->speed /= 2;
+		if(control->speed < control->min_speed)
+			control->speed = control->min_speed;
+	} else if(++control->clean_regions >= RIPPER_SPEED_CLEAN_REGIONS) {
+		control->clean_regions = 0;
+		control->speed *= 2;
+		if(control->speed > control->max_speed)
+			control->speed = control->max_speed;
+	}
+
+	control->region_sectors = 0;
+	control->errors = 0;
+	control->rereads = 0;
+
+	return control->speed != speed;
+}
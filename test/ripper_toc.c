@@ -0,0 +1,410 @@
+/**
+  libripper
+
+  Table of contents.
+
+  The tracks of a disc are read from the cdio handle the
+  ripper was opened with, which reads the toc from the drive
+  once and answers from memory after that.  Telling audio
+  from data tracks and finding where the audio session of a
+  multisession disc ends can take the drive further
+  commands, so what is learnt about a disc is kept in a
+  small cache shared by every ripper in the process.  A disc
+  is known by the drive it is in and the start of each of
+  its tracks, putting the same disc back in the autoloader
+  finds it in the cache.
+
+  The index points inside the tracks are only in the q
+  subchannel.  The position it carries only grows over the
+  disc, so the start of a pregap is found by binary search
+  between the start of the track before and the start of
+  the track, reading a sector at a time.  A few sectors in
+  every hundred carry the catalog number or an isrc in
+  place of the position, a search landing on one moves to
+  the sector next to it.
+
+**/
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <cdio/mmc.h>
+#include "ripper.h"
+
+//discs remembered by the cache
+#define RIPPER_TOC_CACHE_SIZE 16
+//the lead out and lead in closing a session and the pregap
+//of the next one, the audio session of a cd extra ends this
+//many sectors before its data session
+#define RIPPER_TOC_SESSION_GAP 11400
+//sectors tried next to one without a position in its q
+//frame before the search gives up
+#define RIPPER_TOC_Q_RETRIES 4
+//formatted q data follows the audio of a sector
+#define RIPPER_TOC_Q_SIZE 16
+
+//what the cache knows of a disc besides its track starts
+typedef struct ripper_toc_cache_entry_t {
+	uint64_t identity;
+	uint64_t used;
+	unsigned int numTracks;
+	int indexed;
+	lsn_t last[CDIO_CD_MAX_TRACKS];
+	lsn_t pregap[CDIO_CD_MAX_TRACKS];
+	unsigned char audio[CDIO_CD_MAX_TRACKS];
+} ripper_toc_cache_entry_t;
+
+static pthread_mutex_t ripper_toc_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static ripper_toc_cache_entry_t ripper_toc_cache[RIPPER_TOC_CACHE_SIZE];
+static uint64_t ripper_toc_cache_clock = 0;
+
+static uint64_t ripperTocHash(uint64_t hash,const void * data,size_t length)
+{
+	const unsigned char * bytes = data;
+	size_t i;
+
+	for(i = 0;i < length;i++)
+		hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+
+	return hash;
+}
+
+//copies what the cache knows of the disc into toc and sets
+//indexed if its pregaps are known
+//returns 1 if the disc is cached and 0 otherwise
+static int ripperTocCacheFind(uint64_t identity,ripper_toc_track_t * toc,unsigned int numTracks,int * indexed)
+{
+	int found = 0;
+	unsigned int i,t;
+
+	pthread_mutex_lock(&ripper_toc_cache_lock);
+	for(i = 0;i < RIPPER_TOC_CACHE_SIZE && !found;i++) {
+		ripper_toc_cache_entry_t * entry = &ripper_toc_cache[i];
+		if(entry->used == 0 || entry->identity != identity || entry->numTracks != numTracks)
+			continue;
+		for(t = 0;t < numTracks;t++) {
+			toc[t].last = entry->last[t];
+			toc[t].pregap = entry->indexed ? entry->pregap[t] : toc[t].first;
+			toc[t].audio = entry->audio[t];
+		}
+		*indexed = entry->indexed;
+		entry->used = ++ripper_toc_cache_clock;
+		found = 1;
+	}
+	pthread_mutex_unlock(&ripper_toc_cache_lock);
+
+	return found;
+}
+
+//remembers the disc in place of the one used longest ago,
+//a disc already cached is updated
+static void ripperTocCacheAdd(uint64_t identity,const ripper_toc_track_t * toc,unsigned int numTracks,int indexed)
+{
+	ripper_toc_cache_entry_t * entry = &ripper_toc_cache[0];
+	unsigned int i,t;
+
+	pthread_mutex_lock(&ripper_toc_cache_lock);
+	for(i = 1;i < RIPPER_TOC_CACHE_SIZE && entry->identity != identity;i++) {
+		if(ripper_toc_cache[i].identity == identity || ripper_toc_cache[i].used < entry->used)
+			entry = &ripper_toc_cache[i];
+	}
+	entry->identity = identity;
+	entry->numTracks = numTracks;
+	entry->indexed = indexed;
+	for(t = 0;t < numTracks;t++) {
+		entry->last[t] = toc[t].last;
+		entry->pregap[t] = toc[t].pregap;
+		entry->audio[t] = toc[t].audio;
+	}
+	entry->used = ++ripper_toc_cache_clock;
+	pthread_mutex_unlock(&ripper_toc_cache_lock);
+}
+
+//counts the tracks, works out the frame offsets used for
+//cddb and the type of the disc from the ripper's toc
+//returns 1 on success and -1 on error
+static int ripperTocFinish(ripper_cd_data_t * ripper,unsigned int numTracks,lsn_t leadout)
+{
+	unsigned int i;
+
+	ripper->frame_offsets = calloc(sizeof(int),numTracks);
+	if(ripper->frame_offsets == NULL) {
+		printf("Error: Allocating memory for frame offsets\n");
+		return -1;
+	}
+
+	//the drive counts sectors from the start of the
+	//program area, cddb counts frames from the lead in
+	ripper->numAudioTracks = 0;
+	ripper->numDataTracks = 0;
+	for(i = 0;i < numTracks;i++) {
+		ripper->frame_offsets[i] = ripper->toc[i].first + CDIO_PREGAP_SECTORS;
+		if(ripper->toc[i].audio)
+			ripper->numAudioTracks++;
+		else
+			ripper->numDataTracks++;
+	}
+	ripper->totalTracks = numTracks;
+	ripper->cd_length = FRAMES_TO_SECONDS(leadout + CDIO_PREGAP_SECTORS);
+
+	//this isn't complete but enough for the purposes
+	//of this library
+	if(ripper->numAudioTracks > 0 && ripper->numDataTracks == 0)
+		ripper->type = AUDIO_CD;
+	else if(ripper->numDataTracks > 0 && ripper->numAudioTracks == 0)
+		ripper->type = DATA_CD;
+	else
+		ripper->type = MIXED_MODE_CD;
+
+	return 1;
+}
+
+int ripperTocRead(ripper_cd_data_t * ripper,const char * source)
+{
+	lsn_t starts[CDIO_CD_MAX_TRACKS + 1];
+	track_t first = cdio_get_first_track_num(ripper->cdio_p);
+	track_t numTracks = cdio_get_num_tracks(ripper->cdio_p);
+	unsigned int i;
+
+	//make sure there is a cd inserted
+	if(first == CDIO_INVALID_TRACK || numTracks == CDIO_INVALID_TRACK || numTracks == 0 || numTracks > CDIO_CD_MAX_TRACKS) {
+		ripper->type = NO_CD;
+		return -1;
+	}
+
+	//the starts come from the toc the handle already read
+	for(i = 0;i < numTracks;i++)
+		starts[i] = cdio_get_track_lsn(ripper->cdio_p,first + i);
+	starts[numTracks] = cdio_get_track_lsn(ripper->cdio_p,CDIO_CDROM_LEADOUT_TRACK);
+	for(i = 0;i <= numTracks;i++) {
+		if(starts[i] == CDIO_INVALID_LSN) {
+			printf("Error: Track %d has an invalid lba.\n",i + 1);
+			return -1;
+		}
+	}
+
+	ripper->toc = calloc(sizeof(ripper_toc_track_t),numTracks);
+	if(ripper->toc == NULL) {
+		printf("Error: Allocating memory for the table of contents\n");
+		return -1;
+	}
+	for(i = 0;i < numTracks;i++) {
+		ripper->toc[i].first = starts[i];
+		ripper->toc[i].pregap = starts[i];
+	}
+
+	uint64_t identity = 0xcbf29ce484222325ULL;
+	if(source != NULL)
+		identity = ripperTocHash(identity,source,strlen(source));
+	identity = ripperTocHash(identity,&first,sizeof(first));
+	identity = ripperTocHash(identity,starts,sizeof(lsn_t) * (numTracks + 1));
+
+	ripper->toc_identity = identity;
+	if(!ripperTocCacheFind(identity,ripper->toc,numTracks,&ripper->indexed)) {
+		//a disc with more than one session has its audio
+		//session first, its last track ends before the gap
+		lsn_t session = 0;
+		if(cdio_get_last_session(ripper->cdio_p,&session) != DRIVER_OP_SUCCESS)
+			session = 0;
+
+		for(i = 0;i < numTracks;i++) {
+			ripper->toc[i].audio = cdio_get_track_format(ripper->cdio_p,first + i) == TRACK_FORMAT_AUDIO;
+			ripper->toc[i].last = starts[i + 1] - 1;
+			if(session - RIPPER_TOC_SESSION_GAP > starts[i] && starts[i + 1] >= session && ripper->toc[i].audio)
+				ripper->toc[i].last = session - RIPPER_TOC_SESSION_GAP - 1;
+		}
+		ripperTocCacheAdd(identity,ripper->toc,numTracks,0);
+	}
+
+	return ripperTocFinish(ripper,numTracks,starts[numTracks]);
+}
+
+int ripperTocReadDrive(ripper_cd_data_t * ripper,cdrom_drive_t * drive)
+{
+	unsigned int numTracks = cdio_cddap_tracks(drive);
+	unsigned int i;
+
+	if(numTracks == 0 || numTracks > CDIO_CD_MAX_TRACKS) {
+		ripper->type = NO_CD;
+		return -1;
+	}
+
+	ripper->toc = calloc(sizeof(ripper_toc_track_t),numTracks);
+	if(ripper->toc == NULL) {
+		printf("Error: Allocating memory for the table of contents\n");
+		return -1;
+	}
+
+	//an open drive has its toc in memory already
+	for(i = 0;i < numTracks;i++) {
+		ripper->toc[i].first = cdio_cddap_track_firstsector(drive,i + 1);
+		ripper->toc[i].last = cdio_cddap_track_lastsector(drive,i + 1);
+		ripper->toc[i].pregap = ripper->toc[i].first;
+		ripper->toc[i].audio = cdio_cddap_track_audiop(drive,i + 1) == 1;
+	}
+
+	return ripperTocFinish(ripper,numTracks,cdio_cddap_disc_lastsector(drive) + 1);
+}
+
+static int ripperTocFromBCD(uint8_t value)
+{
+	return (value >> 4) * 10 + (value & 0x0f);
+}
+
+//reads the formatted q subchannel of the sector from the
+//cdio handle in arg
+static int ripperTocReadQ(void * arg,lsn_t sector,ripper_subchannel_q_t * q)
+{
+	uint8_t buffer[CDIO_CD_FRAMESIZE_RAW + RIPPER_TOC_Q_SIZE];
+
+	if(mmc_read_cd((CdIo_t *)arg,buffer,sector,CDIO_MMC_READ_TYPE_CDDA,false,false,0,true,false,0,
+		2,sizeof(buffer),1) != DRIVER_OP_SUCCESS)
+		return -1;
+
+	//only mode 1 frames carry the position
+	const uint8_t * frame = buffer + CDIO_CD_FRAMESIZE_RAW;
+	if((frame[0] & 0x0f) != 1)
+		return 0;
+	q->track = ripperTocFromBCD(frame[1]);
+	q->index = ripperTocFromBCD(frame[2]);
+
+	return 1;
+}
+
+//reads the position of sector or, when its q frame holds
+//something else, of a sector next to it above low
+//returns the sector read, low if there is none and -1 on
+//error
+static lsn_t ripperTocReadPosition(ripper_cd_data_t * ripper,lsn_t sector,lsn_t low,ripper_subchannel_q_t * q)
+{
+	int i;
+
+	for(i = 0;i < RIPPER_TOC_Q_RETRIES && sector - i > low;i++) {
+		int result = ripper->read_q(ripper->read_q_arg,sector - i,q);
+		if(result == -1)
+			return -1;
+		if(result == 1)
+			return sector - i;
+	}
+
+	return low;
+}
+
+//same as ripperTocReadPosition looking up from sector to
+//below high
+//returns the sector read, high if there is none and -1 on
+//error
+static lsn_t ripperTocReadPositionAbove(ripper_cd_data_t * ripper,lsn_t sector,lsn_t high,ripper_subchannel_q_t * q)
+{
+	int i;
+
+	for(i = 0;i < RIPPER_TOC_Q_RETRIES && sector + i < high;i++) {
+		int result = ripper->read_q(ripper->read_q_arg,sector + i,q);
+		if(result == -1)
+			return -1;
+		if(result == 1)
+			return sector + i;
+	}
+
+	return high;
+}
+
+//finds INDEX 00 of the track.  low is a sector of an
+//earlier track, or -1 for the first track, and the track
+//starts at first, the pregap lies in between
+//returns the start of the pregap, first without one, or
+//-1 on error
+static lsn_t ripperTocFindPregap(ripper_cd_data_t * ripper,lsn_t low,lsn_t first)
+{
+	ripper_subchannel_q_t q;
+	lsn_t high;
+
+	//the track number as the subchannel counts it
+	if(ripperTocReadPosition(ripper,first + RIPPER_TOC_Q_RETRIES - 1,first - 1,&q) < first)
+		return -1;
+	int track = q.track;
+
+	high = ripperTocReadPosition(ripper,first - 1,low,&q);
+	if(high == -1)
+		return -1;
+	if(high == low || q.track != track)
+		return first;
+	//nothing comes before the pregap of the first track
+	if(low < 0)
+		return 0;
+
+	//the sectors from low up are the track before, from
+	//high up the pregap
+	while(high - low > 1) {
+		lsn_t middle = ripperTocReadPosition(ripper,low + (high - low) / 2,low,&q);
+		if(middle == low)
+			middle = ripperTocReadPositionAbove(ripper,low + (high - low) / 2 + 1,high,&q);
+		if(middle == -1)
+			return -1;
+		//no sector in between holds a position, the pregap
+		//starts at high as far as the subchannel tells
+		if(middle == high)
+			break;
+		if(q.track >= track)
+			high = middle;
+		else
+			low = middle;
+	}
+
+	return high;
+}
+
+int ripperScanIndexes(ripper_cd_data_t * ripper)
+{
+	unsigned int i;
+
+	if(ripper == NULL || ripper->toc == NULL) {
+		return -1;
+	}
+	if(ripper->indexed) {
+		return 1;
+	}
+
+	//the pregaps of an image are in its cue sheet or toc
+	//file, libcdio has them from there
+	if(ripper->read_q == NULL && ripper->image) {
+		track_t first = cdio_get_first_track_num(ripper->cdio_p);
+		for(i = 0;i < ripper->totalTracks;i++) {
+			lsn_t pregap = cdio_get_track_pregap_lsn(ripper->cdio_p,first + i);
+			if(pregap != CDIO_INVALID_LSN && pregap < ripper->toc[i].first && pregap >= (i > 0 ? ripper->toc[i - 1].first : 0))
+				ripper->toc[i].pregap = pregap;
+		}
+	} else {
+		if(ripper->read_q == NULL) {
+			ripper->read_q = ripperTocReadQ;
+			ripper->read_q_arg = ripper->cdio_p != NULL ? ripper->cdio_p : ripper->drive->p_cdio;
+		}
+		for(i = 0;i < ripper->totalTracks;i++) {
+			lsn_t pregap;
+
+			if(!ripper->toc[i].audio)
+				continue;
+			//audio before the first track is hidden in its
+			//pregap, which always starts the disc
+			if(i == 0) {
+				pregap = ripper->toc[0].first > 0 ? ripperTocFindPregap(ripper,-1,ripper->toc[0].first) : 0;
+			} else if(ripper->toc[i - 1].audio) {
+				pregap = ripperTocFindPregap(ripper,ripper->toc[i - 1].first,ripper->toc[i].first);
+			} else {
+				continue;
+			}
+			if(pregap == -1) {
+				printf("Error: Unable to read the subchannel of track %d.\n",i + 1);
+				return -1;
+			}
+			ripper->toc[i].pregap = pregap;
+		}
+	}
+
+	ripper->indexed = 1;
+	if(ripper->toc_identity != 0)
+		ripperTocCacheAdd(ripper->toc_identity,ripper->toc,ripper->totalTracks,1);
+
+	return 1;
+}
@@ -0,0 +1,236 @@
+/**
+  libripper
+
+  Rip tracing.
+
+  Events are recorded into a ring owned by the recording
+  thread, the ring is found through a thread local pointer
+  so recording an event only takes the clock and a store.
+  Rings are allocated in full the first time a thread
+  records into a trace and overwrite their oldest events
+  once full, so a long rip keeps its last stretch.  The
+  trace is written out in the chrome trace event format
+  with the sector of every event in its arguments, so read
+  times can be lined up against the position on the disc.
+
+**/
+//pthread_getname_np is only declared for gnu sources
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "ripper.h"
+
+//names of the events, indexed by RIPPER_TRACE_EVENT_TYPE
+static const char * const ripper_trace_names[] = {
+	"read", "burst read", "seek", "paranoia", "write", "wait", "flush"
+};
+
+//categories of the events, the drive, paranoia or the output
+static const char * const ripper_trace_categories[] = {
+	"drive", "drive", "paranoia", "paranoia", "output", "output", "output"
+};
+
+//names of paranoia events by paranoia_cb_mode_t
+static const char * const ripper_trace_paranoia_names[RIPPER_STATS_EVENTS] = {
+	"drive read", "verify", "fixup edge", "fixup atom", "scratch", "repair", "skip",
+	"drift", "backoff", "overlap", "fixup dropped", "fixup duped", "read error", "cache error"
+};
+
+//tells traces apart even when one is allocated where a
+//freed one used to be
+static uint64_t ripper_trace_ids = 0;
+
+//ring of this thread and the trace it belongs to
+static __thread uint64_t ripper_trace_thread_id = 0;
+static __thread ripper_trace_ring_t * ripper_trace_thread_ring = NULL;
+
+static uint64_t ripperTraceNow()
+{
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC,&now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+ripper_trace_t * ripperTraceCreate(long events)
+{
+	ripper_trace_t * trace = calloc(sizeof(ripper_trace_t),1);
+	if(trace == NULL) {
+		printf("Error: Unable to allocate memory for the rip trace.\n");
+		return NULL;
+	}
+
+	pthread_mutex_init(&trace->lock,NULL);
+	trace->ring_events = events;
+	trace->id = __atomic_add_fetch(&ripper_trace_ids,1,__ATOMIC_RELAXED);
+	trace->start = ripperTraceNow();
+
+	return trace;
+}
+
+ripper_trace_t * ripperTraceDestroy(ripper_trace_t * trace)
+{
+	int i;
+
+	if(trace != NULL) {
+		for(i = 0;i < trace->numRings;i++) {
+			free(trace->rings[i]->events);
+			free(trace->rings[i]);
+		}
+		free(trace->rings);
+		pthread_mutex_destroy(&trace->lock);
+		free(trace);
+	}
+
+	return NULL;
+}
+
+//returns the ring of the calling thread adding one the
+//first time the thread records into the trace
+//returns NULL if the ring can't be allocated
+static ripper_trace_ring_t * ripperTraceRing(ripper_trace_t * trace)
+{
+	ripper_trace_ring_t * ring = NULL;
+	long tid;
+	int i;
+
+	if(ripper_trace_thread_id == trace->id)
+		return ripper_trace_thread_ring;
+
+	//a thread going back and forth between rippers keeps
+	//the ring it had
+	tid = syscall(SYS_gettid);
+	pthread_mutex_lock(&trace->lock);
+	for(i = 0;i < trace->numRings && ring == NULL;i++) {
+		if(trace->rings[i]->tid == tid)
+			ring = trace->rings[i];
+	}
+	if(ring == NULL && trace->numRings == trace->sizeRings) {
+		int size = trace->sizeRings == 0 ? 4 : trace->sizeRings * 2;
+		ripper_trace_ring_t ** rings = realloc(trace->rings,sizeof(ripper_trace_ring_t *) * size);
+		if(rings == NULL) {
+			pthread_mutex_unlock(&trace->lock);
+			return NULL;
+		}
+		trace->rings = rings;
+		trace->sizeRings = size;
+	}
+	if(ring == NULL && (ring = calloc(sizeof(ripper_trace_ring_t),1)) != NULL) {
+		ring->events = malloc(sizeof(ripper_trace_event_t) * trace->ring_events);
+		if(ring->events == NULL) {
+			free(ring);
+			pthread_mutex_unlock(&trace->lock);
+			return NULL;
+		}
+		ring->size = trace->ring_events;
+		ring->tid = tid;
+		if(pthread_getname_np(pthread_self(),ring->name,sizeof(ring->name)) != 0)
+			snprintf(ring->name,sizeof(ring->name),"thread %ld",tid);
+		//the name goes into the json as it is
+		for(i = 0;ring->name[i] != '\0';i++) {
+			if(ring->name[i] == '"' || ring->name[i] == '\\' || (unsigned char)ring->name[i] < 0x20)
+				ring->name[i] = '_';
+		}
+		trace->rings[trace->numRings++] = ring;
+	}
+	pthread_mutex_unlock(&trace->lock);
+	if(ring == NULL)
+		return NULL;
+
+	ripper_trace_thread_id = trace->id;
+	ripper_trace_thread_ring = ring;
+
+	return ring;
+}
+
+void ripperTraceEvent(ripper_trace_t * trace,RIPPER_TRACE_EVENT_TYPE type,uint64_t start,int track,long sector,long sectors)
+{
+	ripper_trace_ring_t * ring = ripperTraceRing(trace);
+	uint64_t now = ripperTraceNow();
+
+	//a thread that can't get a ring goes untraced
+	if(ring == NULL)
+		return;
+
+	ripper_trace_event_t * event = &ring->events[ring->count % ring->size];
+	event->start = start != 0 ? start : now;
+	event->duration = start != 0 ? now - start : 0;
+	event->sector = sector;
+	event->sectors = sectors;
+	event->type = type;
+	event->track = track;
+	ring->count++;
+}
+
+//prints one event, times are in microseconds
+static void ripperTraceWriteEvent(FILE * fp,const ripper_trace_t * trace,const ripper_trace_ring_t * ring,const ripper_trace_event_t * event)
+{
+	const char * name = ripper_trace_names[event->type];
+	double start = (event->start - trace->start) / 1000.0;
+
+	if(event->type == RIPPER_TRACE_PARANOIA && event->sectors >= 0 && event->sectors < RIPPER_STATS_EVENTS)
+		name = ripper_trace_paranoia_names[event->sectors];
+
+	fprintf(fp,",\n{\"name\":\"%s\",\"cat\":\"%s\",\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f,",
+		name,ripper_trace_categories[event->type],(long)getpid(),ring->tid,start);
+	if(event->duration > 0 || event->type != RIPPER_TRACE_PARANOIA)
+		fprintf(fp,"\"ph\":\"X\",\"dur\":%.3f,",event->duration / 1000.0);
+	else
+		fprintf(fp,"\"ph\":\"i\",\"s\":\"t\",");
+	fprintf(fp,"\"args\":{\"track\":%d,\"sector\":%d",event->track,event->sector);
+	if(event->type != RIPPER_TRACE_PARANOIA)
+		fprintf(fp,",\"sectors\":%d",event->sectors);
+	fprintf(fp,"}}");
+}
+
+int ripperTraceWrite(ripper_cd_data_t * ripper,const char * path)
+{
+	if(ripper == NULL || ripper->trace == NULL || path == NULL) {
+		return -1;
+	}
+
+	ripper_trace_t * trace = ripper->trace;
+	FILE * fp = fopen(path,"w");
+	int i;
+
+	if(fp == NULL) {
+		printf("Error: Unable to open the trace file %s.\n",path);
+		return -1;
+	}
+
+	fprintf(fp,"{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+	fprintf(fp,"{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"args\":{\"name\":\"libripper\"}}",(long)getpid());
+
+	pthread_mutex_lock(&trace->lock);
+	for(i = 0;i < trace->numRings;i++) {
+		const ripper_trace_ring_t * ring = trace->rings[i];
+		uint64_t first = ring->count > (uint64_t)ring->size ? ring->count - ring->size : 0;
+		uint64_t e;
+
+		fprintf(fp,",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,\"args\":{\"name\":\"%s\"}}",
+			(long)getpid(),ring->tid,ring->name);
+		//the oldest events were overwritten once the ring
+		//was full, the reader can see where the trace starts
+		if(first > 0)
+			fprintf(fp,",\n{\"name\":\"dropped\",\"ph\":\"C\",\"pid\":%ld,\"tid\":%ld,\"ts\":%.3f,\"args\":{\"events\":%llu}}",
+				(long)getpid(),ring->tid,(ring->events[first % ring->size].start - trace->start) / 1000.0,(unsigned long long)first);
+		for(e = first;e < ring->count;e++)
+			ripperTraceWriteEvent(fp,trace,ring,&ring->events[e % ring->size]);
+	}
+	pthread_mutex_unlock(&trace->lock);
+
+	fprintf(fp,"\n]}\n");
+	if(fclose(fp) != 0) {
+		printf("Error: Unable to write the trace file %s.\n",path);
+		return -1;
+	}
+
+	return 1;
+}